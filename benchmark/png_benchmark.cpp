@@ -0,0 +1,944 @@
+#include "checksum.h"
+#include "image_resample.h"
+#include "parallel_inflate.h"
+#include "png_decoder.h"
+#include "png_writer.h"
+#include "sprite_pack.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Every allocation goes through here, so allocations per decode can be counted
+static std::atomic<uint64_t> s_AllocationCount{0};
+
+void* operator new(size_t size) {
+   s_AllocationCount++;
+   void* memory = malloc(size ? size : 1);
+   if (!memory) {
+      throw std::bad_alloc();
+   }
+   return memory;
+}
+
+void operator delete(void* memory) noexcept {
+   free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+   free(memory);
+}
+
+#define MIN_BENCH_SECONDS 0.25
+#define MIN_BENCH_ITERATIONS 3
+
+struct CorpusEntry {
+   std::string name;
+   uint32_t width;
+   uint32_t height;
+   std::vector<uint8_t> file;
+};
+
+//Smooth gradients with noisy patches, so matches and literals both show up in the stream.
+//filter is the filter type for every row, or FILTER_TYPE_COUNT to cycle all of them
+static std::vector<uint8_t> MakePNG(uint32_t width, uint32_t height, uint8_t bbp, uint8_t filter) {
+   size_t lineLength = (size_t) width * bbp;
+   std::vector<uint8_t> pixels(lineLength * height);
+   uint32_t seed = width * 31 + height * 17 + bbp;
+
+   for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+         uint8_t* pixel = &pixels[y * lineLength + x * bbp];
+         bool isNoisy = ((x / 13 + y / 11) % 5) == 0;
+         for (uint8_t c = 0; c < bbp; c++) {
+            seed = seed * 1103515245 + 12345;
+            pixel[c] = isNoisy ? (uint8_t) (seed >> 16) : (uint8_t) (x * (c + 1) + y * (3 - c % 3));
+         }
+         if (bbp == 4) {
+            pixel[3] = (x + y) % 9 ? 255 : 40;
+         }
+      }
+   }
+
+   std::vector<uint8_t> filtered;
+   filtered.reserve((lineLength + 1) * height);
+   std::vector<uint8_t> zeroLine(lineLength);
+
+   for (uint32_t y = 0; y < height; y++) {
+      uint8_t rowFilter = filter < FILTER_TYPE_COUNT ? filter : (uint8_t) (y % FILTER_TYPE_COUNT);
+      const uint8_t* line = &pixels[y * lineLength];
+      AppendFilteredLine(filtered, line, y ? line - lineLength : zeroLine.data(), lineLength, bbp, rowFilter);
+   }
+
+   return WritePNG(width, height, 8, bbp == 3 ? 2 : 6, 0, {}, {}, filtered);
+}
+
+struct FormatCase {
+   const char* name;
+   uint8_t colorType;
+   uint8_t bitDepth;
+   uint8_t interlace;
+   bool isLossless;//Decodes to the same pixels as 8 bit RGBA, gray and RGB formats lose color or alpha
+};
+
+static const FormatCase s_FormatCases[] = {
+   {"rgba 8", 6, 8, 0, true},
+   {"rgba 16", 6, 16, 0, true},
+   {"rgba 8 adam7", 6, 8, 1, true},
+   {"rgb 16", 2, 16, 0, false},
+   {"palette 8 + tRNS", 3, 8, 0, true},
+   {"palette 4 + tRNS", 3, 4, 0, true},
+   {"palette 4 + tRNS adam7", 3, 4, 1, true},
+   {"gray+alpha 8", 4, 8, 0, false},
+   {"gray+alpha 16", 4, 16, 0, false},
+   {"gray 8", 0, 8, 0, false},
+   {"gray 2", 0, 2, 0, false}
+};
+
+//Icon atlas stand-in: flat shapes in a dozen colors on a transparent background, 0xAARRGGBB
+static std::vector<uint32_t> MakeAtlasPixels(uint32_t width, uint32_t height) {
+   static const uint32_t colors[] = {0xFFE53935, 0xFF43A047, 0xFF1E88E5, 0xFFFDD835, 0xFF8E24AA, 0xFF00ACC1, 0xFFFB8C00, 0xFF6D4C41, 0xFF546E7A, 0xFFFFFFFF, 0xFF212121, 0x80000000};
+   const uint32_t cell = 32;
+
+   std::vector<uint32_t> pixels((size_t) width * height, 0);
+   for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+         uint32_t index = (x / cell) * 7 + (y / cell) * 3;
+         int32_t dx = (int32_t) (x % cell) - (int32_t) cell / 2;
+         int32_t dy = (int32_t) (y % cell) - (int32_t) cell / 2;
+         int32_t distance = dx * dx + dy * dy;
+
+         bool isInside = index % 3 == 0 ? distance < 14 * 14 : (index % 3 == 1 ? abs(dx) < 12 && abs(dy) < 9 : distance < 14 * 14 && distance > 8 * 8);
+         if (isInside) {
+            pixels[(size_t) y * width + x] = colors[(index + (dy > 0 ? 1 : 0)) % 12];
+         }
+      }
+   }
+
+   return pixels;
+}
+
+//Samples of one pixel at the bit depth of the format
+static uint32_t GetSamples(uint32_t pixel, const FormatCase& format, const std::vector<uint32_t>& paletteColors, uint16_t* samples) {
+   uint32_t red = (pixel >> 16) & 0xFF;
+   uint32_t green = (pixel >> 8) & 0xFF;
+   uint32_t blue = pixel & 0xFF;
+   uint32_t alpha = pixel >> 24;
+   uint32_t gray = (red * 77 + green * 150 + blue * 29 + 128) >> 8;
+
+   uint32_t values[4];
+   uint32_t count = 0;
+   if (format.colorType == 3) {
+      for (uint32_t i = 0; i < paletteColors.size(); i++) {
+         if (paletteColors[i] == pixel) {
+            samples[0] = (uint16_t) i;
+         }
+      }
+      return 1;
+   } else if (format.colorType == 0 || format.colorType == 4) {
+      values[count++] = gray;
+   } else {
+      values[count++] = red;
+      values[count++] = green;
+      values[count++] = blue;
+   }
+
+   if (format.colorType == 4 || format.colorType == 6) {
+      values[count++] = alpha;
+   }
+
+   for (uint32_t i = 0; i < count; i++) {
+      samples[i] = (uint16_t) (format.bitDepth == 16 ? values[i] * 257 : values[i] >> (8 - format.bitDepth));
+   }
+
+   return count;
+}
+
+//Palette and low bit depth rows stay unfiltered, others take the best filter
+static std::vector<uint8_t> EncodeAtlas(const std::vector<uint32_t>& pixels, uint32_t width, uint32_t height, const FormatCase& format) {
+   static const uint8_t adam7[7][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+
+   //Transparent entries first, so the tRNS chunk stays short
+   std::vector<uint32_t> paletteColors;
+   for (bool isOpaque : {false, true}) {
+      for (uint32_t pixel : pixels) {
+         if ((pixel >> 24 == 0xFF) == isOpaque && std::find(paletteColors.begin(), paletteColors.end(), pixel) == paletteColors.end()) {
+            paletteColors.emplace_back(pixel);
+         }
+      }
+   }
+
+   std::vector<uint8_t> palette;
+   std::vector<uint8_t> transparency;
+   if (format.colorType == 3) {
+      for (uint32_t color : paletteColors) {
+         palette.insert(palette.end(), {(uint8_t) (color >> 16), (uint8_t) (color >> 8), (uint8_t) color});
+         if (color >> 24 != 0xFF) {
+            transparency.emplace_back((uint8_t) (color >> 24));
+         }
+      }
+   }
+
+   uint16_t samples[4];
+   uint32_t bitsPerPixel = GetSamples(0, format, paletteColors, samples) * format.bitDepth;
+   uint8_t bbp = (uint8_t) (bitsPerPixel >= 8 ? bitsPerPixel / 8 : 1);
+   bool isFiltered = format.colorType != 3 && format.bitDepth >= 8;
+
+   std::vector<uint8_t> filtered;
+   uint32_t passCount = format.interlace ? 7 : 1;
+
+   for (uint32_t pass = 0; pass < passCount; pass++) {
+      uint32_t startX = format.interlace ? adam7[pass][0] : 0;
+      uint32_t startY = format.interlace ? adam7[pass][1] : 0;
+      uint32_t stepX = format.interlace ? adam7[pass][2] : 1;
+      uint32_t stepY = format.interlace ? adam7[pass][3] : 1;
+      uint32_t passWidth = width > startX ? (width - startX + stepX - 1) / stepX : 0;
+      uint32_t passHeight = height > startY ? (height - startY + stepY - 1) / stepY : 0;
+      if (!passWidth || !passHeight) {
+         continue;
+      }
+
+      size_t lineLength = ((size_t) passWidth * bitsPerPixel + 7) / 8;
+      std::vector<uint8_t> line(lineLength);
+      std::vector<uint8_t> prevLine(lineLength, 0);
+
+      for (uint32_t row = 0; row < passHeight; row++) {
+         std::fill(line.begin(), line.end(), 0);
+         size_t bit = 0;
+
+         for (uint32_t column = 0; column < passWidth; column++) {
+            uint32_t pixel = pixels[(size_t) (startY + row * stepY) * width + startX + column * stepX];
+            uint32_t count = GetSamples(pixel, format, paletteColors, samples);
+
+            for (uint32_t i = 0; i < count; i++, bit += format.bitDepth) {
+               if (format.bitDepth == 16) {
+                  line[bit / 8] = (uint8_t) (samples[i] >> 8);
+                  line[bit / 8 + 1] = (uint8_t) samples[i];
+               } else {
+                  line[bit / 8] |= (uint8_t) (samples[i] << (8 - format.bitDepth - bit % 8));
+               }
+            }
+         }
+
+         if (isFiltered) {
+            AppendBestFilteredLine(filtered, line.data(), prevLine.data(), lineLength, bbp);
+         } else {
+            AppendFilteredLine(filtered, line.data(), prevLine.data(), lineLength, bbp, 0);
+         }
+         line.swap(prevLine);
+      }
+   }
+
+   return WritePNG(width, height, format.bitDepth, format.colorType, format.interlace, palette, transparency, filtered);
+}
+
+static bool TryReadFile(const char* fileName, std::vector<uint8_t>& out) {
+   std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+   if (!file.is_open()) {
+      return false;
+   }
+
+   std::streamoff size = file.tellg();
+   if (size <= 0) {
+      return false;
+   }
+
+   out.resize((size_t) size);
+   file.seekg(0, std::ios_base::beg);
+   return (bool) file.read((char*) out.data(), size);
+}
+
+static void AddFile(std::vector<CorpusEntry>& corpus, const std::string& fileName) {
+   CorpusEntry entry{fileName.substr(fileName.find_last_of("/\\") + 1), 0, 0, {}};
+   if (!TryReadFile(fileName.c_str(), entry.file)) {
+      fprintf(stderr, "Can't read %s\n", fileName.c_str());
+      return;
+   }
+
+   PNGImage image;
+   if (!DecodePNG(entry.file.data(), entry.file.size(), PNGDecodeOptions(), image)) {
+      fprintf(stderr, "Can't decode %s\n", fileName.c_str());
+      return;
+   }
+
+   entry.width = image.width;
+   entry.height = image.height;
+   corpus.emplace_back(std::move(entry));
+}
+
+static void AddGenerated(std::vector<CorpusEntry>& corpus) {
+   static const char* filterNames[] = {"none", "sub", "up", "avg", "paeth", "mixed"};
+   static const uint32_t sizes[] = {64, 256, 1024, 2048};
+
+   for (uint32_t size : sizes) {
+      for (uint8_t bbp = 3; bbp <= 4; bbp++) {
+         for (uint8_t filter = 0; filter <= FILTER_TYPE_COUNT; filter++) {
+            //The largest size only with mixed filters, it is there for bandwidth rather than kernels
+            if (size == 2048 && filter != FILTER_TYPE_COUNT) {
+               continue;
+            }
+
+            std::string name = std::to_string(size) + "x" + std::to_string(size) + (bbp == 3 ? " rgb " : " rgba ") + filterNames[filter];
+            corpus.push_back({name, size, size, MakePNG(size, size, bbp, filter)});
+         }
+      }
+   }
+}
+
+static double ToMegabytesPerSecond(uint64_t pixels, double seconds) {
+   return (double) pixels * 4 / seconds / (1024.0 * 1024.0);
+}
+
+//Decodes the entry until the time and iteration minimums are met, the way the loader workers do:
+//one context and one output kept across decodes. The first decode warms both up and is not counted
+static bool TryTimeDecode(const CorpusEntry& entry, const PNGDecodeOptions& options, double* secondsPerDecode, double* allocationsPerDecode) {
+   PNGDecoderContext context;
+   PNGImage image;
+   if (!DecodePNG(entry.file.data(), entry.file.size(), options, image, context)) {
+      fprintf(stderr, "Decoding %s failed\n", entry.name.c_str());
+      return false;
+   }
+
+   uint32_t iterations = 0;
+   uint64_t allocations = 0;
+   double seconds = 0;
+
+   while (seconds < MIN_BENCH_SECONDS || iterations < MIN_BENCH_ITERATIONS) {
+      uint64_t allocationsBefore = s_AllocationCount;
+      auto start = std::chrono::steady_clock::now();
+
+      bool isDecoded = DecodePNG(entry.file.data(), entry.file.size(), options, image, context);
+
+      auto end = std::chrono::steady_clock::now();
+      allocations += s_AllocationCount - allocationsBefore;
+
+      if (!isDecoded) {
+         fprintf(stderr, "Decoding %s failed\n", entry.name.c_str());
+         return false;
+      }
+
+      seconds += std::chrono::duration<double>(end - start).count();
+      iterations++;
+   }
+
+   *secondsPerDecode = seconds / iterations;
+   *allocationsPerDecode = (double) allocations / iterations;
+   return true;
+}
+
+//Allocations of a decode that starts from nothing, as LoadPNG does
+static uint64_t CountColdAllocations(const CorpusEntry& entry) {
+   uint64_t allocationsBefore = s_AllocationCount;
+   {
+      PNGImage image;
+      DecodePNG(entry.file.data(), entry.file.size(), PNGDecodeOptions(), image);
+   }
+
+   return s_AllocationCount - allocationsBefore;
+}
+
+//Every thread decodes the whole corpus with its own context, the results must match a decode on this thread
+static bool TryBenchmarkParallelContexts(const std::vector<CorpusEntry>& corpus) {
+   const uint32_t threadCount = 4;
+   const uint32_t rounds = 3;
+
+   PNGDecodeOptions single;
+   single.threading = DecodeThreading::SINGLE;
+
+   std::vector<PNGImage> references(corpus.size());
+   for (size_t i = 0; i < corpus.size(); i++) {
+      if (!DecodePNG(corpus[i].file.data(), corpus[i].file.size(), single, references[i])) {
+         return false;
+      }
+   }
+
+   std::atomic<uint32_t> mismatches{0};
+   auto start = std::chrono::steady_clock::now();
+
+   std::vector<std::thread> threads;
+   for (uint32_t t = 0; t < threadCount; t++) {
+      threads.emplace_back([&]() {
+         PNGDecoderContext context;
+         PNGImage image;
+
+         for (uint32_t round = 0; round < rounds; round++) {
+            for (size_t i = 0; i < corpus.size(); i++) {
+               bool isDecoded = DecodePNG(corpus[i].file.data(), corpus[i].file.size(), single, image, context);
+               if (!isDecoded || image.pixels != references[i].pixels) {
+                  mismatches++;
+               }
+            }
+         }
+      });
+   }
+
+   for (std::thread& thread : threads) {
+      thread.join();
+   }
+
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   printf("\n%u threads with a context each: %u decodes in %.1f ms, %s\n", threadCount, (uint32_t) (threadCount * rounds * corpus.size()), seconds * 1e3, mismatches ? "MISMATCH" : "ok");
+
+   return !mismatches;
+}
+
+//The same atlas in every format: file size against decode time. Lossless formats must decode to the 8 bit RGBA pixels
+static bool TryBenchmarkFormats() {
+   const uint32_t size = 512;
+   std::vector<uint32_t> pixels = MakeAtlasPixels(size, size);
+
+   printf("\n%-28s %11s %10s %10s %10s %10s\n", "format", "size", "file KB", "of rgba", "ms", "check");
+
+   PNGImage reference;
+   size_t referenceSize = 0;
+
+   for (const FormatCase& format : s_FormatCases) {
+      CorpusEntry entry{format.name, size, size, EncodeAtlas(pixels, size, size, format)};
+
+      PNGImage image;
+      if (!DecodePNG(entry.file.data(), entry.file.size(), PNGDecodeOptions(), image)) {
+         fprintf(stderr, "Decoding %s failed\n", entry.name.c_str());
+         return false;
+      }
+
+      if (!referenceSize) {//The first case is 8 bit RGBA
+         reference = image;
+         referenceSize = entry.file.size();
+      }
+
+      double secondsPerDecode;
+      double allocations;
+      if (!TryTimeDecode(entry, PNGDecodeOptions(), &secondsPerDecode, &allocations)) {
+         return false;
+      }
+
+      bool isMatching = !format.isLossless || image.pixels == reference.pixels;
+      std::string imageSize = std::to_string(size) + "x" + std::to_string(size);
+      printf("%-28s %11s %10.1f %9.0f%% %10.3f %10s\n", entry.name.c_str(), imageSize.c_str(), entry.file.size() / 1024.0, entry.file.size() * 100.0 / referenceSize, secondsPerDecode * 1e3, format.isLossless ? (isMatching ? "ok" : "MISMATCH") : "lossy");
+
+      if (!isMatching) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//Every conversion kernel is checked against the scalar one on random rows of awkward widths, then timed on a long row
+static bool TryBenchmarkConvertKernels() {
+   static const char* levelNames[] = {"scalar", "sse2", "avx2"};
+   static const char* modeNames[] = {"color key", "premultiplied"};
+   static const size_t widths[] = {1, 3, 5, 7, 8, 9, 10, 15, 16, 17, 31, 33, 100};
+   const size_t benchWidth = 4096;
+   const uint32_t keyPixel = 0x00FF00FF;
+
+   SimdLevel bestLevel = GetBestSimdLevel();
+
+   std::vector<uint8_t> source(benchWidth * 4);
+   uint32_t seed = 12345;
+   for (uint8_t& value : source) {
+      seed = seed * 1103515245 + 12345;
+      value = (uint8_t) (seed >> 16);
+   }
+
+   std::vector<uint32_t> expected(benchWidth);
+   std::vector<uint32_t> actual(benchWidth);
+
+   printf("\n%-28s %11s %10s\n", "conversion kernel", "check", "MB/s");
+
+   for (uint8_t bbp = 3; bbp <= 4; bbp++) {
+      for (AlphaMode mode : {AlphaMode::COLOR_KEY, AlphaMode::PREMULTIPLIED}) {
+         ConvertRowFunc reference = GetConvertKernel(bbp, mode, SimdLevel::SCALAR);
+
+         for (uint32_t level = 0; level <= (uint32_t) bestLevel; level++) {
+            ConvertRowFunc kernel = GetConvertKernel(bbp, mode, (SimdLevel) level);
+
+            bool isMatching = true;
+            for (size_t width : widths) {
+               //Source ends exactly at the row end, so overreads show up under sanitizers
+               std::vector<uint8_t> row(source.begin(), source.begin() + width * bbp);
+               reference(expected.data(), row.data(), width, keyPixel);
+               actual.assign(benchWidth, 0xDEADBEEF);
+               kernel(actual.data(), row.data(), width, keyPixel);
+
+               isMatching &= memcmp(expected.data(), actual.data(), width * sizeof(uint32_t)) == 0 && actual[width] == 0xDEADBEEF;
+            }
+
+            uint32_t iterations = 0;
+            double seconds = 0;
+            while (seconds < MIN_BENCH_SECONDS || iterations < MIN_BENCH_ITERATIONS) {
+               auto start = std::chrono::steady_clock::now();
+               for (uint32_t i = 0; i < 256; i++) {
+                  kernel(actual.data(), source.data(), benchWidth, keyPixel);
+               }
+               seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+               iterations++;
+            }
+
+            double megabytesPerSecond = (double) benchWidth * 4 * 256 * iterations / seconds / (1024.0 * 1024.0);
+            std::string name = std::string(bbp == 3 ? "rgb " : "rgba ") + modeNames[(int) mode] + " " + levelNames[level];
+            printf("%-28s %11s %10.1f\n", name.c_str(), isMatching ? "ok" : "MISMATCH", megabytesPerSecond);
+
+            if (!isMatching) {
+               return false;
+            }
+         }
+      }
+   }
+
+   return true;
+}
+
+//Box scaling on tiles with known results, then timed on atlas sized tiles at the sizes the UI draws
+static bool TryBenchmarkResample() {
+   const uint32_t tileSize = 64;
+   const uint32_t keyPixel = 0x00FF0000;
+   const uint32_t color = 0x00204080;
+   static const uint32_t sizes[] = {28, 22, 32, 100};
+
+   std::vector<uint32_t> tile(tileSize * tileSize);
+   std::vector<uint32_t> scaled(100 * 100);
+
+   printf("\n%-28s %11s %10s %10s\n", "box scaling", "size", "check", "us/tile");
+
+   for (uint32_t size : sizes) {
+      bool isMatching = true;
+
+      //A flat color stays flat, a keyed tile stays keyed
+      for (uint32_t fill : {color, keyPixel}) {
+         std::fill(tile.begin(), tile.end(), fill);
+         ResampleBox(tile.data(), tileSize, tileSize, tileSize, scaled.data(), size, size, size, AlphaMode::COLOR_KEY, keyPixel);
+         isMatching &= std::all_of(scaled.begin(), scaled.begin() + size * size, [fill](uint32_t pixel) { return pixel == fill; });
+      }
+
+      //Keyed left half, the key never bleeds into the color and the columns split at the middle
+      for (uint32_t i = 0; i < tileSize * tileSize; i++) {
+         tile[i] = i % tileSize < tileSize / 2 ? keyPixel : color;
+      }
+      ResampleBox(tile.data(), tileSize, tileSize, tileSize, scaled.data(), size, size, size, AlphaMode::COLOR_KEY, keyPixel);
+      for (uint32_t i = 0; i < size * size; i++) {
+         double center = (i % size + 0.5) * tileSize / size;
+         isMatching &= scaled[i] == color || scaled[i] == keyPixel;
+         isMatching &= center < tileSize / 2 - 1 ? scaled[i] == keyPixel : (center > tileSize / 2 + 1 ? scaled[i] == color : true);
+      }
+
+      //Premultiplied pixels average with their alpha
+      std::fill(tile.begin(), tile.end(), 0x80102040);
+      ResampleBox(tile.data(), tileSize, tileSize, tileSize, scaled.data(), size, size, size, AlphaMode::PREMULTIPLIED, 0);
+      isMatching &= std::all_of(scaled.begin(), scaled.begin() + size * size, [](uint32_t pixel) { return pixel == 0x80102040; });
+
+      uint32_t seed = 4242;
+      for (uint32_t& pixel : tile) {
+         seed = seed * 1103515245 + 12345;
+         pixel = (seed >> 16) % 4 ? (seed & 0x00FFFFFF) : keyPixel;
+      }
+
+      uint32_t iterations = 0;
+      double seconds = 0;
+      while (seconds < MIN_BENCH_SECONDS || iterations < MIN_BENCH_ITERATIONS) {
+         auto start = std::chrono::steady_clock::now();
+         ResampleBox(tile.data(), tileSize, tileSize, tileSize, scaled.data(), size, size, size, AlphaMode::COLOR_KEY, keyPixel);
+         seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+         iterations++;
+      }
+
+      std::string name = std::to_string(tileSize) + "x" + std::to_string(tileSize) + " color key";
+      std::string sizeName = std::to_string(size) + "x" + std::to_string(size);
+      printf("%-28s %11s %10s %10.2f\n", name.c_str(), sizeName.c_str(), isMatching ? "ok" : "MISMATCH", seconds * 1e6 / iterations);
+
+      if (!isMatching) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//Time to the first icon: the whole atlas against opening a pack and decoding one sprite.
+//Every sprite must decode to its tile of the atlas, and a cut off pack must not open
+static bool TryBenchmarkSpritePack() {
+   const uint32_t atlasSize = 512;
+   const uint32_t tileSize = 64;
+   const uint32_t tilesPerRow = atlasSize / tileSize;
+
+   std::vector<uint32_t> source = MakeAtlasPixels(atlasSize, atlasSize);
+   CorpusEntry atlasEntry{"atlas", atlasSize, atlasSize, EncodeAtlas(source, atlasSize, atlasSize, s_FormatCases[0])};
+
+   PNGDecodeOptions options;
+   options.transparentPixel = 0x00FF0000;
+
+   PNGImage atlas;
+   if (!DecodePNG(atlasEntry.file.data(), atlasEntry.file.size(), options, atlas)) {
+      return false;
+   }
+
+   std::vector<SpriteRect> rects;
+   for (uint32_t i = 0; i < tilesPerRow * tilesPerRow; i++) {
+      rects.push_back({i % tilesPerRow * tileSize, i / tilesPerRow * tileSize, tileSize, tileSize});
+   }
+
+   std::vector<uint8_t> pack;
+   SpritePackView view;
+   if (!TryBuildSpritePack(atlas.pixels.data(), atlas.width, atlas.width, atlas.height, options.transparentPixel, rects, pack) || !view.TryOpen(pack.data(), pack.size())) {
+      fprintf(stderr, "Building the sprite pack failed\n");
+      return false;
+   }
+
+   bool isMatching = view.GetSpriteCount() == rects.size() && !SpritePackView().TryOpen(pack.data(), pack.size() - 1);
+   PNGDecoderContext context;
+   PNGImage sprite;
+
+   for (uint32_t i = 0; i < view.GetSpriteCount() && isMatching; i++) {
+      isMatching = view.TryDecodeSprite(i, options, sprite, context);
+
+      for (uint32_t y = 0; y < tileSize && isMatching; y++) {
+         const uint32_t* tileRow = &atlas.pixels[(size_t) (rects[i].y + y) * atlas.width + rects[i].x];
+         isMatching = std::equal(tileRow, tileRow + tileSize, &sprite.pixels[(size_t) y * tileSize]);
+      }
+   }
+
+   double atlasSeconds;
+   double allocations;
+   if (!TryTimeDecode(atlasEntry, options, &atlasSeconds, &allocations)) {
+      return false;
+   }
+
+   uint32_t iterations = 0;
+   double spriteSeconds = 0;
+   while (spriteSeconds < MIN_BENCH_SECONDS || iterations < MIN_BENCH_ITERATIONS) {
+      auto start = std::chrono::steady_clock::now();
+      SpritePackView firstView;
+      bool isDecoded = firstView.TryOpen(pack.data(), pack.size()) && firstView.TryDecodeSprite(iterations % firstView.GetSpriteCount(), options, sprite, context);
+      spriteSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      iterations++;
+
+      isMatching &= isDecoded;
+   }
+
+   std::string size = std::to_string(atlasSize) + "x" + std::to_string(atlasSize);
+   printf("\n%-28s %11s %10s %10s %10s\n", "sprite pack", "size", "file KB", "first ms", "check");
+   printf("%-28s %11s %10.1f %10.3f\n", "whole atlas", size.c_str(), atlasEntry.file.size() / 1024.0, atlasSeconds * 1e3);
+   printf("%-28s %11s %10.1f %10.3f %10s\n", (std::to_string(rects.size()) + " sprites, one decoded").c_str(), size.c_str(), pack.size() / 1024.0, spriteSeconds * 1e3 / iterations, isMatching ? "ok" : "MISMATCH");
+
+   return isMatching;
+}
+
+//The zlib stream of a PNG file, IDAT chunks joined, with the padding TryInflateParallel needs
+static std::vector<uint8_t> GetImageData(const std::vector<uint8_t>& file) {
+   std::vector<uint8_t> data;
+
+   for (size_t offset = 8; offset + 12 <= file.size();) {
+      uint32_t length = (uint32_t) file[offset] << 24 | (uint32_t) file[offset + 1] << 16 | (uint32_t) file[offset + 2] << 8 | file[offset + 3];
+      if (!memcmp(&file[offset + 4], "IDAT", 4)) {
+         data.insert(data.end(), file.begin() + offset + 8, file.begin() + offset + 8 + length);
+      }
+      offset += 12 + (size_t) length;
+   }
+
+   data.resize(data.size() + PARALLEL_INFLATE_PADDING);
+   return data;
+}
+
+//The same bytes as stored blocks only, a stream without any dynamic block to split at
+static std::vector<uint8_t> MakeStoredStream(const std::vector<uint8_t>& inflated) {
+   std::vector<uint8_t> data = {0x78, 0x01};
+
+   for (size_t offset = 0; offset < inflated.size(); offset += 65535) {
+      size_t length = inflated.size() - offset < 65535 ? inflated.size() - offset : 65535;
+      data.push_back(offset + length == inflated.size() ? 1 : 0);
+      data.insert(data.end(), {(uint8_t) length, (uint8_t) (length >> 8), (uint8_t) ~length, (uint8_t) (~length >> 8)});
+      data.insert(data.end(), inflated.begin() + offset, inflated.begin() + offset + length);
+   }
+
+   uint32_t adler = UpdateAdler32(1, inflated.data(), inflated.size());
+   data.insert(data.end(), {(uint8_t) (adler >> 24), (uint8_t) (adler >> 16), (uint8_t) (adler >> 8), (uint8_t) adler});
+
+   data.resize(data.size() + PARALLEL_INFLATE_PADDING);
+   return data;
+}
+
+//Inflates data on threadCount threads until the time and iteration minimums are met, the output must match reference
+static bool TryTimeParallelInflate(const std::vector<uint8_t>& data, const std::vector<uint8_t>& reference, uint32_t threadCount, double* secondsPerInflate, ParallelInflateStats* stats) {
+   std::vector<uint8_t> out(reference.size() + INFLATE_COPY_OVERRUN);
+   size_t length = data.size() - PARALLEL_INFLATE_PADDING;
+
+   uint32_t iterations = 0;
+   double seconds = 0;
+   while (seconds < MIN_BENCH_SECONDS || iterations < MIN_BENCH_ITERATIONS) {
+      auto start = std::chrono::steady_clock::now();
+      bool isInflated = TryInflateParallel(data.data(), length, out.data(), reference.size(), threadCount, true, stats);
+      seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      iterations++;
+
+      if (!isInflated || !std::equal(reference.begin(), reference.end(), out.begin())) {
+         return false;
+      }
+   }
+
+   *secondsPerInflate = seconds / iterations;
+   return true;
+}
+
+//Scaling of the parallel inflate from one thread to every core on a large image, plus a whole decode in each mode.
+//Every output must match the serial one, a stream without split points must still inflate, a corrupt one must fail
+static bool TryBenchmarkParallelInflate() {
+   const uint32_t width = 4096;
+   const uint32_t height = 2048;
+
+   CorpusEntry entry{"rgba cycled filters", width, height, MakePNG(width, height, 4, FILTER_TYPE_COUNT)};
+   std::vector<uint8_t> data = GetImageData(entry.file);
+   size_t length = data.size() - PARALLEL_INFLATE_PADDING;
+
+   std::vector<uint8_t> reference(((size_t) width * 4 + 1) * height);
+   std::vector<uint8_t> out(reference.size() + INFLATE_COPY_OVERRUN);
+   if (!TryInflateParallel(data.data(), length, out.data(), reference.size(), 1, true)) {
+      fprintf(stderr, "Inflating %s failed\n", entry.name.c_str());
+      return false;
+   }
+   std::copy(out.begin(), out.begin() + reference.size(), reference.begin());
+
+   uint32_t maxThreads = std::thread::hardware_concurrency();
+   if (maxThreads < 4) {//Splitting is checked even without the cores to gain from it
+      maxThreads = 4;
+   }
+
+   std::string size = std::to_string(width) + "x" + std::to_string(height);
+   printf("\n%-28s %11s %10s %10s %10s %10s %10s\n", "parallel inflate", "size", "threads", "MB/s", "speedup", "segments", "check");
+
+   double serialSeconds = 0;
+   for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+      double seconds;
+      ParallelInflateStats stats;
+      bool isMatching = TryTimeParallelInflate(data, reference, threadCount, &seconds, &stats);
+      if (threadCount == 1) {
+         serialSeconds = seconds;
+      }
+
+      std::string segments = std::to_string(1 + stats.linkedCount) + "/" + std::to_string(stats.segmentCount);
+      printf("%-28s %11s %10u %10.1f %9.2fx %10s %10s\n", entry.name.c_str(), size.c_str(), threadCount, reference.size() / seconds / (1024.0 * 1024.0), serialSeconds / seconds, segments.c_str(), isMatching ? "ok" : "MISMATCH");
+
+      if (!isMatching) {
+         return false;
+      }
+   }
+
+   //Stored blocks give no block header to search for, every segment fails and the first one inflates everything
+   std::vector<uint8_t> stored = MakeStoredStream(reference);
+   double storedSeconds;
+   ParallelInflateStats storedStats;
+   bool isStoredMatching = TryTimeParallelInflate(stored, reference, maxThreads, &storedSeconds, &storedStats) && !storedStats.linkedCount;
+   std::string storedSegments = std::to_string(1 + storedStats.linkedCount) + "/" + std::to_string(storedStats.segmentCount);
+   printf("%-28s %11s %10u %10.1f %10s %10s %10s\n", "stored blocks, no splits", size.c_str(), maxThreads, reference.size() / storedSeconds / (1024.0 * 1024.0), "", storedSegments.c_str(), isStoredMatching ? "ok" : "MISMATCH");
+
+   std::vector<uint8_t> corrupt = data;
+   corrupt[length * 3 / 4] ^= 0x10;
+   bool isCorruptFailed = !TryInflateParallel(corrupt.data(), length, out.data(), reference.size(), maxThreads, true);
+   printf("%-28s %11s %10u %10s %10s %10s %10s\n", "flipped bit", size.c_str(), maxThreads, "", "", "", isCorruptFailed ? "ok" : "NOT FOUND");
+
+   if (!isStoredMatching || !isCorruptFailed) {
+      return false;
+   }
+
+   //Whole decodes, parallel mode defilters after inflating rather than alongside
+   static const DecodeThreading modes[] = {DecodeThreading::SINGLE, DecodeThreading::PIPELINED, DecodeThreading::PARALLEL};
+   static const char* modeNames[] = {"single", "pipelined", "parallel"};
+
+   printf("\n%-28s %11s %10s %10s %10s\n", "whole decode", "size", "mode", "ms", "check");
+
+   PNGImage referenceImage;
+   for (uint32_t i = 0; i < 3; i++) {
+      PNGDecodeOptions options;
+      options.threading = modes[i];
+
+      PNGImage image;
+      double seconds;
+      double allocations;
+      if (!DecodePNG(entry.file.data(), entry.file.size(), options, image) || !TryTimeDecode(entry, options, &seconds, &allocations)) {
+         fprintf(stderr, "Decoding %s failed\n", entry.name.c_str());
+         return false;
+      }
+
+      if (!i) {
+         referenceImage = image;
+      }
+
+      bool isMatching = image.pixels == referenceImage.pixels;
+      printf("%-28s %11s %10s %10.3f %10s\n", entry.name.c_str(), size.c_str(), modeNames[i], seconds * 1e3, isMatching ? "ok" : "MISMATCH");
+
+      if (!isMatching) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//Checksum kernels against the table ones on awkward lengths and offsets, then timed on a buffer that fits in cache
+static bool TryBenchmarkChecksums() {
+   static const char* levelNames[] = {"scalar", "sse2", "avx2"};
+   static const size_t lengths[] = {0, 1, 15, 16, 17, 63, 64, 65, 127, 1000, 5552, 5553, 20000};
+   const size_t benchLength = 256 * 1024;
+
+   std::vector<uint8_t> data(benchLength + 16);
+   uint32_t seed = 777;
+   for (uint8_t& value : data) {
+      seed = seed * 1103515245 + 12345;
+      value = (uint8_t) (seed >> 16);
+   }
+
+   struct Kernel {
+      std::string name;
+      ChecksumFunc func;
+      ChecksumFunc reference;
+      uint32_t initial;
+   };
+
+   std::vector<Kernel> kernels;
+   kernels.push_back({"crc32 slice-by-8", GetCrc32Kernel(false), GetCrc32Kernel(false), 0});
+   if (GetCrc32Kernel(true) != GetCrc32Kernel(false)) {
+      kernels.push_back({"crc32 carry-less", GetCrc32Kernel(true), GetCrc32Kernel(false), 0});
+   }
+
+   for (uint32_t level = 0; level <= (uint32_t) GetBestSimdLevel(); level++) {
+      kernels.push_back({std::string("adler32 ") + levelNames[level], GetAdler32Kernel((SimdLevel) level), GetAdler32Kernel(SimdLevel::SCALAR), 1});
+   }
+
+   printf("\n%-28s %11s %10s\n", "checksum kernel", "check", "MB/s");
+
+   for (const Kernel& kernel : kernels) {
+      bool isMatching = true;
+      for (size_t length : lengths) {
+         for (size_t offset = 0; offset < 4; offset++) {
+            isMatching &= kernel.func(kernel.initial, data.data() + offset, length) == kernel.reference(kernel.initial, data.data() + offset, length);
+         }
+      }
+
+      uint32_t iterations = 0;
+      double seconds = 0;
+      volatile uint32_t sink = 0;//Keeps the calls from being optimized out
+      while (seconds < MIN_BENCH_SECONDS || iterations < MIN_BENCH_ITERATIONS) {
+         auto start = std::chrono::steady_clock::now();
+         sink = kernel.func(kernel.initial, data.data(), benchLength);
+         seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+         iterations++;
+      }
+      isMatching &= sink == kernel.reference(kernel.initial, data.data(), benchLength);
+
+      double megabytesPerSecond = (double) benchLength * iterations / seconds / (1024.0 * 1024.0);
+      printf("%-28s %11s %10.1f\n", kernel.name.c_str(), isMatching ? "ok" : "MISMATCH", megabytesPerSecond);
+
+      if (!isMatching) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+int main(int argc, char** argv) {
+   std::vector<CorpusEntry> corpus;
+
+   if (argc > 1) {
+      for (int i = 1; i < argc; i++) {
+         AddFile(corpus, argv[i]);
+      }
+   } else {
+      AddGenerated(corpus);
+#ifdef BENCHMARK_SOURCE_DIR
+      AddFile(corpus, std::string(BENCHMARK_SOURCE_DIR) + "/resources/icon_atlas.png");
+      AddFile(corpus, std::string(BENCHMARK_SOURCE_DIR) + "/images/1.png");
+#endif
+   }
+
+   printf("%-28s %11s %10s %10s %10s %12s %12s\n", "image", "size", "file KB", "MB/s", "ns/pixel", "cold allocs", "warm allocs");
+
+   double totalSeconds = 0;
+   uint64_t totalPixels = 0;
+
+   for (const CorpusEntry& entry : corpus) {
+      double secondsPerDecode;
+      double allocations;
+      if (!TryTimeDecode(entry, PNGDecodeOptions(), &secondsPerDecode, &allocations)) {
+         return 1;
+      }
+
+      //Throughput is counted over the decoded BGRA output
+      uint64_t pixels = (uint64_t) entry.width * entry.height;
+      double nsPerPixel = secondsPerDecode * 1e9 / (double) pixels;
+
+      std::string size = std::to_string(entry.width) + "x" + std::to_string(entry.height);
+      printf("%-28s %11s %10.1f %10.1f %10.2f %12llu %12.1f\n", entry.name.c_str(), size.c_str(), entry.file.size() / 1024.0, ToMegabytesPerSecond(pixels, secondsPerDecode), nsPerPixel, (unsigned long long) CountColdAllocations(entry), allocations);
+
+      totalSeconds += secondsPerDecode;
+      totalPixels += pixels;
+   }
+
+   if (totalPixels) {
+      printf("\nTotal: %.1f MB/s, %.2f ns/pixel\n", ToMegabytesPerSecond(totalPixels, totalSeconds), totalSeconds * 1e9 / (double) totalPixels);
+   }
+
+   //Wall clock of the same decode with the row thread forced off and on
+   printf("\n%-28s %11s %10s %10s %10s %6s\n", "pipelined decode", "size", "single ms", "piped ms", "gain", "auto");
+
+   PNGDecodeOptions single;
+   single.threading = DecodeThreading::SINGLE;
+   PNGDecodeOptions pipelined;
+   pipelined.threading = DecodeThreading::PIPELINED;
+
+   for (const CorpusEntry& entry : corpus) {
+      double singleSeconds;
+      double pipelinedSeconds;
+      double allocations;
+      if (!TryTimeDecode(entry, single, &singleSeconds, &allocations) || !TryTimeDecode(entry, pipelined, &pipelinedSeconds, &allocations)) {
+         return 1;
+      }
+
+      PNGHeader header{};
+      header.width = entry.width;
+      header.height = entry.height;
+      bool isAutoPipelined = IsPipelineWorth(PNGDecodeOptions(), header);
+      std::string size = std::to_string(entry.width) + "x" + std::to_string(entry.height);
+      printf("%-28s %11s %10.3f %10.3f %9.2fx %6s\n", entry.name.c_str(), size.c_str(), singleSeconds * 1e3, pipelinedSeconds * 1e3, singleSeconds / pipelinedSeconds, isAutoPipelined ? "piped" : "single");
+   }
+
+   //Cost of the CRC-32 and Adler-32 checks against a decode that skips them
+   printf("\n%-28s %11s %10s %10s %10s\n", "verification", "size", "off ms", "on ms", "overhead");
+
+   PNGDecodeOptions unverified;
+   unverified.isVerifying = false;
+
+   double totalUnverified = 0;
+   double totalVerified = 0;
+
+   for (const CorpusEntry& entry : corpus) {
+      double unverifiedSeconds;
+      double verifiedSeconds;
+      double allocations;
+      if (!TryTimeDecode(entry, unverified, &unverifiedSeconds, &allocations) || !TryTimeDecode(entry, PNGDecodeOptions(), &verifiedSeconds, &allocations)) {
+         return 1;
+      }
+
+      std::string size = std::to_string(entry.width) + "x" + std::to_string(entry.height);
+      printf("%-28s %11s %10.3f %10.3f %9.1f%%\n", entry.name.c_str(), size.c_str(), unverifiedSeconds * 1e3, verifiedSeconds * 1e3, (verifiedSeconds / unverifiedSeconds - 1) * 100);
+
+      totalUnverified += unverifiedSeconds;
+      totalVerified += verifiedSeconds;
+   }
+
+   if (totalUnverified > 0) {
+      printf("\nVerification overhead: %.1f%%\n", (totalVerified / totalUnverified - 1) * 100);
+   }
+
+   if (!TryBenchmarkParallelContexts(corpus)) {
+      return 1;
+   }
+
+   return TryBenchmarkFormats() && TryBenchmarkConvertKernels() && TryBenchmarkResample() && TryBenchmarkSpritePack() && TryBenchmarkParallelInflate() && TryBenchmarkChecksums() ? 0 : 1;
+}
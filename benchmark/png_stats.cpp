@@ -0,0 +1,144 @@
+#include "png_decoder.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//Prints where the decode time and memory of PNG files go, to tune assets before they ship.
+//Usage: PngStats [--single | --pipelined | --parallel] [--no-verify] file.png ...
+
+static bool TryReadFile(const char* fileName, std::vector<uint8_t>& out);
+static const char* GetColorTypeName(uint8_t colorType);
+static void PrintStats(const char* fileName, const PNGHeader& header, const PNGDecodeStats& stats);
+
+int main(int argc, char** argv) {
+   PNGDecodeOptions options;
+   std::vector<const char*> fileNames;
+
+   for (int i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "--single")) {
+         options.threading = DecodeThreading::SINGLE;
+      } else if (!strcmp(argv[i], "--pipelined")) {
+         options.threading = DecodeThreading::PIPELINED;
+      } else if (!strcmp(argv[i], "--parallel")) {
+         options.threading = DecodeThreading::PARALLEL;
+      } else if (!strcmp(argv[i], "--no-verify")) {
+         options.isVerifying = false;
+      } else {
+         fileNames.push_back(argv[i]);
+      }
+   }
+
+   if (fileNames.empty()) {
+      fprintf(stderr, "Usage: PngStats [--single | --pipelined | --parallel] [--no-verify] file.png ...\n");
+      return 1;
+   }
+
+   bool isFailed = false;
+
+   for (const char* fileName : fileNames) {
+      PNGDecodeStats stats;
+      options.stats = &stats;
+
+      auto start = std::chrono::steady_clock::now();
+
+      std::vector<uint8_t> file;
+      if (!TryReadFile(fileName, file)) {
+         fprintf(stderr, "%s: can't read the file\n", fileName);
+         isFailed = true;
+         continue;
+      }
+
+      double fileSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      //Only the header, the decoder stops there until it has an output
+      PNGStreamDecoder headerDecoder;
+      headerDecoder.Feed(file.data(), file.size());
+
+      PNGImage image;
+      bool isDecoded = DecodePNG(file.data(), file.size(), options, image);
+      stats.fileSeconds = fileSeconds;
+
+      if (!isDecoded) {
+         fprintf(stderr, "%s: decoding failed\n", fileName);
+         isFailed = true;
+      }
+
+      PrintStats(fileName, headerDecoder.GetHeader(), stats);
+   }
+
+   return isFailed ? 1 : 0;
+}
+
+static bool TryReadFile(const char* fileName, std::vector<uint8_t>& out) {
+   std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+   if (!file.is_open()) {
+      return false;
+   }
+
+   std::streamoff size = file.tellg();
+   if (size <= 0) {
+      return false;
+   }
+
+   out.resize((size_t) size);
+   file.seekg(0, std::ios_base::beg);
+   return (bool) file.read((char*) out.data(), size);
+}
+
+static const char* GetColorTypeName(uint8_t colorType) {
+   switch (colorType) {
+      case PNG_COLOR_GRAY:
+         return "gray";
+      case PNG_COLOR_RGB:
+         return "rgb";
+      case PNG_COLOR_PALETTE:
+         return "palette";
+      case PNG_COLOR_GRAY_ALPHA:
+         return "gray+alpha";
+      case PNG_COLOR_RGBA:
+         return "rgba";
+   }
+
+   return "unknown";
+}
+
+static void PrintStats(const char* fileName, const PNGHeader& header, const PNGDecodeStats& stats) {
+   static const char* filterNames[FILTER_TYPE_COUNT] = {"none", "sub", "up", "avg", "paeth"};
+
+   printf("\n%s: %ux%u %s, %u bit%s\n", fileName, header.width, header.height, GetColorTypeName(header.colorType), header.bitDepth, header.interlaceMethod ? ", interlaced" : "");
+
+   double decodeSeconds = stats.chunkSeconds + stats.inflateSeconds + stats.defilterSeconds + stats.convertSeconds;
+   const char* stageNames[] = {"file", "chunks", "inflate", "defilter", "convert"};
+   double stageSeconds[] = {stats.fileSeconds, stats.chunkSeconds, stats.inflateSeconds, stats.defilterSeconds, stats.convertSeconds};
+
+   for (int i = 0; i < 5; i++) {
+      //File reading is not part of the decode
+      double share = i && decodeSeconds > 0 ? stageSeconds[i] * 100 / decodeSeconds : 0;
+      printf("  %-10s %10.3f ms", stageNames[i], stageSeconds[i] * 1e3);
+      if (i) {
+         printf(" %6.1f%%", share);
+      }
+      printf("\n");
+   }
+
+   printf("  deflate blocks: %u stored, %u fixed, %u dynamic\n", stats.blockCounts[0], stats.blockCounts[1], stats.blockCounts[2]);
+   if (stats.inflateSegments) {
+      printf("  inflated in parallel: %u part%s\n", stats.inflateSegments, stats.inflateSegments == 1 ? "" : "s");
+   }
+
+   uint32_t rowCount = 0;
+   for (uint32_t count : stats.filterRows) {
+      rowCount += count;
+   }
+
+   printf("  filters:");
+   for (int i = 0; i < FILTER_TYPE_COUNT; i++) {
+      printf(" %s %u (%.0f%%)%s", filterNames[i], stats.filterRows[i], rowCount ? stats.filterRows[i] * 100.0 / rowCount : 0.0, i + 1 < FILTER_TYPE_COUNT ? "," : "\n");
+   }
+
+   printf("  bytes: %.1f KB in, %.1f KB inflated (%.1fx), %.1f KB out\n", stats.bytesIn / 1024.0, stats.bytesInflated / 1024.0, stats.bytesIn ? (double) stats.bytesInflated / stats.bytesIn : 0.0, stats.bytesOut / 1024.0);
+   printf("  scratch: %.1f KB\n", stats.scratchBytes / 1024.0);
+}
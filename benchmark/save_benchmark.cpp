@@ -0,0 +1,576 @@
+#include "record.h"
+#include "record_store.h"
+#include "save_worker.h"
+#include "settings.h"
+#include "state_journal.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Saves and loads a generated set of records in the text and the binary format,
+//then times saves of 10000 and 100000 records at every durability level, appends to the state journal and
+//single record edits, adds and deletes in the record store next to a rewrite of the whole file.
+//Last it compares the time the calling thread spends on saves when it writes them itself and when the save worker does.
+//Usage: SaveBenchmark [recordCount]
+
+#define DEFAULT_RECORD_COUNT 100000
+#define DURABILITY_ROUNDS 3//Best of, flush times vary a lot between runs
+#define JOURNAL_CHANGE_COUNT 1000
+#define STORE_EDIT_COUNT 1000
+#define STORE_ADD_COUNT 100
+#define WORKER_TICK_COUNT 100
+#define WORKER_TICK_CHANGE_COUNT 10//Status changes one tick makes
+#define WORKER_RECORD_COUNT 1000
+
+static std::vector<Record*> MakeRecords(uint32_t count);
+static bool IsSameRecord(const Record& a, const Record& b);
+static bool IsSameList(const std::vector<Record*>& a, const std::vector<Record*>& b);
+static void DeleteRecords(std::vector<Record*>& records);
+static bool TryBenchmarkFormat(const std::vector<Record*>& records, SaveFormat format, const std::filesystem::path& path);
+static bool TryBenchmarkMigration(const std::vector<Record*>& records, const std::filesystem::path& textPath, const std::filesystem::path& binaryPath);
+static bool TryCheckSettings(const std::filesystem::path& path);
+static double TimeSave(Serializer& serializer, const std::vector<Record*>& records, SaveFormat format, const std::filesystem::path& path);
+static bool TryBenchmarkDurability(const std::filesystem::path& directory);
+static bool TryBenchmarkJournal(const std::filesystem::path& directory);
+static bool TryBenchmarkRecordStore(const std::filesystem::path& directory);
+static bool TryBenchmarkSaveWorker(const std::filesystem::path& directory);
+static bool TryCheckSaveFailures(const std::filesystem::path& directory);
+static bool TryCheckContentHashes(const std::vector<Record*>& records);
+
+int main(int argc, char** argv) {
+   uint32_t recordCount = argc > 1 ? (uint32_t) strtoul(argv[1], nullptr, 10) : DEFAULT_RECORD_COUNT;
+   if (!recordCount) {
+      fprintf(stderr, "Usage: SaveBenchmark [recordCount]\n");
+      return 1;
+   }
+
+   std::filesystem::path directory = std::filesystem::temp_directory_path() / "save_benchmark";
+   std::filesystem::path textPath = directory / "records.txt";
+   std::filesystem::path binaryPath = directory / "records.bin";
+
+   std::vector<Record*> records = MakeRecords(recordCount);
+
+   printf("%-28s %11s %10s %10s %10s %10s\n", "records", "count", "file KB", "save ms", "load ms", "check");
+   bool isPassed = TryBenchmarkFormat(records, SaveFormat::TEXT, textPath);
+   isPassed = TryBenchmarkFormat(records, SaveFormat::BINARY, binaryPath) && isPassed;
+   isPassed = TryBenchmarkMigration(records, textPath, binaryPath) && isPassed;
+   isPassed = TryCheckSettings(directory / "settings.bin") && isPassed;
+   isPassed = TryBenchmarkDurability(directory) && isPassed;
+   isPassed = TryBenchmarkJournal(directory) && isPassed;
+   isPassed = TryBenchmarkRecordStore(directory) && isPassed;
+   isPassed = TryBenchmarkSaveWorker(directory) && isPassed;
+   isPassed = TryCheckSaveFailures(directory) && isPassed;
+   isPassed = TryCheckContentHashes(records) && isPassed;
+
+   DeleteRecords(records);
+   std::filesystem::remove_all(directory);
+   return isPassed ? 0 : 1;
+}
+
+//Names and values cycle through everything the fields hold
+static std::vector<Record*> MakeRecords(uint32_t count) {
+   std::vector<Record*> records;
+   records.reserve(count);
+
+   for (uint32_t i = 0; i < count; i++) {
+      Record* record = new Record();
+      std::wstring name = L"Medicine " + std::to_wstring(i);
+      wcsncpy(record->name, name.c_str(), NAME_SIZE - 1);
+
+      record->iconType = (IconType) (i % (int) IconType::count);
+      record->foodType = (FoodType) (i % (int) FoodType::count);
+      record->doseInteger = (unsigned char) (i % 5);
+      record->hasFractional = i % 3 == 0;
+      record->doseNumerator = (unsigned char) (1 + i % 3);
+      record->doseDenominator = (unsigned char) (4 + i % 4);
+      record->hasEndDate = i % 2 == 0;
+      record->endDateYear = 2024 + i % 3;
+      record->endDateMonth = (unsigned char) (1 + i % 12);
+      record->endDateDay = (unsigned char) (1 + i % 28);
+      record->takingDayType = (TakingDayType) (i % (int) TakingDayType::count);
+      record->startDateYear = 2023 + i % 2;
+      record->startDateMonth = (unsigned char) (1 + (i / 12) % 12);
+      record->startDateDay = (unsigned char) (1 + (i / 28) % 28);
+      record->takingDayPeriod = 1 + i % 30;
+      record->takingTimeType = (TakingTimeType) (i % (int) TakingTimeType::count);
+      record->firstHour = (unsigned char) (i % 12);
+      record->secondHour = (unsigned char) (12 + i % 12);
+      records.emplace_back(record);
+   }
+
+   return records;
+}
+
+static bool IsSameRecord(const Record& a, const Record& b) {
+   return !wcscmp(a.name, b.name) && a.iconType == b.iconType && a.foodType == b.foodType && a.doseInteger == b.doseInteger &&
+      a.hasFractional == b.hasFractional && a.doseNumerator == b.doseNumerator && a.doseDenominator == b.doseDenominator &&
+      a.hasEndDate == b.hasEndDate && a.endDateYear == b.endDateYear && a.endDateMonth == b.endDateMonth && a.endDateDay == b.endDateDay &&
+      a.takingDayType == b.takingDayType && a.startDateYear == b.startDateYear && a.startDateMonth == b.startDateMonth &&
+      a.startDateDay == b.startDateDay && a.takingDayPeriod == b.takingDayPeriod && a.takingTimeType == b.takingTimeType &&
+      a.firstHour == b.firstHour && a.secondHour == b.secondHour;
+}
+
+static bool IsSameList(const std::vector<Record*>& a, const std::vector<Record*>& b) {
+   if (a.size() != b.size()) {
+      return false;
+   }
+
+   for (size_t i = 0; i < a.size(); i++) {
+      if (!IsSameRecord(*a[i], *b[i])) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static void DeleteRecords(std::vector<Record*>& records) {
+   for (Record* record : records) {
+      delete record;
+   }
+   records.clear();
+}
+
+static bool TryBenchmarkFormat(const std::vector<Record*>& records, SaveFormat format, const std::filesystem::path& path) {
+   Serializer serializer;
+
+   double saveSeconds = TimeSave(serializer, records, format, path);
+
+   std::vector<Record*> loaded;
+   auto start = std::chrono::steady_clock::now();
+   SaveFormat loadedFormat = LoadRecordList(serializer, path.wstring().c_str(), loaded);
+   double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   bool isMatching = loadedFormat == format && IsSameList(records, loaded);
+   DeleteRecords(loaded);
+
+   std::error_code error;
+   uintmax_t fileSize = std::filesystem::file_size(path, error);
+
+   const char* name = format == SaveFormat::BINARY ? "binary" : "text";
+   printf("%-28s %11zu %10.1f %10.1f %10.1f %10s\n", name, records.size(), error ? 0.0 : fileSize / 1024.0, saveSeconds * 1e3, loadSeconds * 1e3, isMatching ? "ok" : "MISMATCH");
+   return isMatching;
+}
+
+//A text save loaded and saved again as binary, what the application does once with old saves
+static bool TryBenchmarkMigration(const std::vector<Record*>& records, const std::filesystem::path& textPath, const std::filesystem::path& binaryPath) {
+   Serializer serializer;
+   std::vector<Record*> loaded;
+
+   auto start = std::chrono::steady_clock::now();
+   SaveFormat textFormat = LoadRecordList(serializer, textPath.wstring().c_str(), loaded);
+   TrySaveRecordList(serializer, binaryPath.wstring().c_str(), loaded, SaveFormat::BINARY);
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   DeleteRecords(loaded);
+
+   SaveFormat binaryFormat = LoadRecordList(serializer, binaryPath.wstring().c_str(), loaded);
+   bool isMatching = textFormat == SaveFormat::TEXT && binaryFormat == SaveFormat::BINARY && IsSameList(records, loaded);
+   DeleteRecords(loaded);
+
+   printf("%-28s %11zu %10s %10.1f %10s %10s\n", "text to binary", records.size(), "", seconds * 1e3, "", isMatching ? "ok" : "MISMATCH");
+   return isMatching;
+}
+
+static bool TryCheckSettings(const std::filesystem::path& path) {
+   Settings settings;
+   settings.mainWindowCorner = WindowCorner::LEFT_UP;
+   settings.updateTime = 1234;
+   settings.shouldClearDone = false;
+   settings.notificationTime = 77;
+
+   Serializer serializer;
+   BinarySaveWriter writer;
+   settings.SaveBinary(writer);
+   serializer.TryWriteBinary(path.wstring().c_str(), writer);
+
+   Settings loaded;
+   loaded.updateTime = 0;
+   serializer.TryOpenForDeserialize(path.wstring().c_str());
+   loaded.Load(serializer);
+   serializer.Close();
+
+   bool isMatching = loaded.mainWindowCorner == settings.mainWindowCorner && loaded.updateTime == settings.updateTime && loaded.shouldClearDone == settings.shouldClearDone && loaded.notificationTime == settings.notificationTime;
+   printf("%-28s %11s %10s %10s %10s %10s\n", "settings", "1", "", "", "", isMatching ? "ok" : "MISMATCH");
+   return isMatching;
+}
+
+static double TimeSave(Serializer& serializer, const std::vector<Record*>& records, SaveFormat format, const std::filesystem::path& path) {
+   auto start = std::chrono::steady_clock::now();
+   TrySaveRecordList(serializer, path.wstring().c_str(), records, format);
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Every save goes through a temp file and a rename, only the flushes differ. A save that fails to replace the file fails the run
+static bool TryBenchmarkDurability(const std::filesystem::path& directory) {
+   printf("\n%-28s %11s %10s %10s %10s\n", "save durability", "count", "text ms", "binary ms", "check");
+
+   bool isPassed = true;
+   for (uint32_t count : {10000u, 100000u}) {
+      std::vector<Record*> records = MakeRecords(count);
+
+      for (int i = (int) SaveDurability::begin; i <= (int) SaveDurability::end; i++) {
+         Serializer serializer;
+         serializer.SetDurability((SaveDurability) i);
+
+         double seconds[2] = {1e9, 1e9};
+         const SaveFormat formats[2] = {SaveFormat::TEXT, SaveFormat::BINARY};
+         bool isMatching = true;
+
+         for (int j = 0; j < 2; j++) {
+            std::filesystem::path path = directory / (j ? "durability.bin" : "durability.txt");
+            for (int round = 0; round < DURABILITY_ROUNDS; round++) {
+               double roundSeconds = TimeSave(serializer, records, formats[j], path);
+               seconds[j] = roundSeconds < seconds[j] ? roundSeconds : seconds[j];
+            }
+
+            std::vector<Record*> loaded;
+            isMatching = LoadRecordList(serializer, path.wstring().c_str(), loaded) == formats[j] && IsSameList(records, loaded) && isMatching;
+            DeleteRecords(loaded);
+
+            std::filesystem::path tempPath = path;
+            tempPath += ".tmp";
+            isMatching = !std::filesystem::exists(tempPath) && isMatching;
+         }
+
+         std::wstring name = SaveDurabilityToString((SaveDurability) i);
+         printf("%-28ls %11u %10.1f %10.1f %10s\n", name.c_str(), count, seconds[0] * 1e3, seconds[1] * 1e3, isMatching ? "ok" : "MISMATCH");
+         isPassed = isPassed && isMatching;
+      }
+
+      DeleteRecords(records);
+   }
+
+   return isPassed;
+}
+
+//Appends a day of changes and opens the log again as a restart would, then tears its last entry and moves to a new checkpoint
+static bool TryBenchmarkJournal(const std::filesystem::path& directory) {
+   printf("\n%-28s %11s %10s %10s %10s\n", "state journal", "changes", "append us", "file KB", "check");
+
+   std::filesystem::path path = directory / "state.log";
+   const uint32_t checkpointId = 7;
+
+   std::vector<StateChange> changes(JOURNAL_CHANGE_COUNT);
+   for (int i = 0; i < JOURNAL_CHANGE_COUNT; i++) {
+      changes[i].type = (StateChangeType) (i % (int) StateChangeType::count);
+      changes[i].list = (StateListType) (i % (int) StateListType::count);
+      changes[i].recordIndex = i * 37 - 1;
+      changes[i].value = i % 5;
+   }
+
+   auto IsSameChanges = [&](const std::vector<StateChange>& replayed) {
+      if (replayed.size() != changes.size()) {
+         return false;
+      }
+
+      for (size_t i = 0; i < changes.size(); i++) {
+         if (replayed[i].type != changes[i].type || replayed[i].list != changes[i].list || replayed[i].recordIndex != changes[i].recordIndex || replayed[i].value != changes[i].value) {
+            return false;
+         }
+      }
+
+      return true;
+   };
+
+   bool isPassed = true;
+   for (int i = (int) SaveDurability::begin; i <= (int) SaveDurability::end; i++) {
+      std::error_code error;
+      std::filesystem::remove(path, error);
+
+      StateJournal journal;
+      journal.SetDurability((SaveDurability) i);
+
+      std::vector<StateChange> replayed;
+      bool isMatching = journal.TryOpen(path, checkpointId, replayed) && replayed.empty();
+
+      auto start = std::chrono::steady_clock::now();
+      for (const StateChange& change : changes) {
+         isMatching = journal.TryAppend(change) && isMatching;
+      }
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      size_t size = journal.GetSize();
+      journal.Close();
+
+      isMatching = journal.TryOpen(path, checkpointId, replayed) && IsSameChanges(replayed) && isMatching;
+      journal.Close();
+
+      {
+         std::ofstream stream(path, std::ios::binary | std::ios::app);
+         stream.write("\x01\x02\x03\x04\x05", 5);
+      }
+      isMatching = journal.TryOpen(path, checkpointId, replayed) && IsSameChanges(replayed) && journal.GetSize() == size && isMatching;
+      isMatching = std::filesystem::file_size(path, error) == size && isMatching;
+      journal.Close();
+
+      isMatching = journal.TryOpen(path, checkpointId + 1, replayed) && replayed.empty() && journal.GetSize() == STATE_JOURNAL_HEADER_SIZE && isMatching;
+      journal.Close();
+
+      std::wstring name = SaveDurabilityToString((SaveDurability) i);
+      printf("%-28ls %11d %10.2f %10.1f %10s\n", name.c_str(), JOURNAL_CHANGE_COUNT, seconds * 1e6 / JOURNAL_CHANGE_COUNT, size / 1024.0, isMatching ? "ok" : "MISMATCH");
+      isPassed = isPassed && isMatching;
+   }
+
+   return isPassed;
+}
+
+//Edits, adds and deletes flush one slot each, so their time should stay the same from 1000 records to 100000 while a full save grows.
+//Then most records are deleted and the store is compacted, and every reopen has to give back the records as they were left
+static bool TryBenchmarkRecordStore(const std::filesystem::path& directory) {
+   printf("\n%-28s %11s %10s %10s %10s %10s %10s %10s\n", "record store", "count", "edit us", "add us", "delete us", "full ms", "compact ms", "check");
+
+   std::filesystem::path path = directory / "record_store";
+   std::filesystem::path fullPath = directory / "records_full.bin";
+
+   bool isPassed = true;
+   for (uint32_t count : {1000u, 10000u, 100000u}) {
+      std::vector<Record*> records = MakeRecords(count);
+      std::vector<uint32_t> slots;
+
+      RecordStore store;
+      bool isMatching = store.TryCreate(path, records, slots) && slots.size() == count;
+
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < STORE_EDIT_COUNT; i++) {
+         uint32_t index = (uint32_t) ((uint64_t) i * 7919 % count);
+         records[index]->firstHour = (unsigned char) (i % 12);
+         records[index]->doseInteger = (unsigned char) (i % 7);
+         isMatching = store.TryWrite(slots[index], *records[index]) && isMatching;
+      }
+      double editSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      //Deletes first, so half of the adds take tombstones off the free list and half go to the end
+      start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < STORE_ADD_COUNT / 2; i++) {
+         uint32_t index = (uint32_t) (count / 2 - i * 3);
+         isMatching = store.TryDelete(slots[index]) && isMatching;
+         delete records[index];
+         records.erase(records.begin() + index);
+         slots.erase(slots.begin() + index);
+      }
+      double deleteSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      std::vector<Record*> added = MakeRecords(STORE_ADD_COUNT);
+      start = std::chrono::steady_clock::now();
+      for (Record* record : added) {
+         uint32_t slot = RECORD_STORE_NO_SLOT;
+         isMatching = store.TryAdd(*record, &slot) && isMatching;
+         records.emplace_back(record);
+         slots.emplace_back(slot);
+      }
+      double addSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      //Timed after the store writes, on some file systems every flush also writes back what other files left dirty and a full save leaves megabytes
+      Serializer serializer;
+      double fullSeconds = TimeSave(serializer, records, SaveFormat::BINARY, fullPath);
+
+      std::vector<Record*> loaded;
+      std::vector<uint32_t> loadedSlots;
+      isMatching = store.TryOpen(path, loaded, loadedSlots) && IsSameList(records, loaded) && loadedSlots == slots && isMatching;
+      DeleteRecords(loaded);
+
+      //Leaves a tenth of the records, flushing every delete isn't what's measured here
+      store.SetDurability(SaveDurability::NONE);
+      std::vector<Record*> kept;
+      for (size_t i = 0; i < records.size(); i++) {
+         if (i % 10) {
+            isMatching = store.TryDelete(slots[i]) && isMatching;
+            delete records[i];
+         } else {
+            kept.emplace_back(records[i]);
+         }
+      }
+      size_t sparseSize = store.GetFileSize();
+      store.Close();
+
+      start = std::chrono::steady_clock::now();
+      isMatching = RecordStore::TryCompact(path, SaveDurability::FLUSH_FILE) && isMatching;
+      double compactSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      loadedSlots.clear();
+      isMatching = store.TryOpen(path, loaded, loadedSlots) && IsSameList(kept, loaded) && store.GetTombstoneCount() == 0 && store.GetFileSize() < sparseSize && isMatching;
+      DeleteRecords(loaded);
+      DeleteRecords(kept);
+      store.Close();
+
+      printf("%-28s %11u %10.2f %10.2f %10.2f %10.1f %10.1f %10s\n", "", count, editSeconds * 1e6 / STORE_EDIT_COUNT, addSeconds * 1e6 / STORE_ADD_COUNT,
+         deleteSeconds * 1e6 / (STORE_ADD_COUNT / 2), fullSeconds * 1e3, compactSeconds * 1e3, isMatching ? "ok" : "MISMATCH");
+      isPassed = isPassed && isMatching;
+   }
+
+   return isPassed;
+}
+
+//Every tick changes the status of a few records and saves the whole record list, as a day of use would.
+//Written on the calling thread every change is an append and a flush of its own, the worker gets one batch of changes per tick
+//and a copy of the records, and a burst of record saves it can't keep up with is written once
+static bool TryBenchmarkSaveWorker(const std::filesystem::path& directory) {
+   printf("\n%-28s %11s %10s %10s %10s %10s %10s\n", "save worker", "ticks", "ui ms", "write ms", "written", "coalesced", "check");
+
+   std::filesystem::path logPath = directory / "worker_state.log";
+   std::filesystem::path recordsPath = directory / "worker_records.bin";
+   const uint32_t checkpointId = 3;
+
+   std::vector<Record*> records = MakeRecords(WORKER_RECORD_COUNT);
+
+   bool isPassed = true;
+   for (int isWorker = 0; isWorker < 2; isWorker++) {
+      std::error_code error;
+      std::filesystem::remove(logPath, error);
+      std::filesystem::remove(recordsPath, error);
+
+      StateJournal journal;
+      std::vector<StateChange> replayed;
+      bool isMatching = journal.TryOpen(logPath, checkpointId, replayed);
+
+      SaveWorker worker;
+      Serializer serializer;
+
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t tick = 0; tick < WORKER_TICK_COUNT; tick++) {
+         std::vector<StateChange> changes(WORKER_TICK_CHANGE_COUNT);
+         for (uint32_t i = 0; i < WORKER_TICK_CHANGE_COUNT; i++) {
+            changes[i].recordIndex = (int) ((tick * WORKER_TICK_CHANGE_COUNT + i) % WORKER_RECORD_COUNT);
+            changes[i].value = (int) (tick % 4);
+         }
+         records[tick % WORKER_RECORD_COUNT]->firstHour = (unsigned char) (tick % 12);
+
+         if (!isWorker) {
+            for (const StateChange& change : changes) {
+               isMatching = journal.TryAppend(change) && isMatching;
+            }
+            isMatching = TrySaveRecordList(serializer, recordsPath.wstring().c_str(), records, SaveFormat::BINARY) && isMatching;
+            continue;
+         }
+
+         SavePostTimer timer(&worker);
+
+         StateJournal* workerJournal = &journal;
+         worker.PostChange(SaveStream::STATE, [changes = std::move(changes), workerJournal](Serializer& /*serializer*/) {
+            return workerJournal->TryAppend(changes);
+         });
+
+         std::vector<Record> copies;
+         copies.reserve(records.size());
+         for (const Record* record : records) {
+            copies.emplace_back(*record);
+         }
+
+         std::wstring path = recordsPath.wstring();
+         worker.PostSnapshot(SaveStream::RECORDS, [copies = std::move(copies), path](Serializer& serializer) mutable {
+            std::vector<Record*> recordList;
+            for (Record& record : copies) {
+               recordList.emplace_back(&record);
+            }
+            return TrySaveRecordList(serializer, path.c_str(), recordList, SaveFormat::BINARY);
+         });
+      }
+      double uiSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      worker.Flush();
+      double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      SaveWorkerStats stats = worker.GetStats();
+      worker.Stop();
+      journal.Close();
+
+      //Whatever got coalesced, the files end up as the last tick left them
+      std::vector<Record*> loaded;
+      isMatching = LoadRecordList(serializer, recordsPath.wstring().c_str(), loaded) == SaveFormat::BINARY && IsSameList(records, loaded) && isMatching;
+      DeleteRecords(loaded);
+
+      isMatching = journal.TryOpen(logPath, checkpointId, replayed) && replayed.size() == WORKER_TICK_COUNT * WORKER_TICK_CHANGE_COUNT && isMatching;
+      journal.Close();
+
+      if (isWorker) {
+         isMatching = stats.failCount == 0 && stats.writeCount + stats.coalescedCount == stats.postCount && isMatching;
+         printf("%-28s %11d %10.1f %10.1f %10u %10u %10s\n", "save worker", WORKER_TICK_COUNT, uiSeconds * 1e3, writeSeconds * 1e3, stats.writeCount,
+            stats.coalescedCount, isMatching ? "ok" : "MISMATCH");
+      } else {
+         printf("%-28s %11d %10.1f %10.1f %10d %10d %10s\n", "calling thread", WORKER_TICK_COUNT, uiSeconds * 1e3, uiSeconds * 1e3,
+            WORKER_TICK_COUNT * (WORKER_TICK_CHANGE_COUNT + 1), 0, isMatching ? "ok" : "MISMATCH");
+      }
+      isPassed = isPassed && isMatching;
+   }
+
+   DeleteRecords(records);
+   return isPassed;
+}
+
+//A snapshot that can't be written is reported once and the changes after it are dropped and reported, until a snapshot is written again
+static bool TryCheckSaveFailures(const std::filesystem::path& directory) {
+   std::mutex mutex;
+   std::vector<std::pair<SaveStream, bool>> failures;
+
+   SaveWorker worker;
+   worker.SetFailedCallback([&](SaveStream stream, bool isSnapshot) {
+      std::lock_guard<std::mutex> lock(mutex);
+      failures.emplace_back(stream, isSnapshot);
+   });
+
+   //A file in the way of the directory the save should go to
+   std::filesystem::path blocked = directory / "blocked";
+   {
+      std::ofstream stream(blocked, std::ios::binary);
+   }
+   std::filesystem::path path = directory / "unblocked";
+
+   int changeCount = 0;
+   auto WriteTo = [](const std::filesystem::path& path) {
+      return [path](Serializer& serializer) {
+         const char data[] = "save";
+         return TryWriteFileAtomic(path, data, sizeof(data), serializer.GetDurability());
+      };
+   };
+   auto Change = [&](Serializer& /*serializer*/) {
+      changeCount++;
+      return true;
+   };
+
+   worker.PostSnapshot(SaveStream::STATE, WriteTo(blocked / "state"));
+   worker.Flush();
+   worker.PostChange(SaveStream::STATE, Change);
+   worker.Flush();
+   worker.PostSnapshot(SaveStream::STATE, WriteTo(blocked / "state"));
+   worker.Flush();
+   worker.PostChange(SaveStream::SETTINGS, Change);
+   worker.Flush();
+   worker.PostSnapshot(SaveStream::STATE, WriteTo(path));
+   worker.PostChange(SaveStream::STATE, Change);
+   worker.Stop();
+
+   std::vector<std::pair<SaveStream, bool>> expected = {{SaveStream::STATE, true}, {SaveStream::STATE, false}};
+   bool isMatching = failures == expected && changeCount == 2 && worker.GetStats().failCount == 3;
+
+   printf("%-28s %11s %10s %10s %10s %10s %10s\n", "failures reported", "", "", "", "", "", isMatching ? "ok" : "MISMATCH");
+   return isMatching;
+}
+
+//Saves are skipped on equal hashes, so a copy has to hash the same and any edited field differently
+static bool TryCheckContentHashes(const std::vector<Record*>& records) {
+   bool isMatching = true;
+   for (const Record* record : records) {
+      Record copy = *record;
+      isMatching = isMatching && copy.GetContentHash() == record->GetContentHash();
+
+      copy.doseInteger++;
+      isMatching = isMatching && copy.GetContentHash() != record->GetContentHash();
+
+      Record renamed = *record;
+      renamed.name[0] = renamed.name[0] == L'x' ? L'y' : L'x';
+      isMatching = isMatching && renamed.GetContentHash() != record->GetContentHash();
+   }
+
+   Settings settings;
+   Settings copy = settings;
+   isMatching = isMatching && copy.GetContentHash() == settings.GetContentHash();
+   copy.notificationTime++;
+   isMatching = isMatching && copy.GetContentHash() != settings.GetContentHash();
+
+   printf("%-28s %11zu %10s %10s %10s %10s\n", "content hashes", records.size(), "", "", "", isMatching ? "ok" : "MISMATCH");
+   return isMatching;
+}
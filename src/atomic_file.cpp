@@ -0,0 +1,124 @@
+#include "atomic_file.h"
+#include <cstdint>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static bool TryWriteTemp(const std::filesystem::path& tempPath, const void* data, size_t size, bool isFlushing);
+static bool TryReplace(const std::filesystem::path& tempPath, const std::filesystem::path& path, bool isFlushing);
+
+const wchar_t* SaveDurabilityToString(SaveDurability durability) {
+   switch (durability) {
+      case SaveDurability::NONE:
+         return L"No flush";
+      case SaveDurability::FLUSH_FILE:
+         return L"Flush file";
+      case SaveDurability::FLUSH_DIRECTORY:
+         return L"Flush file and directory";
+      default:
+         return L"Can't convert SaveDurability to string";
+   }
+}
+
+bool TryWriteFileAtomic(const std::filesystem::path& path, const void* data, size_t size, SaveDurability durability) {
+   std::filesystem::path tempPath = path;
+   tempPath += L".tmp";
+
+   std::error_code error;
+   if (path.has_parent_path()) {
+      std::filesystem::create_directories(path.parent_path(), error);
+   }
+
+   if (!TryWriteTemp(tempPath, data, size, durability != SaveDurability::NONE) || !TryReplace(tempPath, path, durability == SaveDurability::FLUSH_DIRECTORY)) {
+      std::filesystem::remove(tempPath, error);
+      return false;
+   }
+
+   return true;
+}
+
+#ifdef _WIN32
+
+static bool TryWriteTemp(const std::filesystem::path& tempPath, const void* data, size_t size, bool isFlushing) {
+   HANDLE file = CreateFile(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if (file == INVALID_HANDLE_VALUE) {
+      return false;
+   }
+
+   const uint8_t* bytes = (const uint8_t*) data;
+   bool isWritten = true;
+
+   while (size && isWritten) {
+      DWORD part = size < (1u << 30) ? (DWORD) size : (1u << 30);
+      DWORD written;
+      isWritten = WriteFile(file, bytes, part, &written, nullptr) && written == part;
+      bytes += part;
+      size -= part;
+   }
+
+   if (isWritten && isFlushing) {
+      isWritten = FlushFileBuffers(file);
+   }
+
+   CloseHandle(file);
+   return isWritten;
+}
+
+//Directories can't be flushed on their own here, a write-through move returns once the rename is on disk
+static bool TryReplace(const std::filesystem::path& tempPath, const std::filesystem::path& path, bool isFlushing) {
+   return MoveFileEx(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | (isFlushing ? MOVEFILE_WRITE_THROUGH : 0));
+}
+
+#else
+
+static bool TryWriteTemp(const std::filesystem::path& tempPath, const void* data, size_t size, bool isFlushing) {
+   int file = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (file < 0) {
+      return false;
+   }
+
+   const uint8_t* bytes = (const uint8_t*) data;
+   bool isWritten = true;
+
+   while (size && isWritten) {
+      ssize_t written = write(file, bytes, size);
+      isWritten = written > 0;
+      if (isWritten) {
+         bytes += written;
+         size -= (size_t) written;
+      }
+   }
+
+   if (isWritten && isFlushing) {
+      isWritten = !fsync(file);
+   }
+
+   return !close(file) && isWritten;
+}
+
+static bool TryReplace(const std::filesystem::path& tempPath, const std::filesystem::path& path, bool isFlushing) {
+   if (rename(tempPath.c_str(), path.c_str())) {
+      return false;
+   }
+
+   if (!isFlushing) {
+      return true;
+   }
+
+   std::filesystem::path directory = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+   int directoryFile = open(directory.c_str(), O_RDONLY);
+   if (directoryFile < 0) {
+      return false;
+   }
+
+   bool isFlushed = !fsync(directoryFile);
+   close(directoryFile);
+   return isFlushed;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+enum class SaveDurability {
+   NONE = 0,//Left to the OS cache, a power loss can undo recent saves but never mixes two of them
+   FLUSH_FILE,//The new file is on disk before it replaces the old one
+   FLUSH_DIRECTORY,//The replacement itself is on disk too when the write returns
+
+   //Iteration helpers
+   count,
+   begin = 0,
+   end = count - 1
+};
+
+const wchar_t* SaveDurabilityToString(SaveDurability durability);
+
+//Writes data to path.tmp in one write, flushes it as durability asks and renames it over path.
+//A crash at any point leaves either the whole old file or the whole new one
+bool TryWriteFileAtomic(const std::filesystem::path& path, const void* data, size_t size, SaveDurability durability);
@@ -0,0 +1,289 @@
+#include "binary_save.h"
+#include <cstring>
+#include <cwchar>
+
+static void AppendUInt32LE(std::vector<uint8_t>& out, uint32_t value);
+static void AppendName(std::vector<uint8_t>& out, std::string_view name);
+static uint32_t ReadUInt32LE(const uint8_t* data);
+
+void SaveValue::CopyText(wchar_t* out, size_t maxCount) const {
+   if (!maxCount) {
+      return;
+   }
+
+   size_t count = textLength < maxCount - 1 ? textLength : maxCount - 1;
+   for (size_t i = 0; i < count; i++) {
+      out[i] = (wchar_t) (text[i * 2] | text[i * 2 + 1] << 8);
+   }
+   out[count] = L'\0';
+}
+
+bool IsBinarySave(const uint8_t* data, size_t size) {
+   return size >= sizeof(BinarySaveHeader) && ReadUInt32LE(data) == BINARY_SAVE_MAGIC;
+}
+
+void BinarySaveWriter::BeginSection(std::string_view name, const SaveColumn* columns, uint32_t columnCount, uint32_t rowCount) {
+   if (!IsSectionComplete()) {
+      m_IsValid = false;
+   }
+
+   BinarySaveEntry entry;
+   entry.offset = (uint32_t) m_Sections.size();
+   entry.size = 0;
+   entry.rowCount = rowCount;
+   entry.columnCount = columnCount;
+   m_Entries.emplace_back(entry);
+
+   AppendName(m_Sections, name);
+
+   m_ColumnTypes.clear();
+   for (uint32_t i = 0; i < columnCount; i++) {
+      m_Sections.emplace_back((uint8_t) columns[i].type);
+      AppendName(m_Sections, columns[i].name);
+      m_ColumnTypes.emplace_back(columns[i].type);
+   }
+
+   m_ValueCount = 0;
+}
+
+void BinarySaveWriter::WriteNumber(int value) {
+   switch (GetNextType()) {
+      case SaveColumnType::UINT8:
+         m_Sections.emplace_back((uint8_t) value);
+         break;
+      case SaveColumnType::INT32:
+         AppendUInt32LE(m_Sections, (uint32_t) value);
+         break;
+      default:
+         m_IsValid = false;
+   }
+}
+
+void BinarySaveWriter::WriteString(const wchar_t* value) {
+   if (GetNextType() != SaveColumnType::STRING) {
+      m_IsValid = false;
+      return;
+   }
+
+   size_t length = wcslen(value);
+   if (length > UINT16_MAX) {
+      length = UINT16_MAX;
+   }
+
+   m_Sections.emplace_back((uint8_t) length);
+   m_Sections.emplace_back((uint8_t) (length >> 8));
+   for (size_t i = 0; i < length; i++) {
+      m_Sections.emplace_back((uint8_t) value[i]);
+      m_Sections.emplace_back((uint8_t) (value[i] >> 8));
+   }
+}
+
+bool BinarySaveWriter::TryFinish(std::vector<uint8_t>& out) {
+   size_t dataStart = sizeof(BinarySaveHeader) + m_Entries.size() * sizeof(BinarySaveEntry);
+   size_t fileSize = dataStart + m_Sections.size();
+   if (!m_IsValid || !IsSectionComplete() || fileSize > UINT32_MAX) {
+      return false;
+   }
+
+   out.clear();
+   out.reserve(fileSize);
+   AppendUInt32LE(out, BINARY_SAVE_MAGIC);
+   AppendUInt32LE(out, BINARY_SAVE_VERSION);
+   AppendUInt32LE(out, (uint32_t) m_Entries.size());
+   AppendUInt32LE(out, (uint32_t) fileSize);
+
+   for (size_t i = 0; i < m_Entries.size(); i++) {
+      size_t sectionEnd = i + 1 < m_Entries.size() ? m_Entries[i + 1].offset : m_Sections.size();
+      AppendUInt32LE(out, (uint32_t) (dataStart + m_Entries[i].offset));
+      AppendUInt32LE(out, (uint32_t) (sectionEnd - m_Entries[i].offset));
+      AppendUInt32LE(out, m_Entries[i].rowCount);
+      AppendUInt32LE(out, m_Entries[i].columnCount);
+   }
+
+   out.insert(out.end(), m_Sections.begin(), m_Sections.end());
+   return true;
+}
+
+bool BinarySaveWriter::IsSectionComplete() const {
+   return m_Entries.empty() || m_ValueCount == (size_t) m_Entries.back().rowCount * m_ColumnTypes.size();
+}
+
+SaveColumnType BinarySaveWriter::GetNextType() {
+   if (m_ColumnTypes.empty()) {
+      m_IsValid = false;
+      return SaveColumnType::count;
+   }
+
+   return m_ColumnTypes[m_ValueCount++ % m_ColumnTypes.size()];
+}
+
+int BinarySaveSection::FindColumn(std::string_view name) const {
+   for (size_t i = 0; i < m_Columns.size(); i++) {
+      if (m_Columns[i].name == name) {
+         return (int) i;
+      }
+   }
+
+   return -1;
+}
+
+bool BinarySaveSection::TryReadRow(SaveValue* values) {
+   if (m_RowsRead >= m_RowCount) {
+      return false;
+   }
+
+   for (size_t i = 0; i < m_Columns.size(); i++) {
+      SaveValue& value = values[i];
+      size_t left = m_Size - m_Pos;
+
+      switch (m_Columns[i].type) {
+         case SaveColumnType::UINT8:
+            if (left < 1) {
+               return false;
+            }
+            value.number = m_Data[m_Pos];
+            m_Pos += 1;
+            break;
+         case SaveColumnType::INT32:
+            if (left < 4) {
+               return false;
+            }
+            value.number = (int) ReadUInt32LE(m_Data + m_Pos);
+            m_Pos += 4;
+            break;
+         default:
+            {
+               if (left < 2) {
+                  return false;
+               }
+
+               uint32_t length = m_Data[m_Pos] | m_Data[m_Pos + 1] << 8;
+               if (left - 2 < (size_t) length * 2) {
+                  return false;
+               }
+
+               value.text = m_Data + m_Pos + 2;
+               value.textLength = length;
+               m_Pos += 2 + (size_t) length * 2;
+            }
+      }
+   }
+
+   m_RowsRead++;
+   return true;
+}
+
+bool BinarySaveReader::TryOpen(const uint8_t* data, size_t size) {
+   Close();
+
+   if (!IsBinarySave(data, size)) {
+      return false;
+   }
+
+   BinarySaveHeader header;
+   header.version = ReadUInt32LE(data + 4);
+   header.sectionCount = ReadUInt32LE(data + 8);
+   header.fileSize = ReadUInt32LE(data + 12);
+   if (header.version != BINARY_SAVE_VERSION || header.fileSize != size) {
+      return false;
+   }
+
+   if (header.sectionCount > (size - sizeof(header)) / sizeof(BinarySaveEntry)) {
+      return false;
+   }
+
+   m_Data = data;
+   m_Size = size;
+   m_SectionCount = header.sectionCount;
+
+   size_t tableEnd = sizeof(header) + (size_t) m_SectionCount * sizeof(BinarySaveEntry);
+   for (uint32_t i = 0; i < m_SectionCount; i++) {
+      BinarySaveEntry entry = GetEntry(i);
+      if (entry.offset < tableEnd || entry.offset > size || entry.size > size - entry.offset) {
+         Close();
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void BinarySaveReader::Close() {
+   m_Data = nullptr;
+   m_Size = 0;
+   m_SectionCount = 0;
+}
+
+bool BinarySaveReader::TryGetSection(std::string_view name, BinarySaveSection& section) const {
+   for (uint32_t i = 0; i < m_SectionCount; i++) {
+      BinarySaveEntry entry = GetEntry(i);
+      const uint8_t* data = m_Data + entry.offset;
+
+      if (!entry.size || entry.size - 1 < data[0] || std::string_view((const char*) data + 1, data[0]) != name) {
+         continue;
+      }
+
+      size_t pos = 1 + (size_t) data[0];
+      section.m_Columns.clear();
+
+      for (uint32_t j = 0; j < entry.columnCount; j++) {
+         if (entry.size - pos < 2 || data[pos] >= (uint8_t) SaveColumnType::count || entry.size - pos - 2 < data[pos + 1]) {
+            return false;
+         }
+
+         SaveColumn column;
+         column.type = (SaveColumnType) data[pos];
+         column.name = std::string_view((const char*) data + pos + 2, data[pos + 1]);
+         section.m_Columns.emplace_back(column);
+         pos += 2 + (size_t) data[pos + 1];
+      }
+
+      //Rows take at least this much, so a count no section could hold is caught before anyone allocates for it
+      size_t minRowSize = 0;
+      for (const SaveColumn& column : section.m_Columns) {
+         minRowSize += column.type == SaveColumnType::UINT8 ? 1 : column.type == SaveColumnType::INT32 ? 4 : 2;
+      }
+
+      if (entry.rowCount && (!minRowSize || (entry.size - pos) / minRowSize < entry.rowCount)) {
+         return false;
+      }
+
+      section.m_Data = data;
+      section.m_Size = entry.size;
+      section.m_Pos = pos;
+      section.m_RowCount = entry.rowCount;
+      section.m_RowsRead = 0;
+      return true;
+   }
+
+   return false;
+}
+
+//Entries are read byte by byte, the file has no alignment guarantees
+BinarySaveEntry BinarySaveReader::GetEntry(uint32_t index) const {
+   const uint8_t* data = m_Data + sizeof(BinarySaveHeader) + (size_t) index * sizeof(BinarySaveEntry);
+
+   BinarySaveEntry entry;
+   entry.offset = ReadUInt32LE(data);
+   entry.size = ReadUInt32LE(data + 4);
+   entry.rowCount = ReadUInt32LE(data + 8);
+   entry.columnCount = ReadUInt32LE(data + 12);
+   return entry;
+}
+
+static void AppendUInt32LE(std::vector<uint8_t>& out, uint32_t value) {
+   for (int shift = 0; shift < 32; shift += 8) {
+      out.emplace_back((uint8_t) (value >> shift));
+   }
+}
+
+//Names longer than 255 bytes are cut
+static void AppendName(std::vector<uint8_t>& out, std::string_view name) {
+   size_t length = name.size() < UINT8_MAX ? name.size() : UINT8_MAX;
+   out.emplace_back((uint8_t) length);
+   out.insert(out.end(), name.begin(), name.begin() + length);
+}
+
+static uint32_t ReadUInt32LE(const uint8_t* data) {
+   return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t) data[3] << 24;
+}
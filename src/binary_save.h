@@ -0,0 +1,129 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#define BINARY_SAVE_MAGIC 0x56535044//"DPSV" in file order
+#define BINARY_SAVE_VERSION 1
+
+//Header, one entry per section, then the sections, all little-endian.
+//A section is its name, its columns and then its rows, names are prefixed with their length. Columns are loaded by
+//name, so a file keeps loading when fields are added or dropped, the version only changes with this layout
+struct BinarySaveHeader {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t sectionCount;
+   uint32_t fileSize;//A cut off save fails to open instead of loading part of its rows
+};
+
+struct BinarySaveEntry {
+   uint32_t offset;//From the start of the file
+   uint32_t size;
+   uint32_t rowCount;
+   uint32_t columnCount;
+};
+
+enum class SaveColumnType : uint8_t {
+   UINT8 = 0,
+   INT32,
+   STRING,//16 bit length, then UTF-16 code units
+
+   //Iteration helpers
+   count
+};
+
+struct SaveColumn {
+   std::string_view name;
+   SaveColumnType type;
+};
+
+//One value of a row, number for both number types, text points into the save
+struct SaveValue {
+   int number = 0;
+   const uint8_t* text = nullptr;
+   uint32_t textLength = 0;
+
+   //Always terminated, cut at maxCount - 1 characters
+   void CopyText(wchar_t* out, size_t maxCount) const;
+};
+
+bool IsBinarySave(const uint8_t* data, size_t size);
+
+//Builds a save in memory. Every section is followed by exactly rowCount rows of one value per column, in column order
+class BinarySaveWriter {
+public:
+
+   void BeginSection(std::string_view name, const SaveColumn* columns, uint32_t columnCount, uint32_t rowCount);
+
+   void WriteNumber(int value);
+   void WriteString(const wchar_t* value);
+
+   //False when a section got a different number of values than its rows and columns need
+   bool TryFinish(std::vector<uint8_t>& out);
+
+private:
+
+   std::vector<uint8_t> m_Sections{};
+   std::vector<BinarySaveEntry> m_Entries{};
+   std::vector<SaveColumnType> m_ColumnTypes{};
+   size_t m_ValueCount = 0;
+   bool m_IsValid = true;
+
+private:
+
+   bool IsSectionComplete() const;
+   SaveColumnType GetNextType();
+};
+
+//Rows of one section, read front to back
+class BinarySaveSection {
+public:
+
+   uint32_t GetRowCount() const {
+      return m_RowCount;
+   }
+
+   const std::vector<SaveColumn>& GetColumns() const {
+      return m_Columns;
+   }
+
+   //Index of the column, -1 when the file has none of that name
+   int FindColumn(std::string_view name) const;
+
+   //Fills one value per column, false after the last row or for a row that doesn't fit in the section
+   bool TryReadRow(SaveValue* values);
+
+private:
+
+   friend class BinarySaveReader;
+
+   const uint8_t* m_Data = nullptr;
+   size_t m_Size = 0;
+   size_t m_Pos = 0;
+   uint32_t m_RowCount = 0;
+   uint32_t m_RowsRead = 0;
+   std::vector<SaveColumn> m_Columns{};
+};
+
+//Reads sections of a save held in memory. Nothing is copied, the memory must outlive the reader and its sections
+class BinarySaveReader {
+public:
+
+   //Checks the header and that every section lies inside the save
+   bool TryOpen(const uint8_t* data, size_t size);
+   void Close();
+
+   //False when the save has no such section or its columns don't fit in it
+   bool TryGetSection(std::string_view name, BinarySaveSection& section) const;
+
+private:
+
+   const uint8_t* m_Data = nullptr;
+   size_t m_Size = 0;
+   uint32_t m_SectionCount = 0;
+
+private:
+
+   BinarySaveEntry GetEntry(uint32_t index) const;
+};
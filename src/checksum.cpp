@@ -0,0 +1,299 @@
+#include "checksum.h"
+#include <cstring>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+#define CRC32_POLYNOMIAL 0xEDB88320//Reflected
+#define ADLER_MOD 65521
+#define ADLER_NMAX 5552//Most bytes before the 32 bit sums may overflow
+
+struct Crc32Tables {
+   uint32_t values[8][256];
+};
+
+//values[k][b] is the CRC of byte b followed by k zero bytes
+static constexpr Crc32Tables MakeCrc32Tables() {
+   Crc32Tables result{};
+
+   for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (uint32_t bit = 0; bit < 8; bit++) {
+         crc = (crc & 1) ? CRC32_POLYNOMIAL ^ (crc >> 1) : crc >> 1;
+      }
+      result.values[0][i] = crc;
+   }
+
+   for (uint32_t i = 0; i < 256; i++) {
+      for (uint32_t k = 1; k < 8; k++) {
+         uint32_t prev = result.values[k - 1][i];
+         result.values[k][i] = (prev >> 8) ^ result.values[0][prev & 0xFF];
+      }
+   }
+
+   return result;
+}
+
+static constexpr Crc32Tables s_Crc32 = MakeCrc32Tables();
+
+static inline uint32_t Load32(const uint8_t* p) {
+   uint32_t value;
+   memcpy(&value, p, 4);
+   return value;
+}
+
+//Eight bytes per step through eight independent lookups, assumes a little-endian CPU
+static uint32_t Crc32SliceBy8(uint32_t crc, const uint8_t* data, size_t length) {
+   crc = ~crc;
+
+   while (length >= 8) {
+      uint32_t low = Load32(data) ^ crc;
+      uint32_t high = Load32(data + 4);
+
+      crc = s_Crc32.values[7][low & 0xFF] ^ s_Crc32.values[6][(low >> 8) & 0xFF] ^ s_Crc32.values[5][(low >> 16) & 0xFF] ^ s_Crc32.values[4][low >> 24] ^
+            s_Crc32.values[3][high & 0xFF] ^ s_Crc32.values[2][(high >> 8) & 0xFF] ^ s_Crc32.values[1][(high >> 16) & 0xFF] ^ s_Crc32.values[0][high >> 24];
+
+      data += 8;
+      length -= 8;
+   }
+
+   while (length--) {
+      crc = s_Crc32.values[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+   }
+
+   return ~crc;
+}
+
+static uint32_t Adler32Scalar(uint32_t adler, const uint8_t* data, size_t length) {
+   uint32_t s1 = adler & 0xFFFF;
+   uint32_t s2 = adler >> 16;
+
+   while (length) {
+      size_t count = length < ADLER_NMAX ? length : ADLER_NMAX;
+      length -= count;
+
+      for (; count >= 4; count -= 4) {
+         s1 += data[0];
+         s2 += s1;
+         s1 += data[1];
+         s2 += s1;
+         s1 += data[2];
+         s2 += s1;
+         s1 += data[3];
+         s2 += s1;
+         data += 4;
+      }
+
+      for (; count; count--) {
+         s1 += *data++;
+         s2 += s1;
+      }
+
+      s1 %= ADLER_MOD;
+      s2 %= ADLER_MOD;
+   }
+
+   return (s2 << 16) | s1;
+}
+
+#if CPU_X86
+
+//Folds 64 bytes per step in four 128 bit lanes, then reduces to 32 bits with a Barrett reduction.
+//Constants are powers of x modulo the reflected polynomial, as in Intel's "Fast CRC Computation
+//Using PCLMULQDQ Instruction". Length should be at least 64 and a multiple of 16
+TARGET_PCLMUL static uint32_t Crc32FoldBlocks(uint32_t crc, const uint8_t* data, size_t length) {
+   const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+   const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+   const __m128i k5k0 = _mm_set_epi64x(0, 0x0163CD6124);
+   const __m128i poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+   const __m128i low32 = _mm_setr_epi32(-1, 0, -1, 0);
+
+   __m128i x1 = _mm_loadu_si128((const __m128i*) data);
+   __m128i x2 = _mm_loadu_si128((const __m128i*) (data + 16));
+   __m128i x3 = _mm_loadu_si128((const __m128i*) (data + 32));
+   __m128i x4 = _mm_loadu_si128((const __m128i*) (data + 48));
+   x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) ~crc));
+
+   data += 64;
+   length -= 64;
+
+   while (length >= 64) {
+      __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+      __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+      __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+      __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+      x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*) data));
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*) (data + 16)));
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*) (data + 32)));
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*) (data + 48)));
+
+      data += 64;
+      length -= 64;
+   }
+
+   //Four lanes into one
+   __m128i lanes[3] = {x2, x3, x4};
+   for (__m128i lane : lanes) {
+      __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, lane), x5);
+   }
+
+   while (length >= 16) {
+      __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*) data)), x5);
+
+      data += 16;
+      length -= 16;
+   }
+
+   //128 bits to 64
+   __m128i x2Fold = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+   x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2Fold);
+
+   __m128i high = _mm_srli_si128(x1, 4);
+   x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5k0, 0x00);
+   x1 = _mm_xor_si128(x1, high);
+
+   //Barrett reduction to 32 bits
+   __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+   t = _mm_clmulepi64_si128(_mm_and_si128(t, low32), poly, 0x00);
+   x1 = _mm_xor_si128(x1, t);
+
+   return ~(uint32_t) _mm_extract_epi32(x1, 1);
+}
+
+TARGET_PCLMUL static uint32_t Crc32CarryLess(uint32_t crc, const uint8_t* data, size_t length) {
+   if (length >= 64) {
+      size_t blockLength = length & ~(size_t) 15;
+      crc = Crc32FoldBlocks(crc, data, blockLength);
+      data += blockLength;
+      length -= blockLength;
+   }
+
+   return Crc32SliceBy8(crc, data, length);
+}
+
+static inline uint32_t HorizontalSum(__m128i x) {
+   x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+   x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+   return (uint32_t) _mm_cvtsi128_si32(x);
+}
+
+//16 bytes per step. Within a run s2 grows by 16 * s1 at every step start plus the bytes weighted 16 down to 1,
+//so the step starts are summed up in prefix and multiplied out once per run
+static uint32_t Adler32Sse2(uint32_t adler, const uint8_t* data, size_t length) {
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i weightsHigh = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+   const __m128i weightsLow = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+
+   uint32_t s1 = adler & 0xFFFF;
+   uint32_t s2 = adler >> 16;
+
+   while (length >= 16) {
+      size_t steps = (length < ADLER_NMAX ? length : ADLER_NMAX) / 16;
+      length -= steps * 16;
+
+      __m128i sum = zero;
+      __m128i prefix = zero;
+      __m128i weighted = zero;
+
+      for (size_t i = 0; i < steps; i++) {
+         __m128i bytes = _mm_loadu_si128((const __m128i*) data);
+
+         prefix = _mm_add_epi32(prefix, sum);
+         sum = _mm_add_epi32(sum, _mm_sad_epu8(bytes, zero));
+         weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weightsHigh));
+         weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weightsLow));
+
+         data += 16;
+      }
+
+      uint64_t newS2 = s2 + (uint64_t) steps * 16 * s1 + (uint64_t) HorizontalSum(prefix) * 16 + HorizontalSum(weighted);
+      s1 = (s1 + HorizontalSum(sum)) % ADLER_MOD;
+      s2 = (uint32_t) (newS2 % ADLER_MOD);
+   }
+
+   return Adler32Scalar((s2 << 16) | s1, data, length);
+}
+
+TARGET_AVX2 static uint32_t Adler32Avx2(uint32_t adler, const uint8_t* data, size_t length) {
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i ones = _mm256_set1_epi16(1);
+   const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+
+   uint32_t s1 = adler & 0xFFFF;
+   uint32_t s2 = adler >> 16;
+
+   while (length >= 32) {
+      size_t steps = (length < ADLER_NMAX ? length : ADLER_NMAX) / 32;
+      length -= steps * 32;
+
+      __m256i sum = zero;
+      __m256i prefix = zero;
+      __m256i weighted = zero;
+
+      for (size_t i = 0; i < steps; i++) {
+         __m256i bytes = _mm256_loadu_si256((const __m256i*) data);
+
+         prefix = _mm256_add_epi32(prefix, sum);
+         sum = _mm256_add_epi32(sum, _mm256_sad_epu8(bytes, zero));
+         weighted = _mm256_add_epi32(weighted, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+
+         data += 32;
+      }
+
+      uint32_t prefixSum = HorizontalSum(_mm_add_epi32(_mm256_castsi256_si128(prefix), _mm256_extracti128_si256(prefix, 1)));
+      uint32_t byteSum = HorizontalSum(_mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+      uint32_t weightedSum = HorizontalSum(_mm_add_epi32(_mm256_castsi256_si128(weighted), _mm256_extracti128_si256(weighted, 1)));
+
+      uint64_t newS2 = s2 + (uint64_t) steps * 32 * s1 + (uint64_t) prefixSum * 32 + weightedSum;
+      s1 = (s1 + byteSum) % ADLER_MOD;
+      s2 = (uint32_t) (newS2 % ADLER_MOD);
+   }
+
+   return Adler32Sse2((s2 << 16) | s1, data, length);
+}
+
+#endif
+
+ChecksumFunc GetCrc32Kernel(bool isCarryLess) {
+#if CPU_X86
+   const CpuFeatures& features = GetCpuFeatures();
+   if (isCarryLess && features.pclmul && features.sse41) {
+      return Crc32CarryLess;
+   }
+#endif
+
+   return Crc32SliceBy8;
+}
+
+ChecksumFunc GetAdler32Kernel(SimdLevel level) {
+#if CPU_X86
+   if (level == SimdLevel::AVX2) {
+      return Adler32Avx2;
+   } else if (level == SimdLevel::SSE2) {
+      return Adler32Sse2;
+   }
+#endif
+
+   return Adler32Scalar;
+}
+
+uint32_t UpdateCrc32(uint32_t crc, const uint8_t* data, size_t length) {
+   static const ChecksumFunc kernel = GetCrc32Kernel(true);
+   return kernel(crc, data, length);
+}
+
+uint32_t UpdateAdler32(uint32_t adler, const uint8_t* data, size_t length) {
+   static const ChecksumFunc kernel = GetAdler32Kernel(GetBestSimdLevel());
+   return kernel(adler, data, length);
+}
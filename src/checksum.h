@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "cpu_features.h"
+
+//Continues a running checksum over more data. CRC-32 starts from 0, Adler-32 from 1
+typedef uint32_t (*ChecksumFunc)(uint32_t checksum, const uint8_t* data, size_t length);
+
+//Slice-by-8 table kernel, or carry-less multiplication folding if isCarryLess and the CPU has it
+ChecksumFunc GetCrc32Kernel(bool isCarryLess);
+
+ChecksumFunc GetAdler32Kernel(SimdLevel level);
+
+//Fastest kernels for this CPU, picked once
+uint32_t UpdateCrc32(uint32_t crc, const uint8_t* data, size_t length);
+uint32_t UpdateAdler32(uint32_t adler, const uint8_t* data, size_t length);
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//64-bit FNV-1a of the bytes a save would write. A save keeps the hash of what it wrote last
+//and skips a write that would give the same hash again
+inline uint64_t GetContentHash(const void* data, size_t size) {
+   const uint8_t* bytes = (const uint8_t*) data;
+   uint64_t hash = 14695981039346656037ull;
+   for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+   }
+   return hash;
+}
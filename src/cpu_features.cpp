@@ -0,0 +1,79 @@
+#include "cpu_features.h"
+
+#if CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if CPU_X86
+static void CpuId(int leaf, int subLeaf, int regs[4]) {
+#if defined(_MSC_VER)
+   __cpuidex(regs, leaf, subLeaf);
+#else
+   unsigned int a, b, c, d;
+   __cpuid_count(leaf, subLeaf, a, b, c, d);
+   regs[0] = (int) a;
+   regs[1] = (int) b;
+   regs[2] = (int) c;
+   regs[3] = (int) d;
+#endif
+}
+
+static unsigned long long ReadXcr0() {
+#if defined(_MSC_VER)
+   return _xgetbv(0);
+#else
+   unsigned int eax, edx;
+   __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+   return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+#endif
+
+static CpuFeatures DetectCpuFeatures() {
+   CpuFeatures result{};
+
+#if CPU_X86
+   int regs[4];
+   CpuId(0, 0, regs);
+   int maxLeaf = regs[0];
+
+   CpuId(1, 0, regs);
+   result.sse2 = (regs[3] >> 26) & 1;
+   result.sse41 = (regs[2] >> 19) & 1;
+   result.pclmul = (regs[2] >> 1) & 1;
+
+   bool osxsave = (regs[2] >> 27) & 1;
+   bool avx = (regs[2] >> 28) & 1;
+
+   //AVX state has to be enabled by the OS as well
+   bool ymmEnabled = osxsave && avx && (ReadXcr0() & 6) == 6;
+
+   if (maxLeaf >= 7) {
+      CpuId(7, 0, regs);
+      result.avx2 = ymmEnabled && ((regs[1] >> 5) & 1);
+   }
+#endif
+
+   return result;
+}
+
+const CpuFeatures& GetCpuFeatures() {
+   static const CpuFeatures features = DetectCpuFeatures();
+   return features;
+}
+
+SimdLevel GetBestSimdLevel() {
+   const CpuFeatures& features = GetCpuFeatures();
+
+   if (features.avx2) {
+      return SimdLevel::AVX2;
+   } else if (features.sse2) {
+      return SimdLevel::SSE2;
+   }
+
+   return SimdLevel::SCALAR;
+}
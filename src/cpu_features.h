@@ -0,0 +1,34 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#endif
+
+#if defined(_MSC_VER) || !defined(CPU_X86)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(_MSC_VER) || !defined(CPU_X86)
+#define TARGET_PCLMUL
+#else
+#define TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+
+enum class SimdLevel {
+   SCALAR = 0,
+   SSE2,
+   AVX2
+};
+
+struct CpuFeatures {
+   bool sse2 = false;
+   bool sse41 = false;
+   bool pclmul = false;//Carry-less multiplication
+   bool avx2 = false;
+};
+
+//Detected once on first call
+const CpuFeatures& GetCpuFeatures();
+SimdLevel GetBestSimdLevel();
@@ -0,0 +1,50 @@
+#include "decode_arena.h"
+
+void* DecodeArena::Allocate(size_t size) {
+   size = (size + DECODE_ARENA_ALIGNMENT - 1) & ~(size_t) (DECODE_ARENA_ALIGNMENT - 1);
+
+   if (m_Blocks.empty() || m_Blocks.back().size - m_Used < size) {
+      size_t blockSize = m_Blocks.empty() ? DECODE_ARENA_MIN_BLOCK : m_Blocks.back().size * 2;
+      AddBlock(blockSize > size ? blockSize : size);
+   }
+
+   uint8_t* memory = m_Blocks.back().start + m_Used;
+   m_Used += size;
+   m_Size += size;
+
+   if (m_Size > m_PeakSize) {
+      m_PeakSize = m_Size;
+   }
+
+   return memory;
+}
+
+void DecodeArena::Reset() {
+   if (m_Blocks.size() > 1) {
+      size_t total = GetCapacity();
+      m_Blocks.clear();
+      AddBlock(total);
+   }
+
+   m_Used = 0;
+   m_Size = 0;
+}
+
+size_t DecodeArena::GetCapacity() const {
+   size_t total = 0;
+   for (const Block& block : m_Blocks) {
+      total += block.size;
+   }
+
+   return total;
+}
+
+void DecodeArena::AddBlock(size_t size) {
+   Block block;
+   block.memory.reset(new uint8_t[size + DECODE_ARENA_ALIGNMENT - 1]);
+   block.start = (uint8_t*) (((uintptr_t) block.memory.get() + DECODE_ARENA_ALIGNMENT - 1) & ~(uintptr_t) (DECODE_ARENA_ALIGNMENT - 1));
+   block.size = size;
+
+   m_Blocks.emplace_back(std::move(block));
+   m_Used = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define DECODE_ARENA_ALIGNMENT 64//Cache line, also enough for any vector load
+#define DECODE_ARENA_MIN_BLOCK (64 * 1024)
+
+//Bump allocator for the scratch memory of one decode, everything is freed at once by Reset.
+//A decode that needed more than one block leaves a single merged block behind, so from then on
+//decodes of images up to that size allocate nothing
+class DecodeArena {
+public:
+
+   DecodeArena() = default;
+   DecodeArena(const DecodeArena&) = delete;
+   DecodeArena& operator=(const DecodeArena&) = delete;
+
+   //Aligned to DECODE_ARENA_ALIGNMENT, stays valid until Reset
+   void* Allocate(size_t size);
+
+   template<typename T>
+   T* AllocateArray(size_t count) {
+      return (T*) Allocate(count * sizeof(T));
+   }
+
+   void Reset();
+
+   //Bytes handed out since the last reset
+   size_t GetSize() const {
+      return m_Size;
+   }
+
+   //Most bytes handed out between two resets
+   size_t GetPeakSize() const {
+      return m_PeakSize;
+   }
+
+   size_t GetCapacity() const;
+
+private:
+
+   struct Block {
+      std::unique_ptr<uint8_t[]> memory;
+      uint8_t* start;//First aligned byte
+      size_t size;
+   };
+
+   std::vector<Block> m_Blocks;
+   size_t m_Used = 0;//In the last block
+   size_t m_Size = 0;//Since the last reset
+   size_t m_PeakSize = 0;
+
+private:
+
+   void AddBlock(size_t size);
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include "inflater.h"
+#include <cstring>
+
+//Tables and helpers of the deflate format, shared by the streaming and the parallel inflater
+
+enum class CompType {
+   NONE = 0,
+   FIXED = 1,
+   DYNAMIC = 2,
+   ERROR_TYPE = 3
+};
+
+#define MAX_MATCH 258
+
+static constexpr uint32_t indexToCodeLengthSymMap[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+static constexpr uint32_t lengthTable[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static constexpr uint32_t lengthExtraBitTable[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static constexpr uint32_t distTable[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static constexpr uint32_t distExtraBitTable[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+//Fixed codes are short enough for the root table alone: 7 to 9 bits for literals and lengths, 5 bits for distances
+static constexpr HuffmanTable MakeFixedTable(bool isDistance) {
+   HuffmanTable table{};
+   uint8_t lengths[288]{};
+   uint32_t symCount = isDistance ? 32 : 288;
+
+   for (uint32_t i = 0; i < symCount; i++) {
+      if (isDistance) {
+         lengths[i] = 5;
+      } else {
+         lengths[i] = i <= 143 ? 8 : i <= 255 ? 9 : i <= 279 ? 7 : 8;
+      }
+   }
+
+   uint32_t root = isDistance ? 5 : 9;
+   uint32_t code = 0;//Canonical code, most significant bit first
+
+   for (uint32_t len = 1; len <= root; len++) {
+      for (uint32_t sym = 0; sym < symCount; sym++) {
+         if (lengths[sym] != len) {
+            continue;
+         }
+
+         //The stream sends codes starting with their top bit, the table is indexed by bits as they arrive
+         uint32_t reversed = 0;
+         for (uint32_t bit = 0; bit < len; bit++) {
+            reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+         }
+
+         for (uint32_t fill = reversed; fill < (1u << root); fill += 1 << len) {
+            table.entries[fill] = {(uint16_t) sym, (uint8_t) len, HuffmanOp::SYMBOL};
+         }
+
+         code++;
+      }
+
+      code <<= 1;
+   }
+
+   table.rootBits = root;
+   table.isFilled = true;
+   return table;
+}
+
+//Built by the compiler, so they are shared by every thread without any setup
+static constexpr HuffmanTable fixedLitLen = MakeFixedTable(false);
+static constexpr HuffmanTable fixedDist = MakeFixedTable(true);
+
+//Copies a match in 8, 16 or 32 byte steps, writing up to INFLATE_COPY_OVERRUN bytes past its end.
+//Distances shorter than a step are widened first: once dist bytes are copied the pattern repeats at 2 * dist
+static inline void CopyMatch(uint8_t* out, uint32_t dist, uint32_t length) {
+   const uint8_t* end = out + length;
+
+   if (dist == 1) {
+      memset(out, out[-1], length);
+      return;
+   }
+
+   while (dist < 8 && out < end) {
+      const uint8_t* from = out - dist;
+      for (uint32_t i = 0; i < dist; i++) {
+         out[i] = from[i];
+      }
+      out += dist;
+      dist *= 2;
+   }
+
+   const uint8_t* from = out - dist;
+   if (dist >= 32) {
+      while (out < end) {
+         memcpy(out, from, 16);
+         memcpy(out + 16, from + 16, 16);
+         out += 32;
+         from += 32;
+      }
+   } else if (dist >= 16) {
+      while (out < end) {
+         memcpy(out, from, 16);
+         out += 16;
+         from += 16;
+      }
+   } else {
+      while (out < end) {
+         memcpy(out, from, 8);
+         out += 8;
+         from += 8;
+      }
+   }
+}
+
+static inline HuffmanEntry GetEntry(const HuffmanTable& table, BitReader& reader) {
+   HuffmanEntry entry = table.entries[reader.Peek(table.rootBits)];
+
+   if (entry.op == HuffmanOp::LINK) {
+      reader.Consume(table.rootBits);
+      entry = table.entries[entry.value + reader.Peek(entry.bits)];
+   }
+
+   return entry;
+}
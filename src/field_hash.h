@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+//Perfect hash of a fixed set of saved field names, its seed is searched for at compile time.
+//Items are the names themselves or anything with a name member, like the columns of a binary save.
+//Find maps a name to its index in the set with one hash and one compare, any other name gives -1
+template<size_t N>
+class FieldHash {
+public:
+
+   template<typename Item>
+   constexpr FieldHash(const Item (&items)[N]) {
+      for (uint32_t seed = 1; !TryPlace(items, seed); seed++) {
+      }
+   }
+
+   constexpr int Find(std::string_view name) const {
+      const Slot& slot = m_Slots[Hash(name, m_Seed) & (SLOT_COUNT - 1)];
+      return slot.index >= 0 && slot.name == name ? slot.index : -1;
+   }
+
+private:
+
+   struct Slot {
+      std::string_view name;
+      int index = -1;
+   };
+
+   //Twice the names rounded up to a power of two, a seed without collisions is found within a few tries
+   static constexpr size_t GetSlotCount() {
+      size_t count = 1;
+      while (count < N * 2) {
+         count *= 2;
+      }
+      return count;
+   }
+
+   static constexpr size_t SLOT_COUNT = GetSlotCount();
+
+   Slot m_Slots[SLOT_COUNT] = {};
+   uint32_t m_Seed = 0;
+
+   //FNV-1a started from the seed
+   static constexpr uint32_t Hash(std::string_view name, uint32_t seed) {
+      uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+      for (char c : name) {
+         hash = (hash ^ (uint8_t) c) * 16777619u;
+      }
+      return hash ^ (hash >> 16);
+   }
+
+   static constexpr std::string_view GetName(std::string_view name) {
+      return name;
+   }
+
+   template<typename Item>
+   static constexpr std::string_view GetName(const Item& item) {
+      return item.name;
+   }
+
+   template<typename Item>
+   constexpr bool TryPlace(const Item (&items)[N], uint32_t seed) {
+      for (Slot& slot : m_Slots) {
+         slot = Slot();
+      }
+
+      for (size_t i = 0; i < N; i++) {
+         std::string_view name = GetName(items[i]);
+         Slot& slot = m_Slots[Hash(name, seed) & (SLOT_COUNT - 1)];
+         if (slot.index >= 0) {
+            return false;
+         }
+
+         slot.name = name;
+         slot.index = (int) i;
+      }
+
+      m_Seed = seed;
+      return true;
+   }
+};
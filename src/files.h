@@ -1,9 +1,11 @@
 #pragma once
 
-const wchar_t* const IMAGE_ATLAS = L"resources\\icon_atlas.png";
+const wchar_t* const IMAGE_PACK = L"resources\\icon_pack.spk";
 const wchar_t* const ICON = L"resources\\icon.ico";
 const wchar_t* const ICON_WARNING = L"resources\\icon_warning.ico";
 const wchar_t* const ICON_FAIL = L"resources\\icon_fail.ico";
 const wchar_t* const SETTINGS_SAVE = L"saves\\settings";
 const wchar_t* const RECORDS_SAVE = L"saves\\records";
-const wchar_t* const STATE_SAVE = L"saves\\state";
\ No newline at end of file
+const wchar_t* const RECORD_STORE_SAVE = L"saves\\record_store";
+const wchar_t* const STATE_SAVE = L"saves\\state";
+const wchar_t* const STATE_LOG = L"saves\\state.log";
\ No newline at end of file
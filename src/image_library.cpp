@@ -1,25 +1,48 @@
 #include "image_library.h"
+#include "image_resample.h"
 #include "png_reader.h"
+#include "sprite_pack.h"
 #include "files.h"
+#include <map>
+#include <utility>
+#include <vector>
 
 #define IMAGE_WIDTH 64
 #define IMAGE_HEIGHT 64
 
-static HBITMAP s_AtlasBM;
 static HBITMAP s_FallbackBM;
-static HDC s_AtlasDC;
 static HDC s_FallbackDC;
-static int s_Width, s_Height;
-static bool s_AtlasIsValid;
 
-#define IMAGE_COUNT 16
-static POINT s_ImageMap[IMAGE_COUNT] = {{0, 0}, {1, 0}, {2, 0}, {3, 0}, 
-                                        {0, 1}, {1, 1}, {2, 1}, {3, 1}, 
-                                        {0, 2}, {1, 2}, {2, 2}, {3, 2}, 
-                                        {0, 3}, {1, 3}, {2, 3}, {3, 3}};
+//The pack stays mapped, sprites are decoded on their first draw and kept at their own size
+static HANDLE s_PackMapping;
+static const uint8_t* s_PackView;
+static SpritePackView s_Pack;
+static PNGDecoderContext s_DecoderContext;
+
+struct Sprite {
+   bool isDecoded;//Also after a failed decode, so it is not tried on every draw
+   PNGImage image;//Empty when decoding failed
+};
+
+static std::vector<Sprite> s_Sprites;
+
+//Sprites scaled once to one draw size, side by side in a row. Sprites are scaled on their first draw
+struct SpriteSheet {
+   HBITMAP bitmap;
+   HDC dc;
+   uint32_t* pixels;
+   std::vector<bool> isScaled;
+};
+
+static std::map<std::pair<int, int>, SpriteSheet> s_SpriteSheets;//By draw width and height
 
 static void DrawFallbackImage(HDC hdc, POINT pos, POINT size);
 
+static const PNGImage* GetSprite(int imageIndex);
+static SpriteSheet* GetSpriteSheet(HDC hdc, POINT size);
+static void ScaleSprite(SpriteSheet& sheet, POINT size, int imageIndex, const PNGImage& sprite);
+static void ClearSpriteSheets();
+
 void InitImageLibrary(HWND hWnd) {
    if (s_FallbackDC) {
       return;
@@ -59,66 +82,69 @@ void InitImageLibrary(HWND hWnd) {
 }
 
 void TerminateImageLibrary() {
-   UnloadAtlas();
+   UnloadSpritePack();
 
    DeleteDC(s_FallbackDC);
    DeleteObject(s_FallbackBM);
 }
 
-void LoadAtlas(HWND hWnd) {
-   if (s_AtlasBM) {
-      UnloadAtlas();
+void LoadSpritePack(HWND hWnd) {
+   UnloadSpritePack();
+
+   HANDLE file = CreateFile(IMAGE_PACK, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   LARGE_INTEGER fileSize{};
+   bool isSized = file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0;
+
+   //The mapping keeps the file open on its own
+   s_PackMapping = isSized ? CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+   if (file != INVALID_HANDLE_VALUE) {
+      CloseHandle(file);
    }
 
-   s_AtlasIsValid = false;
+   s_PackView = s_PackMapping ? (const uint8_t*) MapViewOfFile(s_PackMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+   if (!s_PackView || !s_Pack.TryOpen(s_PackView, (size_t) fileSize.QuadPart)) {
+      UnloadSpritePack();
 
-   HDC hdc = GetDC(hWnd);
-   s_AtlasBM = LoadPNG(IMAGE_ATLAS, hdc, TRANSPARENCY_COLOR);
-   s_AtlasDC = CreateCompatibleDC(hdc);
-
-   if (s_AtlasBM) {
-      BITMAP bm;
-      GetObject(s_AtlasBM, sizeof(bm), &bm);
-      s_Width = bm.bmWidth;
-      s_Height = bm.bmHeight;
-
-      if (s_Width % IMAGE_WIDTH == 0 && s_Height % IMAGE_HEIGHT == 0) {
-         SelectObject(s_AtlasDC, s_AtlasBM);
-         s_AtlasIsValid = true;
-      } else {
-         s_Width = 0;
-         s_Height = 0;
-
-         MessageBox(hWnd, L"Incompatible atlas size", L"Error", MB_OK);
-      }
-   } else {
-      s_Width = 0;
-      s_Height = 0;
-      
-      MessageBox(hWnd, L"Failed to load atlas", L"Error", MB_OK);
+      MessageBox(hWnd, L"Failed to load images", L"Error", MB_OK);
+      return;
    }
 
-   ReleaseDC(hWnd, hdc);
+   s_Sprites.resize(s_Pack.GetSpriteCount());
 }
 
-void UnloadAtlas() {
-   DeleteDC(s_AtlasDC);
-   DeleteObject(s_AtlasBM);
+void UnloadSpritePack() {
+   ClearSpriteSheets();
+
+   s_Sprites.clear();
+   s_Pack.Close();
+
+   if (s_PackView) {
+      UnmapViewOfFile(s_PackView);
+      s_PackView = nullptr;
+   }
+
+   if (s_PackMapping) {
+      CloseHandle(s_PackMapping);
+      s_PackMapping = nullptr;
+   }
+}
+
+int GetImageCount() {
+   return (int) s_Sprites.size();
 }
 
 void DrawImage(HDC hdc, const POINT pos, const POINT size, int imageIndex) {
-   SetStretchBltMode(hdc, HALFTONE);
+   const PNGImage* sprite = GetSprite(imageIndex);
+   SpriteSheet* sheet = sprite ? GetSpriteSheet(hdc, size) : nullptr;
 
-   if (s_AtlasIsValid && s_Width > 0 && s_Height > 0 && imageIndex >= 0 && imageIndex < IMAGE_COUNT) {
-      POINT imagePoint = s_ImageMap[imageIndex];
-      int xOffset = imagePoint.x * IMAGE_WIDTH;
-      int yOffset = imagePoint.y * IMAGE_HEIGHT;
-      if (xOffset >= 0 && yOffset >= 0 && xOffset + IMAGE_WIDTH <= s_Width && yOffset + IMAGE_HEIGHT <= s_Height) {
-         TransparentBlt(hdc, pos.x, pos.y, size.x, size.y, s_AtlasDC, xOffset, yOffset, IMAGE_WIDTH, IMAGE_HEIGHT, TRANSPARENCY_COLOR);
-      } else {
-         DrawFallbackImage(hdc, pos, size);
+   if (sheet) {
+      if (!sheet->isScaled[imageIndex]) {
+         ScaleSprite(*sheet, size, imageIndex, *sprite);
       }
-   }else{
+
+      //Same size on both sides, so this is a plain keyed copy
+      TransparentBlt(hdc, pos.x, pos.y, size.x, size.y, sheet->dc, imageIndex * size.x, 0, size.x, size.y, TRANSPARENCY_COLOR);
+   } else {
       DrawFallbackImage(hdc, pos, size);
    }
 }
@@ -126,4 +152,71 @@ void DrawImage(HDC hdc, const POINT pos, const POINT size, int imageIndex) {
 static void DrawFallbackImage(HDC hdc, const POINT pos, const POINT size) {
    SetStretchBltMode(hdc, HALFTONE);
    StretchBlt(hdc, pos.x, pos.y, size.x, size.y, s_FallbackDC, 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT, SRCCOPY);
+}
+
+static const PNGImage* GetSprite(int imageIndex) {
+   if (imageIndex < 0 || imageIndex >= GetImageCount()) {
+      return nullptr;
+   }
+
+   Sprite& sprite = s_Sprites[imageIndex];
+   if (!sprite.isDecoded) {
+      sprite.isDecoded = true;
+      if (!s_Pack.TryDecodeSprite((uint32_t) imageIndex, MakeDecodeOptions(TRANSPARENCY_COLOR), sprite.image, s_DecoderContext)) {
+         sprite.image = PNGImage();
+      }
+   }
+
+   return sprite.image.pixels.empty() ? nullptr : &sprite.image;
+}
+
+static SpriteSheet* GetSpriteSheet(HDC hdc, const POINT size) {
+   if (size.x <= 0 || size.y <= 0) {
+      return nullptr;
+   }
+
+   auto found = s_SpriteSheets.find({size.x, size.y});
+   if (found != s_SpriteSheets.end()) {
+      return &found->second;
+   }
+
+   BITMAPINFO bmi = {};
+   bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+   bmi.bmiHeader.biWidth = size.x * GetImageCount();
+   bmi.bmiHeader.biHeight = -size.y;
+   bmi.bmiHeader.biPlanes = 1;
+   bmi.bmiHeader.biBitCount = 32;
+   bmi.bmiHeader.biCompression = BI_RGB;
+
+   SpriteSheet sheet{};
+   sheet.bitmap = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, reinterpret_cast<void**>(&sheet.pixels), nullptr, 0);
+   if (!sheet.bitmap) {
+      return nullptr;
+   }
+
+   sheet.dc = CreateCompatibleDC(hdc);
+   SelectObject(sheet.dc, sheet.bitmap);
+   sheet.isScaled.resize(GetImageCount());
+
+   return &s_SpriteSheets.emplace(std::make_pair(size.x, size.y), sheet).first->second;
+}
+
+static void ScaleSprite(SpriteSheet& sheet, const POINT size, int imageIndex, const PNGImage& sprite) {
+   //GDI may still be drawing into the sheet
+   GdiFlush();
+
+   uint32_t* dst = sheet.pixels + imageIndex * size.x;
+   uint32_t keyPixel = MakeDecodeOptions(TRANSPARENCY_COLOR).transparentPixel;
+   ResampleBox(sprite.pixels.data(), sprite.width, sprite.width, sprite.height, dst, (size_t) size.x * GetImageCount(), size.x, size.y, AlphaMode::COLOR_KEY, keyPixel);
+
+   sheet.isScaled[imageIndex] = true;
+}
+
+static void ClearSpriteSheets() {
+   for (auto& entry : s_SpriteSheets) {
+      DeleteDC(entry.second.dc);
+      DeleteObject(entry.second.bitmap);
+   }
+
+   s_SpriteSheets.clear();
 }
\ No newline at end of file
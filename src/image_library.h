@@ -16,6 +16,9 @@ const COLORREF TRANSPARENCY_COLOR = RGB(255, 0, 0);
 
 void InitImageLibrary(HWND hWnd);
 void TerminateImageLibrary();
-void LoadAtlas(HWND hWnd);
-void UnloadAtlas();
+
+//Maps the sprite pack, images are decoded on their first draw. Until then or if loading failed images draw as the fallback
+void LoadSpritePack(HWND hWnd);
+void UnloadSpritePack();
+int GetImageCount();
 void DrawImage(HDC hdc, const POINT pos, const POINT size, int imageIndex);
\ No newline at end of file
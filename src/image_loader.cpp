@@ -0,0 +1,103 @@
+#include "image_loader.h"
+#include <chrono>
+#include <memory>
+
+ImageLoader::~ImageLoader() {
+   Stop();
+}
+
+std::vector<std::future<LoadedAsset>> ImageLoader::LoadBatch(HINSTANCE instance, const std::vector<AssetRequest>& requests, const AssetReadyCallback& onReady) {
+   std::vector<std::future<LoadedAsset>> result;
+   result.reserve(requests.size());
+
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+
+      for (size_t i = 0; i < requests.size(); i++) {
+         //Jobs are copyable functions, so the promise is shared with the job
+         auto promise = std::make_shared<std::promise<LoadedAsset>>();
+         result.emplace_back(promise->get_future());
+
+         AssetRequest request = requests[i];
+         m_Jobs.emplace_back([instance, request, promise, onReady, i]() {
+            promise->set_value(Load(instance, request));
+
+            if (onReady) {
+               onReady(i);
+            }
+         });
+      }
+   }
+
+   StartThreads(requests.size());
+   m_JobAdded.notify_all();
+
+   return result;
+}
+
+void ImageLoader::Stop() {
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_IsStopping = true;
+      m_Jobs.clear();
+   }
+
+   m_JobAdded.notify_all();
+
+   for (std::thread& thread : m_Threads) {
+      thread.join();
+   }
+
+   m_Threads.clear();
+   m_IsStopping = false;
+}
+
+void ImageLoader::StartThreads(size_t jobCount) {
+   size_t threadCount = std::thread::hardware_concurrency();
+   if (threadCount > IMAGE_LOADER_MAX_THREADS) {
+      threadCount = IMAGE_LOADER_MAX_THREADS;
+   }
+
+   if (threadCount > jobCount) {
+      threadCount = jobCount;
+   }
+
+   if (threadCount < 1) {
+      threadCount = 1;
+   }
+
+   while (m_Threads.size() < threadCount) {
+      m_Threads.emplace_back(&ImageLoader::RunJobs, this);
+   }
+}
+
+void ImageLoader::RunJobs() {
+   while (true) {
+      std::function<void()> job;
+
+      {
+         std::unique_lock<std::mutex> lock(m_Mutex);
+         m_JobAdded.wait(lock, [this]() { return m_IsStopping || !m_Jobs.empty(); });
+
+         if (m_IsStopping) {
+            return;
+         }
+
+         job = std::move(m_Jobs.front());
+         m_Jobs.pop_front();
+      }
+
+      job();
+   }
+}
+
+LoadedAsset ImageLoader::Load(HINSTANCE instance, const AssetRequest& request) {
+   LoadedAsset result;
+   auto start = std::chrono::steady_clock::now();
+
+   result.icon = (HICON) LoadImage(instance, request.fileName, IMAGE_ICON, 0, 0, LR_DEFAULTSIZE | LR_LOADFROMFILE);
+   result.isLoaded = result.icon != nullptr;
+
+   result.loadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+   return result;
+}
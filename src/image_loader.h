@@ -0,0 +1,55 @@
+#pragma once
+#include <Windows.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define IMAGE_LOADER_MAX_THREADS 4
+
+//Icon files, images come from the sprite pack of the image library as they're drawn
+struct AssetRequest {
+   const wchar_t* fileName = nullptr;
+};
+
+struct LoadedAsset {
+   bool isLoaded = false;
+   HICON icon = nullptr;
+   double loadMilliseconds = 0;//Startup instrumentation
+};
+
+//Runs on a worker thread right after the future of the asset at index became ready
+typedef std::function<void(size_t index)> AssetReadyCallback;
+
+//Small worker pool that loads startup assets off the UI thread.
+//Workers start with the first batch and live until Stop
+class ImageLoader {
+public:
+
+   ImageLoader() = default;
+   ~ImageLoader();
+
+   //One future per request, in the same order
+   std::vector<std::future<LoadedAsset>> LoadBatch(HINSTANCE instance, const std::vector<AssetRequest>& requests, const AssetReadyCallback& onReady = nullptr);
+
+   //Drops queued requests and waits for the running ones. Their futures stay unready
+   void Stop();
+
+private:
+
+   std::vector<std::thread> m_Threads;
+   std::deque<std::function<void()>> m_Jobs;
+   std::mutex m_Mutex;
+   std::condition_variable m_JobAdded;
+   bool m_IsStopping = false;
+
+private:
+
+   void StartThreads(size_t jobCount);
+   void RunJobs();
+
+   static LoadedAsset Load(HINSTANCE instance, const AssetRequest& request);
+};
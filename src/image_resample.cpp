@@ -0,0 +1,122 @@
+#include "image_resample.h"
+#include <cmath>
+#include <vector>
+
+//Source pixels of one output pixel along one axis, weights sum up to one
+struct BoxTaps {
+   uint32_t first;
+   uint32_t count;
+   size_t weightOffset;
+};
+
+static void MakeTaps(uint32_t srcSize, uint32_t dstSize, std::vector<BoxTaps>& taps, std::vector<float>& weights);
+
+void ResampleBox(const uint32_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight, uint32_t* dst, size_t dstStride, uint32_t dstWidth, uint32_t dstHeight, AlphaMode mode, uint32_t keyPixel) {
+   if (!srcWidth || !srcHeight || !dstWidth || !dstHeight) {
+      return;
+   }
+
+   std::vector<BoxTaps> tapsX;
+   std::vector<BoxTaps> tapsY;
+   std::vector<float> weightsX;
+   std::vector<float> weightsY;
+   MakeTaps(srcWidth, dstWidth, tapsX, weightsX);
+   MakeTaps(srcHeight, dstHeight, tapsY, weightsY);
+
+   bool isColorKey = mode == AlphaMode::COLOR_KEY;
+
+   //Horizontal pass into blue, green, red and coverage sums. In color key mode the colors are weighted by coverage
+   std::vector<float> columns((size_t) srcHeight * dstWidth * 4);
+   for (uint32_t y = 0; y < srcHeight; y++) {
+      const uint32_t* row = src + y * srcStride;
+      float* out = &columns[(size_t) y * dstWidth * 4];
+
+      for (uint32_t x = 0; x < dstWidth; x++, out += 4) {
+         const BoxTaps& taps = tapsX[x];
+         float sums[4] = {};
+
+         for (uint32_t i = 0; i < taps.count; i++) {
+            uint32_t pixel = row[taps.first + i];
+            float weight = weightsX[taps.weightOffset + i];
+
+            if (isColorKey) {
+               if (pixel == keyPixel) {
+                  continue;
+               }
+               sums[3] += weight;
+            } else {
+               sums[3] += weight * (float) (pixel >> 24);
+            }
+
+            sums[0] += weight * (float) (pixel & 0xFF);
+            sums[1] += weight * (float) ((pixel >> 8) & 0xFF);
+            sums[2] += weight * (float) ((pixel >> 16) & 0xFF);
+         }
+
+         for (int c = 0; c < 4; c++) {
+            out[c] = sums[c];
+         }
+      }
+   }
+
+   //Vertical pass straight into the output
+   for (uint32_t y = 0; y < dstHeight; y++) {
+      const BoxTaps& taps = tapsY[y];
+      uint32_t* row = dst + y * dstStride;
+
+      for (uint32_t x = 0; x < dstWidth; x++) {
+         float sums[4] = {};
+
+         for (uint32_t i = 0; i < taps.count; i++) {
+            const float* column = &columns[((size_t) (taps.first + i) * dstWidth + x) * 4];
+            float weight = weightsY[taps.weightOffset + i];
+
+            for (int c = 0; c < 4; c++) {
+               sums[c] += weight * column[c];
+            }
+         }
+
+         if (isColorKey) {
+            if (sums[3] < 0.5f) {
+               row[x] = keyPixel;
+               continue;
+            }
+
+            for (int c = 0; c < 3; c++) {
+               sums[c] /= sums[3];
+            }
+            sums[3] = 0;
+         }
+
+         uint32_t pixel = 0;
+         for (int c = 0; c < 4; c++) {
+            float value = sums[c] + 0.5f;
+            pixel |= (uint32_t) (value < 255.0f ? value : 255.0f) << (c * 8);
+         }
+         row[x] = pixel;
+      }
+   }
+}
+
+//Output pixel i covers source [i * scale, (i + 1) * scale). Upscaling gives a single source pixel for most of them
+static void MakeTaps(uint32_t srcSize, uint32_t dstSize, std::vector<BoxTaps>& taps, std::vector<float>& weights) {
+   double scale = (double) srcSize / dstSize;
+   taps.resize(dstSize);
+
+   for (uint32_t i = 0; i < dstSize; i++) {
+      double start = i * scale;
+      double end = (i + 1) * scale;
+      uint32_t first = (uint32_t) start;
+      uint32_t last = (uint32_t) std::ceil(end);
+      if (last > srcSize) {
+         last = srcSize;
+      }
+
+      taps[i] = {first, last - first, weights.size()};
+
+      for (uint32_t j = first; j < last; j++) {
+         double overlap = (end < j + 1 ? end : j + 1) - (start > j ? start : j);
+         weights.emplace_back((float) (overlap / scale));
+      }
+   }
+}
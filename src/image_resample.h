@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "pixel_convert.h"
+
+//Box filter scaling of BGRA images, strides in pixels. Every output pixel averages the source area it covers, weighted
+//by how much of each source pixel falls inside it. Premultiplied pixels average as they are. In color key mode key pixels
+//add no color, and an output pixel becomes the key when less than half of its area is opaque, so edges don't pick up the key
+void ResampleBox(const uint32_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight, uint32_t* dst, size_t dstStride, uint32_t dstWidth, uint32_t dstHeight, AlphaMode mode, uint32_t keyPixel);
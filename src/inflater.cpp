@@ -0,0 +1,631 @@
+#include "inflater.h"
+#include "checksum.h"
+#include "deflate_format.h"
+#include <cstring>
+
+#define SYM_NEED_INPUT -1
+#define SYM_INVALID -2
+
+void BitReader::SetInput(const uint8_t* data, size_t length) {
+   this->data = data;
+   this->length = length;
+   index = 0;
+}
+
+size_t BitReader::TakeBytes(uint8_t* out, size_t count) {
+   size_t taken = 0;
+   while (taken < count && bitCount >= 8) {
+      out[taken++] = (uint8_t) bitBuffer;
+      Consume(8);
+   }
+
+   if (!bitCount) {
+      bitBuffer = 0;//Drop bytes looked ahead by Refill, they are copied from data below
+
+      size_t partCount = length - index < count - taken ? length - index : count - taken;
+      memcpy(out + taken, data + index, partCount);
+      index += partCount;
+      taken += partCount;
+   }
+
+   return taken;
+}
+
+bool HuffmanTable::TryBuild(const uint8_t* lengths, uint32_t symCount, uint32_t maxRootBits) {
+   isFilled = false;
+
+   uint16_t count[HUFFMAN_MAX_BITS + 1]{0};
+   for (uint32_t i = 0; i < symCount; i++) {
+      count[lengths[i]]++;
+   }
+
+   uint32_t maxLen = HUFFMAN_MAX_BITS;
+   while (maxLen >= 1 && !count[maxLen]) {
+      maxLen--;
+   }
+
+   if (!maxLen) {//No codes, any lookup is invalid
+      rootBits = 1;
+      entries[0] = entries[1] = {0, 1, HuffmanOp::INVALID};
+      isFilled = true;
+      return true;
+   }
+
+   uint32_t minLen = 1;
+   while (minLen < maxLen && !count[minLen]) {
+      minLen++;
+   }
+
+   uint32_t root = maxRootBits;
+   if (root > maxLen) {
+      root = maxLen;
+   }
+   if (root < minLen) {
+      root = minLen;
+   }
+
+   int32_t left = 1;
+   for (uint32_t len = 1; len <= HUFFMAN_MAX_BITS; len++) {
+      left <<= 1;
+      left -= count[len];
+      if (left < 0) {//Over-subscribed
+         return false;
+      }
+   }
+
+   if (left > 0 && maxLen != 1) {//Incomplete, allowed only for a single code
+      return false;
+   }
+
+   uint16_t offsets[HUFFMAN_MAX_BITS + 2]{0};
+   for (uint32_t len = 1; len <= HUFFMAN_MAX_BITS; len++) {
+      offsets[len + 1] = offsets[len] + count[len];
+   }
+
+   uint16_t sorted[288];
+   for (uint32_t i = 0; i < symCount; i++) {
+      if (lengths[i]) {
+         sorted[offsets[lengths[i]]++] = (uint16_t) i;
+      }
+   }
+
+   uint32_t code = 0;//Current code in stream (bit-reversed) order
+   uint32_t symIndex = 0;
+   uint32_t len = minLen;
+   uint32_t tableOffset = 0;
+   uint32_t currBits = root;
+   uint32_t drop = 0;
+   uint32_t low = UINT32_MAX;
+   uint32_t used = 1 << root;
+   uint32_t mask = used - 1;
+
+   if (used > HUFFMAN_ENOUGH) {
+      return false;
+   }
+
+   while (true) {
+      HuffmanEntry entry{sorted[symIndex], (uint8_t) (len - drop), HuffmanOp::SYMBOL};
+
+      //Replicate the entry over every index sharing its low bits
+      uint32_t increment = 1 << (len - drop);
+      uint32_t fill = 1 << currBits;
+      uint32_t currSize = fill;
+      do {
+         fill -= increment;
+         entries[tableOffset + (code >> drop) + fill] = entry;
+      } while (fill);
+
+      increment = 1 << (len - 1);
+      while (code & increment) {
+         increment >>= 1;
+      }
+      if (increment) {
+         code &= increment - 1;
+         code += increment;
+      } else {
+         code = 0;
+      }
+
+      symIndex++;
+      if (--count[len] == 0) {
+         if (len == maxLen) {
+            break;
+         }
+         len = lengths[sorted[symIndex]];
+      }
+
+      //Start a new subtable when the root prefix changes
+      if (len > root && (code & mask) != low) {
+         if (!drop) {
+            drop = root;
+         }
+
+         tableOffset += currSize;
+
+         currBits = len - drop;
+         int32_t subLeft = 1 << currBits;
+         while (currBits + drop < maxLen) {
+            subLeft -= count[currBits + drop];
+            if (subLeft <= 0) {
+               break;
+            }
+            currBits++;
+            subLeft <<= 1;
+         }
+
+         used += 1 << currBits;
+         if (used > HUFFMAN_ENOUGH) {
+            return false;
+         }
+
+         low = code & mask;
+         entries[low] = {(uint16_t) tableOffset, (uint8_t) currBits, HuffmanOp::LINK};
+      }
+   }
+
+   if (code) {//Only for an incomplete single code
+      entries[tableOffset + (code >> drop)] = {0, (uint8_t) (len - drop), HuffmanOp::INVALID};
+   }
+
+   rootBits = root;
+   isFilled = true;
+   return true;
+}
+
+void Inflater::Reset(uint8_t* window, size_t capacity) {
+   reader = BitReader();
+   state = InflateState::ZLIB_HEADER;
+   isLastBlock = false;
+   memset(blockCounts, 0, sizeof(blockCounts));
+
+   isChecksumFailed = false;
+   adler = 1;
+   checkedPos = 0;
+
+   this->window = window;
+   this->capacity = capacity;
+   outPos = 0;
+   readPos = 0;
+}
+
+void Inflater::SetInput(const uint8_t* data, size_t length) {
+   reader.SetInput(data, length);
+}
+
+InflateResult Inflater::Fail() {
+   state = InflateState::FAILED;
+   return InflateResult::FAILED;
+}
+
+void Inflater::NextBlock() {
+   state = isLastBlock ? InflateState::CHECKSUM : InflateState::BLOCK_HEADER;
+}
+
+//Output is summed once per call while it is still in cache
+void Inflater::UpdateChecksum() {
+   if (isVerifying) {
+      adler = UpdateAdler32(adler, window + checkedPos, outPos - checkedPos);
+   }
+
+   checkedPos = outPos;
+}
+
+//Drops output that is both consumed and out of reach of back references
+bool Inflater::TryMakeRoom() {
+   size_t start = outPos > INFLATE_WINDOW_SIZE ? outPos - INFLATE_WINDOW_SIZE : 0;
+   if (start > readPos) {
+      start = readPos;
+   }
+
+   if (start) {
+      UpdateChecksum();
+
+      memmove(window, window + start, outPos - start);
+      outPos -= start;
+      readPos -= start;
+      checkedPos -= start;
+   }
+
+   return outPos < capacity;
+}
+
+//Lookups may see zero bits past the buffered ones, an entry is only trusted when all of its bits are buffered
+int Inflater::TryDecodeSym(const HuffmanTable& table) {
+   if (reader.bitCount < HUFFMAN_MAX_BITS) {
+      reader.Refill();
+   }
+
+   HuffmanEntry entry = table.entries[reader.Peek(table.rootBits)];
+   uint32_t rootBits = 0;
+
+   if (entry.op == HuffmanOp::LINK) {
+      if (reader.bitCount < table.rootBits) {
+         return SYM_NEED_INPUT;
+      }
+
+      rootBits = table.rootBits;
+      entry = table.entries[entry.value + (uint32_t) ((reader.bitBuffer >> rootBits) & ((1ull << entry.bits) - 1))];
+   }
+
+   if (rootBits + entry.bits > reader.bitCount) {
+      return SYM_NEED_INPUT;
+   }
+
+   if (entry.op != HuffmanOp::SYMBOL) {
+      return SYM_INVALID;
+   }
+
+   reader.Consume(rootBits + entry.bits);
+   return entry.value;
+}
+
+//Decodes whole literal or match codes while the input and the output window have room for the longest one,
+//so no bit or space checks are needed inside. Returns false on the end of the block or an error
+bool Inflater::TryInflateFast() {
+   if (capacity < MAX_MATCH) {
+      return true;
+   }
+
+   uint8_t* out = window;
+   size_t end = capacity - MAX_MATCH;
+
+   while (reader.length - reader.index >= 8 && outPos <= end) {
+      //56 bits cover the longest code sequence: 15 + 5 length bits and 15 + 13 distance bits
+      reader.Refill();
+
+      HuffmanEntry entry = GetEntry(*litLenCodes, reader);
+      if (entry.op != HuffmanOp::SYMBOL) {
+         state = InflateState::FAILED;
+         return false;
+      }
+      reader.Consume(entry.bits);
+
+      uint32_t sym = entry.value;
+      if (sym <= 255) {
+         out[outPos++] = (uint8_t) sym;
+         continue;
+      } else if (sym == 256) {
+         NextBlock();
+         return false;
+      } else if (sym > 285) {
+         state = InflateState::FAILED;
+         return false;
+      }
+
+      sym -= 257;
+      uint32_t length = lengthTable[sym] + reader.Peek(lengthExtraBitTable[sym]);
+      reader.Consume(lengthExtraBitTable[sym]);
+
+      entry = GetEntry(*distCodes, reader);
+      if (entry.op != HuffmanOp::SYMBOL || entry.value > 29) {
+         state = InflateState::FAILED;
+         return false;
+      }
+      reader.Consume(entry.bits);
+
+      sym = entry.value;
+      uint32_t dist = distTable[sym] + reader.Peek(distExtraBitTable[sym]);
+      reader.Consume(distExtraBitTable[sym]);
+
+      if (dist > outPos) {
+         state = InflateState::FAILED;
+         return false;
+      }
+
+      CopyMatch(out + outPos, dist, length);
+      outPos += length;
+   }
+
+   return true;
+}
+
+InflateResult Inflater::Inflate() {
+   InflateResult result = InflateBlocks();
+   UpdateChecksum();
+   return result;
+}
+
+InflateResult Inflater::InflateBlocks() {
+   while (true) {
+      switch (state) {
+         case InflateState::ZLIB_HEADER: {
+            if (!reader.TryNeed(16)) {
+               return InflateResult::NEED_INPUT;
+            }
+
+            uint32_t cmf = reader.Peek(8);
+            uint32_t flg = (reader.Peek(16) >> 8);
+            reader.Consume(16);
+
+            //First 4 bits - CM, should be equal 8 for PNG
+            //Last 4 bits - CINFO, should be less than 8 for PNG
+            if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flg) % 31) {
+               return Fail();
+            }
+
+            //5th bit flag for preset dictionary, unsupported
+            if (flg & 32) {
+               return Fail();
+            }
+
+            state = InflateState::BLOCK_HEADER;
+            break;
+         }
+         case InflateState::BLOCK_HEADER: {
+            if (!reader.TryNeed(3)) {
+               return InflateResult::NEED_INPUT;
+            }
+
+            isLastBlock = reader.Peek(1);
+            CompType compressionType = (CompType) (reader.Peek(3) >> 1);
+            reader.Consume(3);
+
+            if (compressionType == CompType::NONE) {
+               reader.AlignToByte();
+               state = InflateState::STORED_LENGTH;
+            } else if (compressionType == CompType::FIXED) {
+               litLenCodes = &fixedLitLen;
+               distCodes = &fixedDist;
+               state = InflateState::CODES;
+            } else if (compressionType == CompType::DYNAMIC) {
+               state = InflateState::TABLE_COUNTS;
+            } else {
+               return Fail();
+            }
+
+            blockCounts[(uint32_t) compressionType]++;
+            break;
+         }
+         case InflateState::STORED_LENGTH: {
+            if (!reader.TryNeed(32)) {
+               return InflateResult::NEED_INPUT;
+            }
+
+            uint32_t len = reader.Peek(16);
+            uint32_t nlen = reader.Peek(32) >> 16;
+            reader.Consume(32);
+
+            if ((len ^ 0xFFFF) != nlen) {
+               return Fail();
+            }
+
+            storedLeft = len;
+            state = InflateState::STORED_COPY;
+            break;
+         }
+         case InflateState::STORED_COPY: {
+            while (storedLeft) {
+               if (outPos == capacity && !TryMakeRoom()) {
+                  return InflateResult::OUTPUT_FULL;
+               }
+
+               size_t room = capacity - outPos;
+               size_t taken = reader.TakeBytes(window + outPos, storedLeft < room ? storedLeft : room);
+               if (!taken) {
+                  return InflateResult::NEED_INPUT;
+               }
+
+               outPos += taken;
+               storedLeft -= (uint32_t) taken;
+            }
+
+            NextBlock();
+            break;
+         }
+         case InflateState::TABLE_COUNTS: {
+            if (!reader.TryNeed(14)) {
+               return InflateResult::NEED_INPUT;
+            }
+
+            hlit = reader.Peek(5) + 257;
+            hdist = (reader.Peek(10) >> 5) + 1;
+            hclen = (reader.Peek(14) >> 10) + 4;
+            reader.Consume(14);
+
+            if (hlit > 286 || hdist > 30) {
+               return Fail();
+            }
+
+            memset(lengths, 0, 19);
+            lengthIndex = 0;
+            state = InflateState::CODE_LENGTH_LENGTHS;
+            break;
+         }
+         case InflateState::CODE_LENGTH_LENGTHS: {
+            while (lengthIndex < hclen) {
+               if (!reader.TryNeed(3)) {
+                  return InflateResult::NEED_INPUT;
+               }
+
+               lengths[indexToCodeLengthSymMap[lengthIndex++]] = (uint8_t) reader.Peek(3);
+               reader.Consume(3);
+            }
+
+            if (!codeLengthCodes.TryBuild(lengths, 19, CODE_LENGTH_ROOT_BITS)) {
+               return Fail();
+            }
+
+            memset(lengths, 0, sizeof(lengths));
+            lengthIndex = 0;
+            state = InflateState::CODE_LENGTHS;
+            break;
+         }
+         case InflateState::CODE_LENGTHS: {
+            uint32_t totalCount = hlit + hdist;
+            while (lengthIndex < totalCount) {
+               int sym = TryDecodeSym(codeLengthCodes);
+               if (sym == SYM_NEED_INPUT) {
+                  return InflateResult::NEED_INPUT;
+               } else if (sym < 0) {
+                  return Fail();
+               }
+
+               if (sym <= 15) {
+                  lengths[lengthIndex++] = (uint8_t) sym;
+                  continue;
+               }
+
+               if (sym == 16 && !lengthIndex) {
+                  return Fail();
+               }
+
+               repeatSym = (uint32_t) sym;
+               break;
+            }
+
+            if (lengthIndex < totalCount) {
+               state = InflateState::CODE_LENGTH_REPEAT;
+               break;
+            }
+
+            if (!lengths[256]) {//End of block code is required
+               return Fail();
+            }
+
+            if (!dynamicLitLen.TryBuild(lengths, hlit, LIT_LEN_ROOT_BITS) || !dynamicDist.TryBuild(lengths + hlit, hdist, DIST_ROOT_BITS)) {
+               return Fail();
+            }
+
+            litLenCodes = &dynamicLitLen;
+            distCodes = &dynamicDist;
+            state = InflateState::CODES;
+            break;
+         }
+         case InflateState::CODE_LENGTH_REPEAT: {
+            uint32_t bits = repeatSym == 16 ? 2 : (repeatSym == 17 ? 3 : 7);
+            if (!reader.TryNeed(bits)) {
+               return InflateResult::NEED_INPUT;
+            }
+
+            uint32_t copyCount = reader.Peek(bits) + (repeatSym == 18 ? 11 : 3);
+            reader.Consume(bits);
+
+            if (lengthIndex + copyCount > hlit + hdist) {
+               return Fail();
+            }
+
+            uint8_t lenToCopy = repeatSym == 16 ? lengths[lengthIndex - 1] : 0;
+            for (uint32_t i = 0; i < copyCount; i++) {
+               lengths[lengthIndex + i] = lenToCopy;
+            }
+            lengthIndex += copyCount;
+
+            state = InflateState::CODE_LENGTHS;
+            break;
+         }
+         case InflateState::CODES: {
+            if (!TryInflateFast()) {
+               break;
+            }
+
+            if (outPos == capacity && !TryMakeRoom()) {
+               return InflateResult::OUTPUT_FULL;
+            }
+
+            int sym = TryDecodeSym(*litLenCodes);
+            if (sym == SYM_NEED_INPUT) {
+               return InflateResult::NEED_INPUT;
+            } else if (sym < 0) {
+               return Fail();
+            }
+
+            if (sym <= 255) {
+               window[outPos++] = (uint8_t) sym;
+            } else if (sym == 256) {
+               NextBlock();
+            } else if (sym > 285) {
+               return Fail();
+            } else {
+               copyLength = lengthTable[sym - 257];
+               extraBits = lengthExtraBitTable[sym - 257];
+               state = InflateState::LENGTH_EXTRA;
+            }
+            break;
+         }
+         case InflateState::LENGTH_EXTRA: {
+            if (!reader.TryNeed(extraBits)) {
+               return InflateResult::NEED_INPUT;
+            }
+
+            copyLength += reader.Peek(extraBits);
+            reader.Consume(extraBits);
+            state = InflateState::DIST;
+            break;
+         }
+         case InflateState::DIST: {
+            int sym = TryDecodeSym(*distCodes);
+            if (sym == SYM_NEED_INPUT) {
+               return InflateResult::NEED_INPUT;
+            } else if (sym < 0 || sym > 29) {
+               return Fail();
+            }
+
+            copyDist = distTable[sym];
+            extraBits = distExtraBitTable[sym];
+            state = InflateState::DIST_EXTRA;
+            break;
+         }
+         case InflateState::DIST_EXTRA: {
+            if (!reader.TryNeed(extraBits)) {
+               return InflateResult::NEED_INPUT;
+            }
+
+            copyDist += reader.Peek(extraBits);
+            reader.Consume(extraBits);
+
+            if (copyDist > outPos) {
+               return Fail();
+            }
+
+            state = InflateState::COPY;
+            break;
+         }
+         case InflateState::COPY: {
+            while (copyLength) {
+               if (outPos == capacity && !TryMakeRoom()) {
+                  return InflateResult::OUTPUT_FULL;
+               }
+
+               size_t room = capacity - outPos;
+               uint32_t count = copyLength < room ? copyLength : (uint32_t) room;
+
+               uint8_t* out = window + outPos;
+               const uint8_t* from = out - copyDist;
+               for (uint32_t i = 0; i < count; i++) {
+                  out[i] = from[i];
+               }
+               outPos += count;
+               copyLength -= count;
+            }
+
+            state = InflateState::CODES;
+            break;
+         }
+         case InflateState::CHECKSUM: {
+            reader.AlignToByte();
+            if (!reader.TryNeed(32)) {
+               return InflateResult::NEED_INPUT;
+            }
+
+            uint32_t value = reader.Peek(32);
+            reader.Consume(32);
+
+            //Big-endian in the stream, the reader is little-endian
+            uint32_t expected = (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+
+            UpdateChecksum();
+            if (isVerifying && adler != expected) {
+               isChecksumFailed = true;
+               return Fail();
+            }
+
+            state = InflateState::DONE;
+            break;
+         }
+         case InflateState::DONE:
+            return InflateResult::DONE;
+         case InflateState::FAILED:
+            return InflateResult::FAILED;
+      }
+   }
+}
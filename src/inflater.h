@@ -0,0 +1,183 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define INFLATE_WINDOW_SIZE 32768
+#define INFLATE_COPY_OVERRUN 32//Wide match copies may write this many bytes past the match
+#define INFLATE_BLOCK_TYPE_COUNT 3//Stored, fixed and dynamic
+
+#define HUFFMAN_MAX_BITS 15
+#define HUFFMAN_ENOUGH 852//Max table size for 288 symbols with 9 root bits, also covers 30 symbols with 6 root bits
+
+#define LIT_LEN_ROOT_BITS 9
+#define DIST_ROOT_BITS 6
+#define CODE_LENGTH_ROOT_BITS 7
+
+//Little-endian 64 bit accumulator, refilled on demand so the decoder never touches the stream bit by bit.
+//Bits stay in the accumulator between inputs, so decoding can stop at any point and resume with the next input
+struct BitReader {
+   const uint8_t* data = nullptr;
+   size_t length = 0;
+   size_t index = 0;//Next byte to load into the buffer
+   uint64_t bitBuffer = 0;
+   uint32_t bitCount = 0;
+
+   void SetInput(const uint8_t* data, size_t length);
+
+   //Tops the buffer up to at least 56 bits while input lasts, it never holds more than 63 so the fast path can shift by bitCount.
+   //Defined here so every decoder loop inlines it
+   void Refill() {
+      if (length - index >= 8) {
+         uint64_t word;
+         memcpy(&word, data + index, 8);
+         bitBuffer |= word << bitCount;
+         index += (63 - bitCount) >> 3;
+         bitCount |= 56;
+      } else {
+         while (bitCount < 56 && index < length) {
+            bitBuffer |= (uint64_t) data[index++] << bitCount;
+            bitCount += 8;
+         }
+      }
+   }
+
+   bool TryNeed(uint32_t count) {
+      if (bitCount < count) {
+         Refill();
+      }
+
+      return bitCount >= count;
+   }
+
+   uint32_t Peek(uint32_t count) const {
+      return (uint32_t) (bitBuffer & ((1ull << count) - 1));
+   }
+
+   void Consume(uint32_t count) {
+      bitBuffer >>= count;
+      bitCount -= count;
+   }
+
+   void AlignToByte() {
+      Consume(bitCount & 7);
+   }
+
+   //Moves up to count whole bytes to out, the reader must be byte aligned. Returns the count of moved bytes
+   size_t TakeBytes(uint8_t* out, size_t count);
+};
+
+enum class HuffmanOp : uint8_t {
+   SYMBOL = 0,
+   LINK = 1,
+   INVALID = 2
+};
+
+struct HuffmanEntry {
+   uint16_t value;//Symbol, or subtable offset for links
+   uint8_t bits;//Bits to consume, or subtable index bits for links
+   HuffmanOp op;
+};
+
+//Canonical Huffman code as a primary table indexed by the next rootBits of the stream,
+//longer codes continue in subtables, so every symbol costs one or two lookups
+struct HuffmanTable {
+   HuffmanEntry entries[HUFFMAN_ENOUGH];
+   uint32_t rootBits = 0;
+   bool isFilled = false;
+
+   bool TryBuild(const uint8_t* lengths, uint32_t symCount, uint32_t maxRootBits);
+};
+
+enum class InflateResult {
+   NEED_INPUT = 0,
+   OUTPUT_FULL,
+   DONE,
+   FAILED
+};
+
+enum class InflateState {
+   ZLIB_HEADER = 0,
+   BLOCK_HEADER,
+   STORED_LENGTH,
+   STORED_COPY,
+   TABLE_COUNTS,
+   CODE_LENGTH_LENGTHS,
+   CODE_LENGTHS,
+   CODE_LENGTH_REPEAT,
+   CODES,
+   LENGTH_EXTRA,
+   DIST,
+   DIST_EXTRA,
+   COPY,
+   CHECKSUM,
+   DONE,
+   FAILED
+};
+
+//Resumable zlib stream decoder. Input is fed in arbitrary parts, output goes to a sliding window
+//that keeps the last 32 KB of history plus everything the consumer has not taken yet
+struct Inflater {
+   BitReader reader;
+   InflateState state = InflateState::ZLIB_HEADER;
+   bool isLastBlock = false;
+   uint32_t blockCounts[INFLATE_BLOCK_TYPE_COUNT] = {};//Blocks started so far by type
+
+   bool isVerifying = true;//Checks the Adler-32 trailer, otherwise the trailer is skipped
+   bool isChecksumFailed = false;
+   uint32_t adler = 1;
+   size_t checkedPos = 0;//Output before this is in adler
+
+   uint8_t* window = nullptr;//capacity bytes of output and INFLATE_COPY_OVERRUN spare bytes, owned by the caller
+   size_t capacity = 0;
+   size_t outPos = 0;
+   size_t readPos = 0;
+
+   //Current block
+   const HuffmanTable* litLenCodes = nullptr;
+   const HuffmanTable* distCodes = nullptr;
+   HuffmanTable dynamicLitLen;
+   HuffmanTable dynamicDist;
+   HuffmanTable codeLengthCodes;
+
+   uint32_t hlit = 0;
+   uint32_t hdist = 0;
+   uint32_t hclen = 0;
+   uint32_t lengthIndex = 0;
+   uint8_t lengths[286 + 30];
+   uint32_t repeatSym = 0;
+
+   uint32_t storedLeft = 0;
+   uint32_t copyLength = 0;
+   uint32_t copyDist = 0;
+   uint32_t extraBits = 0;
+
+   //Capacity should leave room for the 32 KB history plus at least one unit the consumer waits for.
+   //The window needs capacity + INFLATE_COPY_OVERRUN bytes
+   void Reset(uint8_t* window, size_t capacity);
+   void SetInput(const uint8_t* data, size_t length);
+   InflateResult Inflate();
+
+   const uint8_t* GetPending() const {
+      return window + readPos;
+   }
+
+   size_t GetPendingSize() const {
+      return outPos - readPos;
+   }
+
+   void ConsumeOutput(size_t count) {
+      readPos += count;
+   }
+
+private:
+
+   InflateResult InflateBlocks();
+   void UpdateChecksum();
+   bool TryMakeRoom();
+   bool TryInflateFast();
+   int TryDecodeSym(const HuffmanTable& table);
+   void StartDist(uint32_t sym);
+   void NextBlock();
+   InflateResult Fail();
+};
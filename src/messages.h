@@ -10,3 +10,6 @@
 #define WM_SETTINGS_UPDATE WM_USER + 9
 #define WM_RECORD_DONE WM_USER + 10
 #define WM_STATUS_UPDATE WM_USER + 11
+#define WM_ASSET_LOADED WM_USER + 12
+#define WM_EXPAND_LIST WM_USER + 13
+#define WM_SAVE_FAILED WM_USER + 14
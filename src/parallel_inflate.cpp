@@ -0,0 +1,624 @@
+#include "parallel_inflate.h"
+#include "checksum.h"
+#include "deflate_format.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#define HISTORY_MARKER 256//Marker symbols stand for byte (symbol - HISTORY_MARKER) of the window before a segment
+#define NO_STOP UINT64_MAX
+#define MAX_SEARCH_BITS (128 * 1024 * 8)//zlib ends a block every 16K symbols, a part without a header this long has none to find
+
+//Output with known history, written straight to its place in the result
+struct ByteOutput {
+   uint8_t* data;
+   size_t pos;
+   size_t capacity;
+
+   uint8_t* At(size_t index) {
+      return data + index;
+   }
+
+   bool TryReserve(size_t count) {
+      return count <= capacity - pos;
+   }
+};
+
+//Output of a segment whose history is unknown, it starts with a marker for every byte of the window
+struct MarkerOutput {
+   std::vector<uint16_t> data;
+   size_t pos = 0;
+   size_t limit = 0;//No segment inflates to more than the whole stream
+
+   uint16_t* At(size_t index) {
+      return data.data() + index;
+   }
+
+   bool TryReserve(size_t count) {
+      if (count <= data.size() - pos) {
+         return true;
+      }
+
+      if (count > limit - pos) {
+         return false;
+      }
+
+      size_t size = data.size() * 2 > pos + count ? data.size() * 2 : pos + count;
+      data.resize(size < limit ? size : limit);
+      return true;
+   }
+
+   void Reset(size_t outSize, size_t expectedSize) {
+      limit = INFLATE_WINDOW_SIZE + outSize;
+      pos = INFLATE_WINDOW_SIZE;
+
+      size_t size = INFLATE_WINDOW_SIZE + expectedSize;
+      data.resize(size < limit ? size : limit);
+      for (uint32_t i = 0; i < INFLATE_WINDOW_SIZE; i++) {
+         data[i] = (uint16_t) (HISTORY_MARKER + i);
+      }
+   }
+};
+
+//Blocks inflated by one call, ending on a block boundary
+struct BlockRun {
+   uint64_t endBit = 0;
+   bool isFinal = false;
+   uint32_t blockCounts[INFLATE_BLOCK_TYPE_COUNT] = {};
+};
+
+struct Segment {
+   uint64_t searchBit;//The segment starts at the first block header from here
+   uint64_t stopBit;//Inflating stops at the first block boundary from here, where the next segment searches
+   uint64_t startBit = 0;
+   bool isValid = false;
+   MarkerOutput output;
+   BlockRun run;
+};
+
+//Kraft sums in 1/128ths of four 3 bit code length code lengths, and how many of them are not zero
+struct KraftTable {
+   uint16_t sums[4096];
+   uint8_t counts[4096];
+};
+
+static constexpr KraftTable MakeKraftTable() {
+   KraftTable table{};
+   for (uint32_t bits = 0; bits < 4096; bits++) {
+      for (uint32_t i = 0; i < 4; i++) {
+         uint32_t len = (bits >> (i * 3)) & 7;
+         if (len) {
+            table.sums[bits] += (uint16_t) (128 >> len);
+            table.counts[bits]++;
+         }
+      }
+   }
+   return table;
+}
+
+static constexpr KraftTable kraftTable = MakeKraftTable();
+
+struct DynamicCodes {
+   HuffmanTable litLen;
+   HuffmanTable dist;
+};
+
+static void SeekBit(BitReader& reader, const uint8_t* data, size_t length, uint64_t bit);
+static uint64_t GetBitPos(const BitReader& reader);
+static bool TryRefill(BitReader& reader);
+static bool TryReadDynamicCodes(BitReader& reader, DynamicCodes& codes);
+static bool TryFindBlockStart(const uint8_t* data, size_t length, uint64_t from, uint64_t to, uint64_t* found);
+static void InflateSegment(const uint8_t* data, size_t length, size_t outSize, Segment& segment);
+static bool TryResolveMarkers(const MarkerOutput& output, size_t from, size_t to, uint8_t* out, size_t outPos);
+static void AddBlockCounts(uint32_t* total, const BlockRun& run);
+static void RunParallel(uint32_t threadCount, size_t taskCount, const std::function<void(size_t)>& task);
+
+template <typename Output>
+static bool TryInflateBlocks(const uint8_t* data, size_t length, uint64_t startBit, uint64_t stopBit, Output& out, BlockRun& run);
+
+bool TryInflateParallel(const uint8_t* data, size_t length, uint8_t* out, size_t outSize, uint32_t threadCount, bool isVerifying, ParallelInflateStats* stats) {
+   if (length < 6) {//Header and trailer
+      return false;
+   }
+
+   uint32_t cmf = data[0];
+   uint32_t flg = data[1];
+   if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flg) % 31 || (flg & 32)) {
+      return false;
+   }
+
+   //Segment boundaries in bits, the first segment starts after the zlib header
+   uint64_t totalBits = (uint64_t) length * 8;
+   size_t segmentCount = threadCount > 1 ? length / PARALLEL_INFLATE_MIN_SEGMENT : 1;
+   if (segmentCount > (size_t) threadCount * 2) {//Two per thread evens out segments that inflate slower
+      segmentCount = (size_t) threadCount * 2;
+   }
+   if (!segmentCount) {
+      segmentCount = 1;
+   }
+
+   std::vector<Segment> segments(segmentCount);
+   for (size_t i = 0; i < segmentCount; i++) {
+      segments[i].searchBit = i ? totalBits * i / segmentCount : 16;
+      segments[i].stopBit = i + 1 < segmentCount ? totalBits * (i + 1) / segmentCount : NO_STOP;
+   }
+
+   ByteOutput output{out, 0, outSize};
+   std::atomic<bool> isFirstFailed{false};
+
+   RunParallel(threadCount, segmentCount, [&](size_t index) {
+      if (index) {
+         InflateSegment(data, length, outSize, segments[index]);
+      } else if (!TryInflateBlocks(data, length, 16, segments[0].stopBit, output, segments[0].run)) {
+         isFirstFailed = true;
+      }
+   });
+
+   if (isFirstFailed) {
+      return false;
+   }
+
+   ParallelInflateStats inflateStats;
+   inflateStats.segmentCount = (uint32_t) segmentCount;
+   AddBlockCounts(inflateStats.blockCounts, segments[0].run);
+
+   //Links segments in stream order. Only the last 32 KB of a linked segment are resolved here, that is all the next one
+   //needs, the rest is resolved in parallel below
+   struct Link {
+      size_t index;
+      size_t outPos;
+      size_t tailStart;
+   };
+
+   std::vector<Link> links;
+   uint64_t bitPos = segments[0].run.endBit;
+   bool isFinal = segments[0].run.isFinal;
+
+   while (!isFinal) {
+      size_t index = segmentCount - 1;
+      while (segments[index].searchBit > bitPos) {
+         index--;
+      }
+
+      Segment& segment = segments[index];
+      if (segment.isValid && segment.startBit == bitPos) {
+         size_t size = segment.output.pos - INFLATE_WINDOW_SIZE;
+         if (size > outSize - output.pos) {
+            return false;
+         }
+
+         size_t tailStart = size > INFLATE_WINDOW_SIZE ? size - INFLATE_WINDOW_SIZE : 0;
+         if (!TryResolveMarkers(segment.output, tailStart, size, out, output.pos)) {
+            return false;
+         }
+
+         links.push_back({index, output.pos, tailStart});
+         output.pos += size;
+         bitPos = segment.run.endBit;
+         isFinal = segment.run.isFinal;
+         AddBlockCounts(inflateStats.blockCounts, segment.run);
+         inflateStats.linkedCount++;
+         continue;
+      }
+
+      //Serially up to the block this segment starts with when it lies ahead, it may still link, or to the next segment
+      uint64_t stopBit = segment.isValid && segment.startBit > bitPos ? segment.startBit : segment.stopBit;
+      BlockRun run;
+      if (!TryInflateBlocks(data, length, bitPos, stopBit, output, run)) {
+         return false;
+      }
+
+      bitPos = run.endBit;
+      isFinal = run.isFinal;
+      AddBlockCounts(inflateStats.blockCounts, run);
+   }
+
+   std::atomic<bool> isResolveFailed{false};
+   RunParallel(threadCount, links.size(), [&](size_t index) {
+      const Link& link = links[index];
+      if (!TryResolveMarkers(segments[link.index].output, 0, link.tailStart, out, link.outPos)) {
+         isResolveFailed = true;
+      }
+   });
+
+   if (stats) {
+      *stats = inflateStats;
+   }
+
+   if (isResolveFailed || output.pos != outSize) {
+      return false;
+   }
+
+   //Trailer starts on the next whole byte
+   size_t trailer = (size_t) ((bitPos + 7) / 8);
+   if (!isVerifying) {
+      return true;
+   }
+
+   if (trailer + 4 > length) {
+      return false;
+   }
+
+   uint32_t expected = (uint32_t) data[trailer] << 24 | (uint32_t) data[trailer + 1] << 16 | (uint32_t) data[trailer + 2] << 8 | data[trailer + 3];
+   return UpdateAdler32(1, out, outSize) == expected;
+}
+
+static void SeekBit(BitReader& reader, const uint8_t* data, size_t length, uint64_t bit) {
+   reader = BitReader();
+   reader.SetInput(data, length + PARALLEL_INFLATE_PADDING);
+   reader.index = (size_t) (bit / 8);
+   reader.Refill();
+   reader.Consume((uint32_t) (bit % 8));
+}
+
+static uint64_t GetBitPos(const BitReader& reader) {
+   return (uint64_t) reader.index * 8 - reader.bitCount;
+}
+
+//Tops the buffer up to 56 bits, more than any decoding step takes. Fails once the reader is 8 bytes into the padding:
+//the stream has ended by then, and stopping there keeps every load inside the padding
+static bool TryRefill(BitReader& reader) {
+   if (reader.index > reader.length - PARALLEL_INFLATE_PADDING + 8) {
+      return false;
+   }
+
+   reader.Refill();
+   return true;
+}
+
+//Code lengths and tables of a dynamic block, after its 3 header bits
+static bool TryReadDynamicCodes(BitReader& reader, DynamicCodes& codes) {
+   if (!TryRefill(reader)) {
+      return false;
+   }
+
+   uint32_t hlit = reader.Peek(5) + 257;
+   uint32_t hdist = (reader.Peek(10) >> 5) + 1;
+   uint32_t hclen = (reader.Peek(14) >> 10) + 4;
+   reader.Consume(14);
+
+   if (hlit > 286 || hdist > 30) {
+      return false;
+   }
+
+   uint8_t lengths[286 + 30] = {};
+   for (uint32_t i = 0; i < hclen; i++) {
+      if (!TryRefill(reader)) {
+         return false;
+      }
+
+      lengths[indexToCodeLengthSymMap[i]] = (uint8_t) reader.Peek(3);
+      reader.Consume(3);
+   }
+
+   HuffmanTable codeLengthCodes;
+   if (!codeLengthCodes.TryBuild(lengths, 19, CODE_LENGTH_ROOT_BITS)) {
+      return false;
+   }
+
+   memset(lengths, 0, 19);
+   uint32_t totalCount = hlit + hdist;
+
+   for (uint32_t i = 0; i < totalCount;) {
+      if (!TryRefill(reader)) {
+         return false;
+      }
+
+      HuffmanEntry entry = GetEntry(codeLengthCodes, reader);
+      if (entry.op != HuffmanOp::SYMBOL) {
+         return false;
+      }
+      reader.Consume(entry.bits);
+
+      uint32_t sym = entry.value;
+      if (sym <= 15) {
+         lengths[i++] = (uint8_t) sym;
+         continue;
+      }
+
+      if (sym == 16 && !i) {
+         return false;
+      }
+
+      uint32_t bits = sym == 16 ? 2 : (sym == 17 ? 3 : 7);
+      uint32_t copyCount = reader.Peek(bits) + (sym == 18 ? 11 : 3);
+      reader.Consume(bits);
+
+      if (i + copyCount > totalCount) {
+         return false;
+      }
+
+      uint8_t lenToCopy = sym == 16 ? lengths[i - 1] : 0;
+      for (uint32_t j = 0; j < copyCount; j++) {
+         lengths[i + j] = lenToCopy;
+      }
+      i += copyCount;
+   }
+
+   if (!lengths[256]) {//End of block code is required
+      return false;
+   }
+
+   return codes.litLen.TryBuild(lengths, hlit, LIT_LEN_ROOT_BITS) && codes.dist.TryBuild(lengths + hlit, hdist, DIST_ROOT_BITS);
+}
+
+//First bit position in [from, to) that starts a dynamic block with complete codes. Most positions fail on the block
+//type or on the code length code, which is checked from one load before any table is built
+static bool TryFindBlockStart(const uint8_t* data, size_t length, uint64_t from, uint64_t to, uint64_t* found) {
+   uint64_t totalBits = (uint64_t) length * 8;
+   if (to > totalBits) {
+      to = totalBits;
+   }
+
+   DynamicCodes codes;
+
+   for (uint64_t bit = from; bit < to; bit++) {
+      uint64_t header;
+      memcpy(&header, data + bit / 8, 8);
+      header >>= bit % 8;
+
+      uint32_t hlit = (uint32_t) (header >> 3) & 31;
+      uint32_t hdist = (uint32_t) (header >> 8) & 31;
+      if (((header >> 1) & 3) != (uint32_t) CompType::DYNAMIC || hlit > 29 || hdist > 29) {
+         continue;
+      }
+
+      uint64_t codeLengths;
+      memcpy(&codeLengths, data + (bit + 17) / 8, 8);
+      codeLengths >>= (bit + 17) % 8;
+
+      //Kraft sum of the code length code, complete or a single one bit code
+      uint32_t hclen = (uint32_t) ((header >> 13) & 15) + 4;
+      codeLengths &= (1ull << (hclen * 3)) - 1;
+
+      uint32_t kraft = 0;
+      uint32_t codeCount = 0;
+      for (uint32_t i = 0; i < hclen; i += 4) {
+         uint32_t bits = (uint32_t) (codeLengths >> (i * 3)) & 4095;
+         kraft += kraftTable.sums[bits];
+         codeCount += kraftTable.counts[bits];
+      }
+
+      if (kraft != 128 && !(kraft == 64 && codeCount == 1)) {
+         continue;
+      }
+
+      BitReader reader;
+      SeekBit(reader, data, length, bit);
+      reader.Consume(3);
+
+      if (TryReadDynamicCodes(reader, codes) && GetBitPos(reader) <= totalBits) {
+         *found = bit;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+//Tries block starts in the segment until one inflates up to the next segment, a false start usually fails soon
+static void InflateSegment(const uint8_t* data, size_t length, size_t outSize, Segment& segment) {
+   uint64_t from = segment.searchBit;
+   uint64_t searchEnd = segment.stopBit - segment.searchBit > MAX_SEARCH_BITS ? segment.searchBit + MAX_SEARCH_BITS : segment.stopBit;
+
+   while (TryFindBlockStart(data, length, from, searchEnd, &segment.startBit)) {
+      //Image data rarely inflates to less than 4 times its size
+      size_t searchBytes = segment.stopBit == NO_STOP ? length - (size_t) (segment.searchBit / 8) : (size_t) ((segment.stopBit - segment.searchBit) / 8);
+      segment.output.Reset(outSize, searchBytes * 4);
+      segment.run = BlockRun();
+
+      if (TryInflateBlocks(data, length, segment.startBit, segment.stopBit, segment.output, segment.run)) {
+         segment.isValid = true;
+         return;
+      }
+
+      from = segment.startBit + 1;
+   }
+}
+
+//Markers thin out quickly after the start of a segment, so runs without any narrow in a loop the compiler vectorizes
+static bool TryResolveMarkers(const MarkerOutput& output, size_t from, size_t to, uint8_t* out, size_t outPos) {
+   const uint16_t* symbols = output.data.data() + INFLATE_WINDOW_SIZE;
+   const size_t runLength = 64;
+
+   for (size_t i = from; i < to;) {
+      size_t runEnd = to - i < runLength ? to : i + runLength;
+
+      uint16_t bits = 0;
+      for (size_t j = i; j < runEnd; j++) {
+         bits |= symbols[j];
+      }
+
+      if (bits < HISTORY_MARKER) {
+         for (size_t j = i; j < runEnd; j++) {
+            out[outPos + j] = (uint8_t) symbols[j];
+         }
+         i = runEnd;
+         continue;
+      }
+
+      for (; i < runEnd; i++) {
+         uint32_t sym = symbols[i];
+         if (sym < HISTORY_MARKER) {
+            out[outPos + i] = (uint8_t) sym;
+            continue;
+         }
+
+         //A reference before the start of the stream
+         size_t windowIndex = sym - HISTORY_MARKER;
+         if (outPos + windowIndex < INFLATE_WINDOW_SIZE) {
+            return false;
+         }
+
+         out[outPos + i] = out[outPos + windowIndex - INFLATE_WINDOW_SIZE];
+      }
+   }
+
+   return true;
+}
+
+static void AddBlockCounts(uint32_t* total, const BlockRun& run) {
+   for (uint32_t i = 0; i < INFLATE_BLOCK_TYPE_COUNT; i++) {
+      total[i] += run.blockCounts[i];
+   }
+}
+
+//Tasks are taken in order by this thread and up to threadCount - 1 others
+static void RunParallel(uint32_t threadCount, size_t taskCount, const std::function<void(size_t)>& task) {
+   std::atomic<size_t> next{0};
+   auto work = [&]() {
+      for (size_t index = next++; index < taskCount; index = next++) {
+         task(index);
+      }
+   };
+
+   std::vector<std::thread> threads;
+   for (uint32_t i = 1; i < threadCount && i < taskCount; i++) {
+      threads.emplace_back(work);
+   }
+
+   work();
+
+   for (std::thread& thread : threads) {
+      thread.join();
+   }
+}
+
+//Marker symbols copy like any other, wide copies are not worth it on 16 bit output
+static inline void CopyMatch(uint16_t* out, uint32_t dist, uint32_t length) {
+   if (dist >= length) {
+      memcpy(out, out - dist, length * sizeof(uint16_t));
+      return;
+   }
+
+   for (uint32_t i = 0; i < length; i++) {
+      out[i] = out[i - (size_t) dist];
+   }
+}
+
+template <typename Output>
+static bool TryCopyStored(const uint8_t* data, size_t length, BitReader& reader, Output& out) {
+   size_t start = (size_t) ((GetBitPos(reader) + 7) / 8);
+   if (start + 4 > length) {
+      return false;
+   }
+
+   uint32_t len = data[start] | (uint32_t) data[start + 1] << 8;
+   uint32_t nlen = data[start + 2] | (uint32_t) data[start + 3] << 8;
+   if ((len ^ 0xFFFF) != nlen || start + 4 + len > length || !out.TryReserve(len)) {
+      return false;
+   }
+
+   auto* to = out.At(out.pos);
+   for (uint32_t i = 0; i < len; i++) {
+      to[i] = data[start + 4 + i];
+   }
+   out.pos += len;
+
+   SeekBit(reader, data, length, (uint64_t) (start + 4 + len) * 8);
+   return true;
+}
+
+//Literals and matches until the end of block code, with whole symbols checked against the output room
+template <typename Output>
+static bool TryInflateCodes(BitReader& reader, const HuffmanTable& litLenCodes, const HuffmanTable& distCodes, Output& out) {
+   while (true) {
+      //56 bits cover the longest code sequence: 15 + 5 length bits and 15 + 13 distance bits
+      if (!TryRefill(reader)) {
+         return false;
+      }
+
+      HuffmanEntry entry = GetEntry(litLenCodes, reader);
+      if (entry.op != HuffmanOp::SYMBOL) {
+         return false;
+      }
+      reader.Consume(entry.bits);
+
+      uint32_t sym = entry.value;
+      if (sym <= 255) {
+         if (!out.TryReserve(1)) {
+            return false;
+         }
+
+         *out.At(out.pos++) = (uint8_t) sym;
+         continue;
+      } else if (sym == 256) {
+         return true;
+      } else if (sym > 285) {
+         return false;
+      }
+
+      sym -= 257;
+      uint32_t length = lengthTable[sym] + reader.Peek(lengthExtraBitTable[sym]);
+      reader.Consume(lengthExtraBitTable[sym]);
+
+      entry = GetEntry(distCodes, reader);
+      if (entry.op != HuffmanOp::SYMBOL || entry.value > 29) {
+         return false;
+      }
+      reader.Consume(entry.bits);
+
+      sym = entry.value;
+      uint32_t dist = distTable[sym] + reader.Peek(distExtraBitTable[sym]);
+      reader.Consume(distExtraBitTable[sym]);
+
+      if (dist > out.pos || !out.TryReserve(length)) {
+         return false;
+      }
+
+      CopyMatch(out.At(out.pos), dist, length);
+      out.pos += length;
+   }
+}
+
+//Whole blocks from startBit until one ends at or after stopBit, or the final one ends
+template <typename Output>
+static bool TryInflateBlocks(const uint8_t* data, size_t length, uint64_t startBit, uint64_t stopBit, Output& out, BlockRun& run) {
+   uint64_t totalBits = (uint64_t) length * 8;
+   BitReader reader;
+   SeekBit(reader, data, length, startBit);
+   DynamicCodes codes;
+
+   while (true) {
+      uint64_t bitPos = GetBitPos(reader);
+      if (bitPos > totalBits) {
+         return false;
+      }
+
+      if (bitPos >= stopBit) {
+         run.endBit = bitPos;
+         return true;
+      }
+
+      if (!TryRefill(reader)) {
+         return false;
+      }
+
+      run.isFinal = reader.Peek(1);
+      CompType compressionType = (CompType) (reader.Peek(3) >> 1);
+      reader.Consume(3);
+
+      bool isInflated;
+      if (compressionType == CompType::NONE) {
+         isInflated = TryCopyStored(data, length, reader, out);
+      } else if (compressionType == CompType::FIXED) {
+         isInflated = TryInflateCodes(reader, fixedLitLen, fixedDist, out);
+      } else if (compressionType == CompType::DYNAMIC) {
+         isInflated = TryReadDynamicCodes(reader, codes) && TryInflateCodes(reader, codes.litLen, codes.dist, out);
+      } else {
+         isInflated = false;
+      }
+
+      if (!isInflated) {
+         return false;
+      }
+
+      run.blockCounts[(uint32_t) compressionType]++;
+
+      if (run.isFinal) {
+         run.endBit = GetBitPos(reader);
+         return run.endBit <= totalBits;
+      }
+   }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "inflater.h"
+#include <cstddef>
+#include <cstdint>
+
+#define PARALLEL_INFLATE_PADDING 16//Zero bytes the input needs past its end, so decoding steps never check the length
+#define PARALLEL_INFLATE_MIN_SEGMENT (256 * 1024)//Compressed bytes, shorter segments spend too much on finding their start
+
+struct ParallelInflateStats {
+   uint32_t segmentCount = 0;//Parts the stream was cut into, 1 when it was too short to split
+   uint32_t linkedCount = 0;//Parts after the first that were inflated in parallel and used, the rest was inflated serially
+   uint32_t blockCounts[INFLATE_BLOCK_TYPE_COUNT] = {};//Stored, fixed and dynamic deflate blocks of the stream
+};
+
+//Inflates a whole zlib stream held in memory on up to threadCount threads.
+//The stream is cut into segments of compressed bytes. The first one is inflated as usual, every other one starts at
+//the first dynamic block header found in its first 128 KB and inflates with markers in place of the 32 KB of history before it.
+//A segment is linked when the output before it ends exactly on the block it started with, its markers are then
+//replaced by the bytes they stand for. Wherever no segment links, a false header or a part without dynamic blocks,
+//inflating continues serially from there, so a stream without split points is inflated whole on this thread.
+//data needs PARALLEL_INFLATE_PADDING zero bytes past length, out needs outSize + INFLATE_COPY_OVERRUN bytes.
+//Succeeds only for a valid stream of exactly outSize bytes, the Adler-32 trailer is checked when isVerifying is set
+bool TryInflateParallel(const uint8_t* data, size_t length, uint8_t* out, size_t outSize, uint32_t threadCount, bool isVerifying, ParallelInflateStats* stats = nullptr);
@@ -0,0 +1,462 @@
+#include "pixel_convert.h"
+#include <cstring>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+//Exact round(c * a / 255) for 8 bit values
+static inline uint32_t MulDiv255(uint32_t c, uint32_t a) {
+   uint32_t t = c * a + 128;
+   return (t + (t >> 8)) >> 8;
+}
+
+template<AlphaMode MODE>
+static void ConvertRGBScalar(uint32_t* dst, const uint8_t* src, size_t width, uint32_t /*keyPixel*/) {
+   const uint32_t alpha = MODE == AlphaMode::PREMULTIPLIED ? 0xFF000000 : 0;
+
+   for (size_t i = 0; i < width; i++) {
+      const uint8_t* pixel = src + i * 3;
+      dst[i] = (uint32_t) pixel[2] | ((uint32_t) pixel[1] << 8) | ((uint32_t) pixel[0] << 16) | alpha;
+   }
+}
+
+static void ConvertRGBAColorKeyScalar(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel) {
+   for (size_t i = 0; i < width; i++) {
+      const uint8_t* pixel = src + i * 4;
+      if (pixel[3] < 128) {
+         dst[i] = keyPixel;
+      } else {
+         dst[i] = (uint32_t) pixel[2] | ((uint32_t) pixel[1] << 8) | ((uint32_t) pixel[0] << 16);
+      }
+   }
+}
+
+static void ConvertRGBAPremultipliedScalar(uint32_t* dst, const uint8_t* src, size_t width, uint32_t /*keyPixel*/) {
+   for (size_t i = 0; i < width; i++) {
+      const uint8_t* pixel = src + i * 4;
+      uint32_t alpha = pixel[3];
+      dst[i] = MulDiv255(pixel[2], alpha) | (MulDiv255(pixel[1], alpha) << 8) | (MulDiv255(pixel[0], alpha) << 16) | (alpha << 24);
+   }
+}
+
+static void ConvertGrayAlphaColorKeyScalar(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel) {
+   for (size_t i = 0; i < width; i++) {
+      const uint8_t* pixel = src + i * 2;
+      dst[i] = pixel[1] < 128 ? keyPixel : pixel[0] * 0x010101u;
+   }
+}
+
+static void ConvertGrayAlphaPremultipliedScalar(uint32_t* dst, const uint8_t* src, size_t width, uint32_t /*keyPixel*/) {
+   for (size_t i = 0; i < width; i++) {
+      const uint8_t* pixel = src + i * 2;
+      uint32_t alpha = pixel[1];
+      dst[i] = MulDiv255(pixel[0], alpha) * 0x010101u | (alpha << 24);
+   }
+}
+
+#if CPU_X86
+
+static inline int Load32(const uint8_t* p) {
+   int value;
+   memcpy(&value, p, 4);
+   return value;
+}
+
+//RGBA to BGRA in every 32 bit lane, SSE2 has no byte shuffle
+static inline __m128i SwapRedBlue(__m128i x) {
+   const __m128i lowByte = _mm_set1_epi32(0xFF);
+   __m128i kept = _mm_and_si128(x, _mm_set1_epi32((int) 0xFF00FF00));
+   __m128i blue = _mm_and_si128(_mm_srli_epi32(x, 16), lowByte);
+   __m128i red = _mm_slli_epi32(_mm_and_si128(x, lowByte), 16);
+   return _mm_or_si128(kept, _mm_or_si128(blue, red));
+}
+
+//Pixels gathered with 4 byte loads, so 16 bytes of source must be readable from the first one
+template<AlphaMode MODE>
+static void ConvertRGBSse2(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel) {
+   const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+   const __m128i alpha = _mm_set1_epi32(MODE == AlphaMode::PREMULTIPLIED ? (int) 0xFF000000 : 0);
+
+   size_t i = 0;
+   for (; i + 6 <= width; i += 4) {
+      const uint8_t* p = src + i * 3;
+      __m128i x = _mm_setr_epi32(Load32(p), Load32(p + 3), Load32(p + 6), Load32(p + 9));
+      x = _mm_or_si128(_mm_and_si128(SwapRedBlue(x), colorMask), alpha);
+      _mm_storeu_si128((__m128i*) (dst + i), x);
+   }
+
+   ConvertRGBScalar<MODE>(dst + i, src + i * 3, width - i, keyPixel);
+}
+
+static void ConvertRGBAColorKeySse2(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel) {
+   const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+   const __m128i threshold = _mm_set1_epi32(128);
+   const __m128i key = _mm_set1_epi32((int) keyPixel);
+
+   size_t i = 0;
+   for (; i + 4 <= width; i += 4) {
+      __m128i x = _mm_loadu_si128((const __m128i*) (src + i * 4));
+      __m128i color = _mm_and_si128(SwapRedBlue(x), colorMask);
+      __m128i isKey = _mm_cmplt_epi32(_mm_srli_epi32(x, 24), threshold);
+      _mm_storeu_si128((__m128i*) (dst + i), _mm_or_si128(_mm_and_si128(isKey, key), _mm_andnot_si128(isKey, color)));
+   }
+
+   ConvertRGBAColorKeyScalar(dst + i, src + i * 4, width - i, keyPixel);
+}
+
+//Same rounding as MulDiv255 in 16 bit lanes
+static inline __m128i MulDiv255Epi16(__m128i c, __m128i a) {
+   __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), _mm_set1_epi16(128));
+   return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void ConvertRGBAPremultipliedSse2(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel) {
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+
+   size_t i = 0;
+   for (; i + 4 <= width; i += 4) {
+      __m128i x = SwapRedBlue(_mm_loadu_si128((const __m128i*) (src + i * 4)));
+
+      __m128i low = _mm_unpacklo_epi8(x, zero);
+      __m128i high = _mm_unpackhi_epi8(x, zero);
+      __m128i lowAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+      __m128i highAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+      __m128i result = _mm_packus_epi16(MulDiv255Epi16(low, lowAlpha), MulDiv255Epi16(high, highAlpha));
+      result = _mm_or_si128(_mm_and_si128(result, colorMask), _mm_andnot_si128(colorMask, x));
+      _mm_storeu_si128((__m128i*) (dst + i), result);
+   }
+
+   ConvertRGBAPremultipliedScalar(dst + i, src + i * 4, width - i, keyPixel);
+}
+
+//Byte shuffles of AVX2 make the 3 byte case a load and a shuffle per 4 pixels.
+//The second load reads 16 bytes from the 5th pixel, so 28 bytes of source must be readable
+template<AlphaMode MODE>
+TARGET_AVX2 static void ConvertRGBAvx2(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel) {
+   const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+   const __m256i alpha = _mm256_set1_epi32(MODE == AlphaMode::PREMULTIPLIED ? (int) 0xFF000000 : 0);
+
+   size_t i = 0;
+   for (; i + 10 <= width; i += 8) {
+      const uint8_t* p = src + i * 3;
+      __m128i low = _mm_loadu_si128((const __m128i*) p);
+      __m128i high = _mm_loadu_si128((const __m128i*) (p + 12));
+      __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+      x = _mm256_or_si256(_mm256_shuffle_epi8(x, shuffle), alpha);
+      _mm256_storeu_si256((__m256i*) (dst + i), x);
+   }
+
+   ConvertRGBSse2<MODE>(dst + i, src + i * 3, width - i, keyPixel);
+}
+
+TARGET_AVX2 static void ConvertRGBAColorKeyAvx2(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel) {
+   const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1, 2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1);
+   const __m256i threshold = _mm256_set1_epi32(128);
+   const __m256i key = _mm256_set1_epi32((int) keyPixel);
+
+   size_t i = 0;
+   for (; i + 8 <= width; i += 8) {
+      __m256i x = _mm256_loadu_si256((const __m256i*) (src + i * 4));
+      __m256i color = _mm256_shuffle_epi8(x, shuffle);
+      __m256i isKey = _mm256_cmpgt_epi32(threshold, _mm256_srli_epi32(x, 24));
+      _mm256_storeu_si256((__m256i*) (dst + i), _mm256_blendv_epi8(color, key, isKey));
+   }
+
+   ConvertRGBAColorKeySse2(dst + i, src + i * 4, width - i, keyPixel);
+}
+
+TARGET_AVX2 static void ConvertRGBAPremultipliedAvx2(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel) {
+   const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+   const __m256i rounding = _mm256_set1_epi16(128);
+
+   size_t i = 0;
+   for (; i + 8 <= width; i += 8) {
+      __m256i x = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*) (src + i * 4)), swap);
+
+      __m256i low = _mm256_unpacklo_epi8(x, zero);
+      __m256i high = _mm256_unpackhi_epi8(x, zero);
+      __m256i lowAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(low, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+      __m256i highAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(high, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+      __m256i lowT = _mm256_add_epi16(_mm256_mullo_epi16(low, lowAlpha), rounding);
+      __m256i highT = _mm256_add_epi16(_mm256_mullo_epi16(high, highAlpha), rounding);
+      lowT = _mm256_srli_epi16(_mm256_add_epi16(lowT, _mm256_srli_epi16(lowT, 8)), 8);
+      highT = _mm256_srli_epi16(_mm256_add_epi16(highT, _mm256_srli_epi16(highT, 8)), 8);
+
+      //Unpack and pack both work within 128 bit lanes, so pixel order is kept
+      __m256i result = _mm256_packus_epi16(lowT, highT);
+      result = _mm256_or_si256(_mm256_and_si256(result, colorMask), _mm256_andnot_si256(colorMask, x));
+      _mm256_storeu_si256((__m256i*) (dst + i), result);
+   }
+
+   ConvertRGBAPremultipliedSse2(dst + i, src + i * 4, width - i, keyPixel);
+}
+
+#endif
+
+ConvertRowFunc GetConvertKernel(uint8_t bbp, AlphaMode mode, SimdLevel level) {
+   bool isPremultiplied = mode == AlphaMode::PREMULTIPLIED;
+
+   if (bbp == 2) {//Scalar only, gray+alpha rows are rare
+      return isPremultiplied ? ConvertGrayAlphaPremultipliedScalar : ConvertGrayAlphaColorKeyScalar;
+   } else if (bbp != 3 && bbp != 4) {
+      return nullptr;
+   }
+
+#if CPU_X86
+   if (level == SimdLevel::AVX2) {
+      if (bbp == 3) {
+         return isPremultiplied ? ConvertRGBAvx2<AlphaMode::PREMULTIPLIED> : ConvertRGBAvx2<AlphaMode::COLOR_KEY>;
+      }
+      return isPremultiplied ? ConvertRGBAPremultipliedAvx2 : ConvertRGBAColorKeyAvx2;
+   } else if (level == SimdLevel::SSE2) {
+      if (bbp == 3) {
+         return isPremultiplied ? ConvertRGBSse2<AlphaMode::PREMULTIPLIED> : ConvertRGBSse2<AlphaMode::COLOR_KEY>;
+      }
+      return isPremultiplied ? ConvertRGBAPremultipliedSse2 : ConvertRGBAColorKeySse2;
+   }
+#endif
+
+   if (bbp == 3) {
+      return isPremultiplied ? ConvertRGBScalar<AlphaMode::PREMULTIPLIED> : ConvertRGBScalar<AlphaMode::COLOR_KEY>;
+   }
+   return isPremultiplied ? ConvertRGBAPremultipliedScalar : ConvertRGBAColorKeyScalar;
+}
+
+ConvertRowFunc GetConvertKernel(uint8_t bbp, AlphaMode mode) {
+   static const SimdLevel level = GetBestSimdLevel();
+   return GetConvertKernel(bbp, mode, level);
+}
+
+//Keeps the high byte of count big endian 16 bit samples
+static void NarrowSamplesScalar(uint8_t* dst, const uint8_t* src, size_t count) {
+   for (size_t i = 0; i < count; i++) {
+      dst[i] = src[i * 2];
+   }
+}
+
+#if CPU_X86
+
+//The high byte comes first, so it is the low byte of every little endian 16 bit lane
+static void NarrowSamplesSse2(uint8_t* dst, const uint8_t* src, size_t count) {
+   const __m128i lowByte = _mm_set1_epi16(0xFF);
+
+   size_t i = 0;
+   for (; i + 16 <= count; i += 16) {
+      __m128i low = _mm_and_si128(_mm_loadu_si128((const __m128i*) (src + i * 2)), lowByte);
+      __m128i high = _mm_and_si128(_mm_loadu_si128((const __m128i*) (src + i * 2 + 16)), lowByte);
+      _mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(low, high));
+   }
+
+   NarrowSamplesScalar(dst + i, src + i * 2, count - i);
+}
+
+#endif
+
+template<size_t CHANNELS, void (*NARROW)(uint8_t*, const uint8_t*, size_t)>
+static void PrepareNarrow(uint8_t* dst, const uint8_t* src, size_t width, const uint16_t* /*transparentColor*/) {
+   NARROW(dst, src, width * CHANNELS);
+}
+
+//Gray or RGB with a tRNS color becomes gray+alpha or RGBA, samples of 2 bytes are narrowed on the way
+template<size_t CHANNELS, size_t SAMPLE_BYTES>
+static void PrepareKeyAlpha(uint8_t* dst, const uint8_t* src, size_t width, const uint16_t* transparentColor) {
+   for (size_t i = 0; i < width; i++) {
+      const uint8_t* pixel = src + i * CHANNELS * SAMPLE_BYTES;
+      uint8_t* out = dst + i * (CHANNELS + 1);
+      bool isTransparent = true;
+
+      for (size_t c = 0; c < CHANNELS; c++) {
+         const uint8_t* sample = pixel + c * SAMPLE_BYTES;
+         uint32_t value = SAMPLE_BYTES == 2 ? (uint32_t) sample[0] << 8 | sample[1] : sample[0];
+         isTransparent &= value == transparentColor[c];
+         out[c] = sample[0];
+      }
+
+      out[CHANNELS] = isTransparent ? 0 : 255;
+   }
+}
+
+//Indices are packed from the high bits down, a byte holds 8 / DEPTH of them
+template<uint32_t DEPTH>
+static void ExpandIndices(uint32_t* dst, const uint8_t* src, size_t width, const uint32_t* table) {
+   const uint32_t perByte = 8 / DEPTH;
+   const uint32_t mask = (1u << DEPTH) - 1;
+
+   size_t i = 0;
+   for (; i + perByte <= width; i += perByte) {
+      uint32_t byte = *src++;
+      for (uint32_t k = 0; k < perByte; k++) {
+         dst[i + k] = table[(byte >> (8 - DEPTH * (k + 1))) & mask];
+      }
+   }
+
+   for (uint32_t k = 0; i < width; i++, k++) {
+      dst[i] = table[(*src >> (8 - DEPTH * (k + 1))) & mask];
+   }
+}
+
+static ExpandRowFunc GetExpandKernel(uint8_t bitDepth) {
+   switch (bitDepth) {
+      case 1:
+         return ExpandIndices<1>;
+      case 2:
+         return ExpandIndices<2>;
+      case 4:
+         return ExpandIndices<4>;
+      case 8:
+         return ExpandIndices<8>;
+   }
+
+   return nullptr;
+}
+
+static PrepareRowFunc GetNarrowKernel(size_t channels, SimdLevel level) {
+#if CPU_X86
+   if (level != SimdLevel::SCALAR) {
+      switch (channels) {
+         case 1:
+            return PrepareNarrow<1, NarrowSamplesSse2>;
+         case 2:
+            return PrepareNarrow<2, NarrowSamplesSse2>;
+         case 3:
+            return PrepareNarrow<3, NarrowSamplesSse2>;
+         case 4:
+            return PrepareNarrow<4, NarrowSamplesSse2>;
+      }
+   }
+#endif
+
+   switch (channels) {
+      case 1:
+         return PrepareNarrow<1, NarrowSamplesScalar>;
+      case 2:
+         return PrepareNarrow<2, NarrowSamplesScalar>;
+      case 3:
+         return PrepareNarrow<3, NarrowSamplesScalar>;
+      case 4:
+         return PrepareNarrow<4, NarrowSamplesScalar>;
+   }
+
+   return nullptr;
+}
+
+//Table entries are finished output pixels, so they already hold the alpha mode and the key color
+static uint32_t MakePixel(uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha, AlphaMode mode, uint32_t keyPixel) {
+   if (mode == AlphaMode::PREMULTIPLIED) {
+      return MulDiv255(blue, alpha) | (MulDiv255(green, alpha) << 8) | (MulDiv255(red, alpha) << 16) | (alpha << 24);
+   }
+
+   return alpha < 128 ? keyPixel : blue | (green << 8) | (red << 16);
+}
+
+static uint16_t ToUInt16(const uint8_t* data) {
+   return (uint16_t) (data[0] << 8 | data[1]);
+}
+
+bool RowConverter::TryInit(const ScanlineFormat& format, uint32_t maxWidth, AlphaMode mode, uint32_t keyPixel, DecodeArena& arena) {
+   static const SimdLevel level = GetBestSimdLevel();
+
+   this->keyPixel = keyPixel;
+   prepare = nullptr;
+   expand = nullptr;
+   convert = nullptr;
+
+   bool isWide = format.bitDepth == 16;
+   uint32_t keySize = format.colorType == PNG_COLOR_GRAY ? 2 : 6;
+   bool isKeyed = (format.colorType == PNG_COLOR_GRAY || format.colorType == PNG_COLOR_RGB) && format.transparencySize >= keySize;
+
+   for (uint32_t c = 0; c < 3; c++) {
+      transparentColor[c] = isKeyed && c * 2 < keySize ? ToUInt16(format.transparency + c * 2) : 0;
+   }
+
+   switch (format.colorType) {
+      case PNG_COLOR_GRAY:
+         if (isWide && isKeyed) {//The key compares full 16 bit samples, so it can't be baked into an 8 bit table
+            prepare = PrepareKeyAlpha<1, 2>;
+            convert = GetConvertKernel(2, mode, level);
+            break;
+         }
+
+         prepare = isWide ? GetNarrowKernel(1, level) : nullptr;
+         expand = GetExpandKernel(isWide ? 8 : format.bitDepth);
+         FillGrayTable(isWide ? 8 : format.bitDepth, isKeyed, mode);
+         break;
+      case PNG_COLOR_RGB:
+         if (isKeyed) {
+            prepare = isWide ? PrepareKeyAlpha<3, 2> : PrepareKeyAlpha<3, 1>;
+            convert = GetConvertKernel(4, mode, level);
+            break;
+         }
+
+         prepare = isWide ? GetNarrowKernel(3, level) : nullptr;
+         convert = GetConvertKernel(3, mode, level);
+         break;
+      case PNG_COLOR_PALETTE:
+         if (!format.paletteCount) {
+            return false;
+         }
+
+         expand = GetExpandKernel(format.bitDepth);
+         FillPaletteTable(format, mode);
+         break;
+      case PNG_COLOR_GRAY_ALPHA:
+         prepare = isWide ? GetNarrowKernel(2, level) : nullptr;
+         convert = GetConvertKernel(2, mode, level);
+         break;
+      case PNG_COLOR_RGBA:
+         prepare = isWide ? GetNarrowKernel(4, level) : nullptr;
+         convert = GetConvertKernel(4, mode, level);
+         break;
+   }
+
+   if (!expand && !convert) {
+      return false;
+   }
+
+   scratch = prepare ? arena.AllocateArray<uint8_t>((size_t) maxWidth * 4) : nullptr;
+   return true;
+}
+
+void RowConverter::Convert(uint32_t* dst, const uint8_t* src, size_t width) {
+   if (prepare) {
+      prepare(scratch, src, width, transparentColor);
+      src = scratch;
+   }
+
+   if (expand) {
+      expand(dst, src, width, table);
+   } else {
+      convert(dst, src, width, keyPixel);
+   }
+}
+
+//Gray levels of low bit depths are scaled up to the full 8 bit range
+void RowConverter::FillGrayTable(uint8_t bitDepth, bool isKeyed, AlphaMode mode) {
+   uint32_t maxValue = (1u << bitDepth) - 1;
+
+   for (uint32_t value = 0; value <= maxValue; value++) {
+      uint32_t gray = value * 255 / maxValue;
+      uint32_t alpha = isKeyed && value == transparentColor[0] ? 0 : 255;
+      table[value] = MakePixel(gray, gray, gray, alpha, mode, keyPixel);
+   }
+}
+
+//tRNS holds alpha for the first palette entries, the rest are opaque. Indices past the palette come out opaque black
+void RowConverter::FillPaletteTable(const ScanlineFormat& format, AlphaMode mode) {
+   for (uint32_t i = 0; i < PALETTE_MAX_ENTRIES; i++) {
+      uint32_t alpha = i < format.transparencySize ? format.transparency[i] : 255;
+
+      if (i < format.paletteCount) {
+         const uint8_t* entry = format.palette + i * 3;
+         table[i] = MakePixel(entry[0], entry[1], entry[2], alpha, mode, keyPixel);
+      } else {
+         table[i] = MakePixel(0, 0, 0, 255, mode, keyPixel);
+      }
+   }
+}
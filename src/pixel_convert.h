@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "cpu_features.h"
+#include "decode_arena.h"
+
+#define PNG_COLOR_GRAY 0
+#define PNG_COLOR_RGB 2
+#define PNG_COLOR_PALETTE 3
+#define PNG_COLOR_GRAY_ALPHA 4
+#define PNG_COLOR_RGBA 6
+
+#define PALETTE_MAX_ENTRIES 256
+
+enum class AlphaMode {
+   COLOR_KEY = 0,//Pixels with alpha below 128 become the key color, for TransparentBlt
+   PREMULTIPLIED//Color scaled by alpha, for AlphaBlend
+};
+
+//Converts one reconstructed 8 bit gray+alpha, RGB or RGBA scanline to 32 bit BGRA pixels.
+//In color key mode the alpha byte is zero, RGB pixels are never keyed
+typedef void (*ConvertRowFunc)(uint32_t* dst, const uint8_t* src, size_t width, uint32_t keyPixel);
+
+//Kernel for the given bytes per pixel, mode and instruction set, nullptr if there is none
+ConvertRowFunc GetConvertKernel(uint8_t bbp, AlphaMode mode, SimdLevel level);
+
+//Best kernel for this CPU, picked once
+ConvertRowFunc GetConvertKernel(uint8_t bbp, AlphaMode mode);
+
+//Cuts 16 bit samples to their high byte, or turns a tRNS color into an alpha channel, so the 8 bit kernels can take the row.
+//transparentColor holds one 16 bit sample per channel
+typedef void (*PrepareRowFunc)(uint8_t* dst, const uint8_t* src, size_t width, const uint16_t* transparentColor);
+
+//Looks up packed 1, 2, 4 or 8 bit indices in a table of finished BGRA pixels, for palette and gray images
+typedef void (*ExpandRowFunc)(uint32_t* dst, const uint8_t* src, size_t width, const uint32_t* table);
+
+//Layout of a reconstructed scanline, with the PLTE and tRNS chunk data it refers to
+struct ScanlineFormat {
+   uint8_t colorType = PNG_COLOR_RGBA;
+   uint8_t bitDepth = 8;
+   const uint8_t* palette = nullptr;//RGB triples
+   uint32_t paletteCount = 0;
+   const uint8_t* transparency = nullptr;//tRNS chunk data
+   uint32_t transparencySize = 0;
+};
+
+//Converts scanlines of every PNG color type and bit depth to BGRA. The kernels for the format are picked
+//and the lookup table is built once per image, so rows run without any per-pixel format switch
+struct RowConverter {
+   //Scratch rows come from the arena, they live as long as its current decode
+   bool TryInit(const ScanlineFormat& format, uint32_t maxWidth, AlphaMode mode, uint32_t keyPixel, DecodeArena& arena);
+
+   void Convert(uint32_t* dst, const uint8_t* src, size_t width);
+
+private:
+
+   PrepareRowFunc prepare = nullptr;//Runs first into scratch when set
+   ExpandRowFunc expand = nullptr;//Either this or convert finishes the row
+   ConvertRowFunc convert = nullptr;
+   uint32_t keyPixel = 0;
+   uint16_t transparentColor[3] = {};
+   uint32_t table[PALETTE_MAX_ENTRIES];
+   uint8_t* scratch = nullptr;
+
+   void FillGrayTable(uint8_t bitDepth, bool isKeyed, AlphaMode mode);
+   void FillPaletteTable(const ScanlineFormat& format, AlphaMode mode);
+};
@@ -0,0 +1,681 @@
+#include "png_decoder.h"
+#include "checksum.h"
+#include <cstring>
+
+static const char PNG[] = {(char) 137, 80, 78, 71, 13, 10, 26, 10};
+static const char IHDR[] = {'I', 'H', 'D', 'R'};
+static const char IDAT[] = {'I', 'D', 'A', 'T'};
+static const char IEND[] = {'I', 'E', 'N', 'D'};
+static const char PLTE[] = {'P', 'L', 'T', 'E'};
+static const char TRNS[] = {'t', 'R', 'N', 'S'};
+
+//First column, first row, column step and row step of each pass
+static const uint8_t ADAM7[ADAM7_PASS_COUNT][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+
+bool NotSameBuffer(const char* first, const char* second, size_t count, size_t firstOffset = 0, size_t secondOffset = 0);
+
+uint32_t ToUInt32(const char* buffer, size_t offset = 0);
+
+PNGHeader TryReadHeader(const char* data);
+
+uint8_t GetChannelCount(uint8_t colorType);
+
+PNGStreamDecoder::PNGStreamDecoder() : ownArena(new DecodeArena()), arena(ownArena.get()) {
+}
+
+PNGStreamDecoder::PNGStreamDecoder(DecodeArena& arena) : arena(&arena) {
+}
+
+PNGStreamDecoder::~PNGStreamDecoder() {
+   isKeeping = false;//Nobody waits for the image any more
+   Finish();
+}
+
+size_t PNGStreamDecoder::Feed(const uint8_t* data, size_t length) {
+   if (!stats) {
+      size_t offset = FeedChunks(data, length);
+      bytesFed += offset;
+      return offset;
+   }
+
+   //Whatever the timed stages inside did not take is chunk handling
+   double stageSeconds = stats->inflateSeconds + rowSeconds;
+   auto start = std::chrono::steady_clock::now();
+
+   size_t offset = FeedChunks(data, length);
+
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   stats->chunkSeconds += seconds - (stats->inflateSeconds + rowSeconds - stageSeconds);
+   bytesFed += offset;
+   return offset;
+}
+
+size_t PNGStreamDecoder::FeedChunks(const uint8_t* data, size_t length) {
+   size_t offset = 0;
+
+   while (offset < length) {
+      switch (state) {
+         case PNGDecodeState::SIGNATURE: {
+            if (!TryGather(data, length, &offset, 8)) {
+               return offset;
+            }
+
+            if (NotSameBuffer((const char*) staging, PNG, 8)) {
+               state = PNGDecodeState::FAILED;
+               return offset;
+            }
+
+            state = PNGDecodeState::CHUNK_HEADER;
+            break;
+         }
+         case PNGDecodeState::CHUNK_HEADER: {
+            if (HasHeader() && !pixels) {
+               return offset;
+            }
+
+            if (!TryGather(data, length, &offset, 8)) {//4 bytes length, 4 bytes type
+               return offset;
+            }
+
+            if (!TryStartChunk()) {
+               state = PNGDecodeState::FAILED;
+               return offset;
+            }
+            break;
+         }
+         case PNGDecodeState::CHUNK_DATA: {
+            size_t count = length - offset < chunkLeft ? length - offset : chunkLeft;
+
+            if (isVerifying) {
+               crc = UpdateCrc32(crc, data + offset, count);
+            }
+
+            if (chunkTarget) {
+               memcpy(chunkTarget, data + offset, count);
+               chunkTarget += count;
+            } else if (isDataChunk && !(isKeeping ? TryKeepData(data + offset, count) : TryInflate(data + offset, count))) {
+               state = PNGDecodeState::FAILED;
+               return offset;
+            }
+
+            offset += count;
+            chunkLeft -= (uint32_t) count;
+
+            if (!chunkLeft) {
+               if (isHeaderChunk && !TryStartImage()) {
+                  state = PNGDecodeState::FAILED;
+                  return offset;
+               }
+
+               state = PNGDecodeState::CHUNK_CRC;
+            }
+            break;
+         }
+         case PNGDecodeState::CHUNK_CRC: {
+            if (!TryGather(data, length, &offset, 4)) {
+               return offset;
+            }
+
+            if (isVerifying && ToUInt32((const char*) staging) != crc) {
+               state = PNGDecodeState::FAILED;
+               return offset;
+            }
+
+            state = PNGDecodeState::CHUNK_HEADER;
+            break;
+         }
+         case PNGDecodeState::END:
+            return length;
+         case PNGDecodeState::FAILED:
+            return offset;
+      }
+   }
+
+   return offset;
+}
+
+bool PNGStreamDecoder::TrySetOutput(uint32_t* pixels, size_t stride, const PNGDecodeOptions& options) {
+   if (!HasHeader()) {
+      return false;
+   }
+
+   this->pixels = pixels;
+   this->stride = stride;
+   this->transparentPixel = options.transparentPixel;
+   alphaMode = options.alphaMode;
+   isVerifying = options.isVerifying;
+   inflater.isVerifying = options.isVerifying;
+
+   stats = options.stats;
+   if (stats) {
+      *stats = PNGDecodeStats();
+   }
+   return true;
+}
+
+void PNGStreamDecoder::StartPipeline() {
+   if (isPipelined || isKeeping || !pixels) {
+      return;
+   }
+
+   size_t slotSize = lineLength + 1;
+   ring.Reset(arena->AllocateArray<uint8_t>(slotSize * PNG_PIPELINE_SLOTS), slotSize, PNG_PIPELINE_SLOTS);
+   isPipelined = true;
+   rowThread = std::thread(&PNGStreamDecoder::ReconstructQueuedRows, this);
+}
+
+void PNGStreamDecoder::StartParallelInflate(size_t maxDataSize, uint32_t threadCount) {
+   if (isPipelined || isKeeping || !pixels) {
+      return;
+   }
+
+   keptData = arena->AllocateArray<uint8_t>(maxDataSize + PARALLEL_INFLATE_PADDING);
+   keptCapacity = maxDataSize;
+   inflateThreads = threadCount ? threadCount : std::thread::hardware_concurrency();
+   isKeeping = true;
+}
+
+void PNGStreamDecoder::Finish() {
+   if (isKeeping) {
+      isKeeping = false;
+      if (!IsFailed() && isDataStarted && !TryInflateKept()) {
+         state = PNGDecodeState::FAILED;
+      }
+   }
+
+   if (rowThread.joinable()) {
+      ring.Close();
+      rowThread.join();
+
+      if (isRowFailed) {
+         state = PNGDecodeState::FAILED;
+      }
+   }
+
+   if (stats) {
+      memcpy(stats->blockCounts, inflater.blockCounts, sizeof(stats->blockCounts));
+      stats->bytesIn = bytesFed;
+      stats->bytesOut = (uint64_t) RowsReady() * header.width * sizeof(uint32_t);
+      stats->scratchBytes = sizeof(*this) + arena->GetSize();
+   }
+}
+
+//Collects count bytes in the staging buffer, possibly over several parts
+bool PNGStreamDecoder::TryGather(const uint8_t* data, size_t length, size_t* offset, size_t count) {
+   size_t partCount = count - stagingSize;
+   if (partCount > length - *offset) {
+      partCount = length - *offset;
+   }
+
+   memcpy(staging + stagingSize, data + *offset, partCount);
+   stagingSize += partCount;
+   *offset += partCount;
+
+   if (stagingSize < count) {
+      return false;
+   }
+
+   stagingSize = 0;
+   return true;
+}
+
+bool PNGStreamDecoder::TryStartChunk() {
+   const char* type = (const char*) staging + 4;
+   chunkLeft = ToUInt32((const char*) staging);
+
+   if (chunkLeft > INT32_MAX) {
+      return false;
+   }
+
+   isHeaderChunk = !HasHeader();
+   if (isHeaderChunk && (NotSameBuffer(type, IHDR, 4) || chunkLeft != 13)) {//Header should be the first chunk
+      return false;
+   }
+
+   //IDAT chunks are consecutive, the first other chunk after them ends the image data
+   isDataChunk = !NotSameBuffer(type, IDAT, 4);
+   if (isDataChunk) {
+      if (!isDataStarted && !TryStartConversion()) {//Palette and transparency come before the data
+         return false;
+      }
+      isDataStarted = true;
+   } else if (isDataStarted || !NotSameBuffer(type, IEND, 4)) {
+      state = PNGDecodeState::END;
+      return true;
+   }
+
+   chunkTarget = isHeaderChunk ? staging : nullptr;
+   if (!NotSameBuffer(type, PLTE, 4)) {
+      if (chunkLeft > sizeof(palette) || chunkLeft % 3) {
+         return false;
+      }
+
+      chunkTarget = palette;
+      paletteSize = chunkLeft;
+   } else if (!NotSameBuffer(type, TRNS, 4) && chunkLeft <= sizeof(transparency)) {//Oversized ones are skipped
+      chunkTarget = transparency;
+      transparencySize = chunkLeft;
+   }
+
+   //The CRC covers the chunk type and data
+   crc = isVerifying ? UpdateCrc32(0, (const uint8_t*) type, 4) : 0;
+
+   state = chunkLeft ? PNGDecodeState::CHUNK_DATA : PNGDecodeState::CHUNK_CRC;
+
+   return true;
+}
+
+bool PNGStreamDecoder::TryStartImage() {
+   header = TryReadHeader((const char*) staging);
+   stagingSize = 0;
+
+   if (!HasHeader()) {
+      return false;
+   }
+
+   kernels = GetDefilterKernels(header.bbp);
+   if (!kernels) {
+      return false;
+   }
+
+   uint32_t bitsPerPixel = (uint32_t) GetChannelCount(header.colorType) * header.bitDepth;
+   uint32_t passTotal = header.interlaceMethod ? ADAM7_PASS_COUNT : 1;
+   filteredSize = 0;
+
+   for (uint32_t i = 0; i < passTotal; i++) {
+      ImagePass pass{0, 0, 0, 0, 1, 1, 0, totalRows};
+      if (header.interlaceMethod) {
+         pass.x = ADAM7[i][0];
+         pass.y = ADAM7[i][1];
+         pass.stepX = ADAM7[i][2];
+         pass.stepY = ADAM7[i][3];
+      }
+
+      pass.width = header.width > pass.x ? (header.width - pass.x + pass.stepX - 1) / pass.stepX : 0;
+      pass.height = header.height > pass.y ? (header.height - pass.y + pass.stepY - 1) / pass.stepY : 0;
+      if (!pass.width || !pass.height) {//Empty passes have no scanlines at all, not even filter bytes
+         continue;
+      }
+
+      pass.lineLength = ((size_t) pass.width * bitsPerPixel + 7) / 8;
+      if (pass.lineLength > lineLength) {
+         lineLength = pass.lineLength;
+      }
+
+      totalRows += pass.height;
+      filteredSize += (uint64_t) pass.height * (pass.lineLength + 1);
+      passes[passCount++] = pass;
+   }
+
+   lines = arena->AllocateArray<uint8_t>(lineLength * 2);
+   passPixels = header.interlaceMethod ? arena->AllocateArray<uint32_t>(header.width) : nullptr;
+
+   //History for back references, the same again as slack so the window slides rarely, and two filtered lines.
+   //Small images fit whole
+   //One spare byte lets excess data show up as output instead of a full window
+   uint64_t capacity = 2 * INFLATE_WINDOW_SIZE + 2 * (lineLength + 1);
+   size_t windowSize = (size_t) (filteredSize + 1 < capacity ? filteredSize + 1 : capacity);
+   inflater.Reset(arena->AllocateArray<uint8_t>(windowSize + INFLATE_COPY_OVERRUN), windowSize);
+
+   return true;
+}
+
+bool PNGStreamDecoder::TryStartConversion() {
+   ScanlineFormat format;
+   format.colorType = header.colorType;
+   format.bitDepth = header.bitDepth;
+   format.palette = palette;
+   format.paletteCount = paletteSize / 3;
+   format.transparency = transparency;
+   format.transparencySize = transparencySize;
+
+   return converter.TryInit(format, header.width, alphaMode, transparentPixel, *arena);
+}
+
+bool PNGStreamDecoder::TryInflate(const uint8_t* data, size_t length) {
+   inflater.SetInput(data, length);
+
+   while (true) {
+      uint32_t rowsBefore = rowsInflated;
+      InflateResult result;
+      bool isConsumed;
+
+      if (stats) {
+         auto start = std::chrono::steady_clock::now();
+         result = inflater.Inflate();
+         auto inflated = std::chrono::steady_clock::now();
+         isConsumed = TryConsumeRows();
+
+         stats->inflateSeconds += std::chrono::duration<double>(inflated - start).count();
+         rowSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - inflated).count();
+      } else {
+         result = inflater.Inflate();
+         isConsumed = TryConsumeRows();
+      }
+
+      if (!isConsumed) {
+         return false;
+      }
+
+      if (result == InflateResult::NEED_INPUT || result == InflateResult::DONE) {
+         return true;
+      } else if (result == InflateResult::FAILED) {
+         return rowsInflated == totalRows && !inflater.isChecksumFailed;//Other errors after the last row are ignored
+      } else if (rowsInflated == rowsBefore) {//Output is full and nothing was taken from it
+         isExcess = rowsInflated == totalRows;
+         return false;
+      }
+   }
+}
+
+bool PNGStreamDecoder::TryKeepData(const uint8_t* data, size_t length) {
+   if (length > keptCapacity - keptSize) {
+      return false;
+   }
+
+   memcpy(keptData + keptSize, data, length);
+   keptSize += length;
+   return true;
+}
+
+//Reconstructs straight from the inflated image, no row waits for the inflater
+bool PNGStreamDecoder::TryInflateKept() {
+   if (filteredSize > SIZE_MAX - INFLATE_COPY_OVERRUN) {
+      return false;
+   }
+
+   memset(keptData + keptSize, 0, PARALLEL_INFLATE_PADDING);
+   uint8_t* filtered = arena->AllocateArray<uint8_t>((size_t) filteredSize + INFLATE_COPY_OVERRUN);
+
+   std::chrono::steady_clock::time_point start;
+   if (stats) {
+      start = std::chrono::steady_clock::now();
+   }
+
+   ParallelInflateStats inflateStats;
+   bool isInflated = TryInflateParallel(keptData, keptSize, filtered, (size_t) filteredSize, inflateThreads, isVerifying, &inflateStats);
+
+   //Counted as the inflater's own, the inflater was never fed
+   memcpy(inflater.blockCounts, inflateStats.blockCounts, sizeof(inflater.blockCounts));
+   if (stats) {
+      stats->inflateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      stats->inflateSegments = 1 + inflateStats.linkedCount;
+   }
+
+   if (!isInflated) {
+      return false;
+   }
+
+   inflater.state = InflateState::DONE;
+
+   const uint8_t* filteredLine = filtered;
+   while (rowsInflated < totalRows) {
+      while (rowsInflated >= passes[inflatePass].firstRow + passes[inflatePass].height) {
+         inflatePass++;
+      }
+
+      if (!TryReconstructRow(filteredLine)) {
+         return false;
+      }
+
+      size_t filteredLength = passes[inflatePass].lineLength + 1;
+      filteredLine += filteredLength;
+      rowsInflated++;
+
+      if (stats) {
+         stats->bytesInflated += filteredLength;
+      }
+   }
+
+   return true;
+}
+
+bool PNGStreamDecoder::TryConsumeRows() {
+   while (rowsInflated < totalRows) {
+      while (rowsInflated >= passes[inflatePass].firstRow + passes[inflatePass].height) {
+         inflatePass++;
+      }
+
+      size_t filteredLength = passes[inflatePass].lineLength + 1;
+      if (inflater.GetPendingSize() < filteredLength) {
+         break;
+      }
+
+      const uint8_t* filteredLine = inflater.GetPending();
+      if (!(isPipelined ? TryQueueRow(filteredLine, filteredLength) : TryReconstructRow(filteredLine))) {
+         return false;
+      }
+
+      inflater.ConsumeOutput(filteredLength);
+      rowsInflated++;
+
+      if (stats) {
+         stats->bytesInflated += filteredLength;
+      }
+   }
+
+   if (rowsInflated == totalRows && inflater.GetPendingSize()) {//More data than the image needs
+      isExcess = true;
+      return false;
+   }
+
+   return true;
+}
+
+//Copies the scanline out of the inflate window, which moves on as soon as this returns
+bool PNGStreamDecoder::TryQueueRow(const uint8_t* filteredLine, size_t filteredLength) {
+   uint8_t* slot;
+   while (!(slot = ring.TryBeginWrite())) {
+      if (ring.IsCancelled()) {
+         return false;
+      }
+
+      std::this_thread::yield();
+   }
+
+   memcpy(slot, filteredLine, filteredLength);
+   ring.EndWrite();
+   return true;
+}
+
+bool PNGStreamDecoder::TryReconstructRow(const uint8_t* filteredLine) {
+   uint8_t filterCode = filteredLine[0];
+   if (filterCode >= FILTER_TYPE_COUNT) {
+      return false;
+   }
+
+   while (rowsReconstructed >= passes[rowPass].firstRow + passes[rowPass].height) {
+      rowPass++;
+   }
+
+   const ImagePass& pass = passes[rowPass];
+   uint32_t passRow = rowsReconstructed - pass.firstRow;
+   uint8_t* line = &lines[(passRow & 1) * lineLength];
+   uint8_t* prevLine = &lines[((passRow + 1) & 1) * lineLength];
+   if (!passRow) {//Every pass starts against a zeroed row
+      memset(prevLine, 0, pass.lineLength);
+   }
+
+   std::chrono::steady_clock::time_point start;
+   if (stats) {
+      start = std::chrono::steady_clock::now();
+   }
+
+   kernels->rows[filterCode](line, filteredLine + 1, prevLine, pass.lineLength);
+
+   std::chrono::steady_clock::time_point defiltered;
+   if (stats) {
+      defiltered = std::chrono::steady_clock::now();
+      stats->defilterSeconds += std::chrono::duration<double>(defiltered - start).count();
+      stats->filterRows[filterCode]++;
+   }
+
+   uint32_t* row = pixels + (size_t) (pass.y + passRow * pass.stepY) * stride;
+   if (pass.stepX == 1) {
+      converter.Convert(row, line, pass.width);
+   } else {
+      converter.Convert(passPixels, line, pass.width);
+      for (uint32_t i = 0; i < pass.width; i++) {
+         row[pass.x + i * pass.stepX] = passPixels[i];
+      }
+   }
+
+   if (stats) {
+      stats->convertSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - defiltered).count();
+   }
+
+   rowsReconstructed++;
+   if (!header.interlaceMethod) {
+      rowsReady.store(rowsReconstructed, std::memory_order_release);
+   } else if (rowsReconstructed == totalRows) {
+      rowsReady.store(header.height, std::memory_order_release);
+   }
+
+   return true;
+}
+
+//Row thread body, runs until the last row or until the feeding side closes the ring
+void PNGStreamDecoder::ReconstructQueuedRows() {
+   while (rowsReconstructed < totalRows) {
+      bool isClosed = ring.IsClosed();//Checked before reading, so rows written before closing are not lost
+      const uint8_t* filteredLine = ring.TryBeginRead();
+
+      if (!filteredLine) {
+         if (isClosed) {
+            return;
+         }
+
+         std::this_thread::yield();
+         continue;
+      }
+
+      if (!TryReconstructRow(filteredLine)) {
+         isRowFailed = true;
+         ring.Cancel();
+         return;
+      }
+
+      ring.EndRead();
+   }
+}
+
+bool NotSameBuffer(const char* first, const char* second, size_t count, size_t firstOffset, size_t secondOffset) {
+   for (int i = 0; i < count; i++) {
+      if (first[firstOffset + i] != second[secondOffset + i]) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+uint32_t ToUInt32(const char* buffer, size_t offset) {
+   return ((uint32_t) ((uint8_t) buffer[offset]) << 24) + ((uint32_t) ((uint8_t) buffer[offset + 1]) << 16) + ((uint32_t) ((uint8_t) buffer[offset + 2]) << 8) + (uint8_t) buffer[offset + 3];
+}
+
+PNGHeader TryReadHeader(const char* data) {
+   uint32_t width = ToUInt32(data);
+   uint32_t height = ToUInt32(data, 4);
+   uint8_t bitDepth = (uint8_t) data[8];
+   uint8_t colorType = (uint8_t) data[9];
+   uint8_t compMethod = (uint8_t) data[10];
+   uint8_t filterMethod = (uint8_t) data[11];
+   uint8_t interlaceMethod = (uint8_t) data[12];
+
+   if (!width || !height || (uint64_t) width * height > PNG_MAX_PIXELS) {
+      return {};
+   }
+
+   //Allowed bit depths of every color type as bit masks
+   uint32_t bitDepths = 0;
+   if (colorType == PNG_COLOR_GRAY) {
+      bitDepths = 1 << 1 | 1 << 2 | 1 << 4 | 1 << 8 | 1 << 16;
+   } else if (colorType == PNG_COLOR_PALETTE) {
+      bitDepths = 1 << 1 | 1 << 2 | 1 << 4 | 1 << 8;
+   } else if (colorType == PNG_COLOR_RGB || colorType == PNG_COLOR_GRAY_ALPHA || colorType == PNG_COLOR_RGBA) {
+      bitDepths = 1 << 8 | 1 << 16;
+   }
+
+   if (bitDepth > 16 || !(bitDepths & (1u << bitDepth))) {
+      return {};
+   }
+
+   if (compMethod || filterMethod) {
+      return {};
+   }
+
+   if (interlaceMethod > 1) {//Only Adam7 exists
+      return {};
+   }
+
+   //Filters work on whole bytes, bit depths below 8 use the previous byte
+   uint32_t bytesPerPixel = GetChannelCount(colorType) * bitDepth / 8;
+   uint8_t bbp = (uint8_t) (bytesPerPixel ? bytesPerPixel : 1);
+
+   return PNGHeader{width, height, bitDepth, colorType, compMethod, filterMethod, interlaceMethod, bbp};
+}
+
+uint8_t GetChannelCount(uint8_t colorType) {
+   switch (colorType) {
+      case PNG_COLOR_RGB:
+         return 3;
+      case PNG_COLOR_GRAY_ALPHA:
+         return 2;
+      case PNG_COLOR_RGBA:
+         return 4;
+   }
+
+   return 1;//Gray and palette indices
+}
+
+bool DecodePNG(const uint8_t* data, size_t length, const PNGDecodeOptions& options, PNGImage& image) {
+   PNGDecoderContext context;
+   return DecodePNG(data, length, options, image, context);
+}
+
+bool DecodePNG(const uint8_t* data, size_t length, const PNGDecodeOptions& options, PNGImage& image, PNGDecoderContext& context) {
+   context.arena.Reset();
+
+   PNGStreamDecoder decoder(context.arena);
+   size_t offset = decoder.Feed(data, length);
+   if (!decoder.HasHeader()) {
+      return false;
+   }
+
+   const PNGHeader& header = decoder.GetHeader();
+   image.width = header.width;
+   image.height = header.height;
+   image.stride = (size_t) header.width * sizeof(uint32_t);
+   image.pixels.resize((size_t) header.width * header.height);
+
+   if (!decoder.TrySetOutput(image.pixels.data(), header.width, options)) {
+      return false;
+   }
+
+   if (IsParallelInflateWorth(options, length - offset)) {
+      decoder.StartParallelInflate(length - offset, options.inflateThreads);
+   } else if (IsPipelineWorth(options, header)) {
+      decoder.StartPipeline();
+   }
+
+   decoder.Feed(data + offset, length - offset);
+   decoder.Finish();
+
+   return decoder.IsComplete();
+}
+
+bool IsPipelineWorth(const PNGDecodeOptions& options, const PNGHeader& header) {
+   if (options.threading != DecodeThreading::AUTO) {
+      return options.threading == DecodeThreading::PIPELINED;
+   }
+
+   return (uint64_t) header.width * header.height >= PNG_PIPELINE_MIN_PIXELS && std::thread::hardware_concurrency() > 1;
+}
+
+bool IsParallelInflateWorth(const PNGDecodeOptions& options, size_t dataSize) {
+   if (options.threading != DecodeThreading::AUTO) {
+      return options.threading == DecodeThreading::PARALLEL;
+   }
+
+   return dataSize >= PNG_PARALLEL_MIN_DATA && std::thread::hardware_concurrency() >= PNG_PARALLEL_MIN_THREADS;
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+#pragma once
+#include "decode_arena.h"
+#include "inflater.h"
+#include "parallel_inflate.h"
+#include "pixel_convert.h"
+#include "png_filters.h"
+#include "scanline_ring.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define PNG_PIPELINE_MIN_PIXELS (512 * 512)//Smaller images decode faster than a thread starts paying off
+#define PNG_PIPELINE_SLOTS 64
+#define PNG_PARALLEL_MIN_DATA (4 * 1024 * 1024)//Compressed bytes, enough for two segments on each of 8 threads
+#define PNG_PARALLEL_MIN_THREADS 4//Speculative segments inflate slower, two cores hardly gain over the pipeline
+#define ADAM7_PASS_COUNT 7
+#define PNG_MAX_PIXELS (1u << 28)//1 GB of BGRA output, larger headers are refused before anything is allocated for them
+
+struct PNGHeader {
+   uint32_t width;
+   uint32_t height;
+   uint8_t bitDepth;
+   uint8_t colorType;
+   uint8_t compMethod;
+   uint8_t filterMethod;
+   uint8_t interlaceMethod;
+   uint8_t bbp;
+};
+
+//Sub-image of one Adam7 pass, a plain image is a single pass covering everything
+struct ImagePass {
+   uint32_t width;
+   uint32_t height;
+   uint32_t x;//Position of the first pixel
+   uint32_t y;
+   uint32_t stepX;//Distance between pixels in the image
+   uint32_t stepY;
+   size_t lineLength;//Bytes of a reconstructed scanline
+   uint32_t firstRow;//Scanlines of the earlier passes
+};
+
+enum class DecodeThreading {
+   AUTO = 0,//Pipelined from PNG_PIPELINE_MIN_PIXELS up when there is more than one core
+   SINGLE,
+   PIPELINED,
+   PARALLEL//Image data is gathered, inflated on several threads and then defiltered. AUTO picks it for very large images
+};
+
+//Where the time of one decode went. In pipelined mode defiltering and converting run on the row thread,
+//alongside chunk reading and inflating
+struct PNGDecodeStats {
+   double fileSeconds = 0;//Reading the file, set by TryLoadPNG
+   double chunkSeconds = 0;//Signature, chunk headers, CRC and everything else outside the stages below
+   double inflateSeconds = 0;
+   double defilterSeconds = 0;
+   double convertSeconds = 0;
+   uint32_t blockCounts[INFLATE_BLOCK_TYPE_COUNT] = {};//Stored, fixed and dynamic deflate blocks
+   uint32_t filterRows[FILTER_TYPE_COUNT] = {};//Scanlines by filter type
+   uint32_t inflateSegments = 0;//Parallel mode: parts of the image data inflated at once, 1 when it had no split points
+   uint64_t bytesIn = 0;//File bytes fed to the decoder
+   uint64_t bytesInflated = 0;//Filtered scanlines
+   uint64_t bytesOut = 0;//BGRA output
+   size_t scratchBytes = 0;//Decoder state and arena memory of this decode, nothing is freed before the end so this is the peak
+};
+
+struct PNGDecodeOptions {
+   AlphaMode alphaMode = AlphaMode::COLOR_KEY;
+   uint32_t transparentPixel = 0;//Key color in color key mode
+   DecodeThreading threading = DecodeThreading::AUTO;
+   bool isVerifying = true;//Chunk CRC-32 and image data Adler-32 checks
+   uint32_t inflateThreads = 0;//Parallel mode, 0 for every core
+   PNGDecodeStats* stats = nullptr;//Filled in when set. Without it the decoder reads no clock and counts nothing
+};
+
+enum class PNGDecodeState {
+   SIGNATURE = 0,
+   CHUNK_HEADER,
+   CHUNK_DATA,
+   CHUNK_CRC,
+   END,
+   FAILED
+};
+
+//Incremental PNG decoder, the file is fed in parts of any size. Every scanline is defiltered as soon as
+//it is inflated and converted straight into the output, so only two scanlines and the inflate window are kept.
+//Interlaced images go pass by pass, each scanline of a pass is spread over the rows and columns it covers.
+//In pipelined mode the feeding thread only inflates, filtered scanlines go through a ring to a second thread
+//that defilters and converts them. In parallel mode the image data is kept until Finish, which inflates all of it
+//on several threads and reconstructs the rows after that.
+//Scratch memory comes from an arena, a decoder made without one keeps its own
+struct PNGStreamDecoder {
+   PNGStreamDecoder();
+   explicit PNGStreamDecoder(DecodeArena& arena);
+   ~PNGStreamDecoder();
+
+   //Returns the count of consumed bytes. Feeding stops right after the header until an output is set
+   size_t Feed(const uint8_t* data, size_t length);
+
+   bool HasHeader() const {
+      return header.width != 0;
+   }
+
+   const PNGHeader& GetHeader() const {
+      return header;
+   }
+
+   //Stride in pixels. Needs the header, conversion kernels are picked when the image data starts
+   bool TrySetOutput(uint32_t* pixels, size_t stride, const PNGDecodeOptions& options);
+
+   //Starts the row thread, call after the output is set and before the image data is fed
+   void StartPipeline();
+
+   //Keeps the image data for Finish to inflate in parallel, call like StartPipeline instead of it.
+   //maxDataSize bounds the image data, a decode fails when it has more
+   void StartParallelInflate(size_t maxDataSize, uint32_t threadCount);
+
+   //Waits until the row thread has taken every inflated scanline, or inflates the kept image data and reconstructs
+   //every row, then completes the stats. Call when feeding is over
+   void Finish();
+
+   //Rows up to this one are in the output. Interlaced images only have all of them or none
+   uint32_t RowsReady() const {
+      return rowsReady.load(std::memory_order_acquire);
+   }
+
+   bool IsComplete() const {
+      bool isVerified = !isVerifying || inflater.state == InflateState::DONE;
+      return HasHeader() && !IsFailed() && RowsReady() == header.height && !isExcess && !isRowFailed && isVerified;
+   }
+
+   //Image data is over, the rest of the file is not needed
+   bool IsEnded() const {
+      return state == PNGDecodeState::END;
+   }
+
+   bool IsFailed() const {
+      return state == PNGDecodeState::FAILED;
+   }
+
+private:
+
+   std::unique_ptr<DecodeArena> ownArena;
+   DecodeArena* arena;
+
+   PNGDecodeState state = PNGDecodeState::SIGNATURE;
+   PNGHeader header{};
+
+   //Signature, chunk headers and the header chunk are gathered here across parts
+   uint8_t staging[16];
+   size_t stagingSize = 0;
+
+   uint8_t palette[PALETTE_MAX_ENTRIES * 3];
+   uint32_t paletteSize = 0;
+   uint8_t transparency[PALETTE_MAX_ENTRIES];//tRNS chunk
+   uint32_t transparencySize = 0;
+
+   uint8_t* chunkTarget = nullptr;//Where data of a kept chunk goes
+   uint32_t chunkLeft = 0;
+   uint32_t crc = 0;
+   bool isVerifying = true;
+   bool isHeaderChunk = false;
+   bool isDataChunk = false;
+   bool isDataStarted = false;
+
+   PNGDecodeStats* stats = nullptr;
+   double rowSeconds = 0;//Feeding thread time spent handing out scanlines, part of the stats
+   uint64_t bytesFed = 0;
+
+   uint32_t* pixels = nullptr;
+   size_t stride = 0;
+   uint32_t transparentPixel = 0;
+   AlphaMode alphaMode = AlphaMode::COLOR_KEY;
+   RowConverter converter;
+
+   Inflater inflater;
+   const DefilterKernels* kernels = nullptr;
+   ImagePass passes[ADAM7_PASS_COUNT];//Only the passes that have pixels
+   uint32_t passCount = 0;
+   uint32_t totalRows = 0;//Scanlines of all passes
+   size_t lineLength = 0;//Longest scanline
+   uint8_t* lines = nullptr;//Previous and current reconstructed scanlines
+   uint32_t* passPixels = nullptr;//Converted scanline of an interlaced pass before it is spread out
+   uint64_t filteredSize = 0;//Scanlines of all passes with their filter bytes
+   uint32_t rowsInflated = 0;
+   uint32_t inflatePass = 0;
+   uint32_t rowsReconstructed = 0;//Row thread side in pipelined mode
+   uint32_t rowPass = 0;
+   std::atomic<uint32_t> rowsReady{0};
+   bool isExcess = false;
+
+   std::thread rowThread;
+   ScanlineRing ring;
+   bool isPipelined = false;
+   bool isRowFailed = false;//Set by the row thread, read after it is joined
+
+   uint8_t* keptData = nullptr;//Image data of parallel mode, with PARALLEL_INFLATE_PADDING spare bytes
+   size_t keptSize = 0;
+   size_t keptCapacity = 0;
+   uint32_t inflateThreads = 0;
+   bool isKeeping = false;
+
+   size_t FeedChunks(const uint8_t* data, size_t length);
+   bool TryGather(const uint8_t* data, size_t length, size_t* offset, size_t count);
+   bool TryStartChunk();
+   bool TryStartImage();
+   bool TryStartConversion();
+   bool TryInflate(const uint8_t* data, size_t length);
+   bool TryKeepData(const uint8_t* data, size_t length);
+   bool TryInflateKept();
+   bool TryConsumeRows();
+   bool TryQueueRow(const uint8_t* filteredLine, size_t filteredLength);
+   bool TryReconstructRow(const uint8_t* filteredLine);
+   void ReconstructQueuedRows();
+};
+
+struct PNGImage {
+   uint32_t width = 0;
+   uint32_t height = 0;
+   size_t stride = 0;//In bytes
+   std::vector<uint32_t> pixels;//BGRA, top row first
+};
+
+//Scratch memory reused from one decode to the next. Decodes with a context that has seen an image at least
+//as large allocate nothing but the output pixels, and none at all when the PNGImage is reused too.
+//A context serves one decode at a time, every thread decoding in parallel needs its own
+struct PNGDecoderContext {
+   DecodeArena arena;
+};
+
+//Whether DecodePNG runs the row thread for this image
+bool IsPipelineWorth(const PNGDecodeOptions& options, const PNGHeader& header);
+
+//Whether DecodePNG inflates in parallel, dataSize bounds the compressed image data
+bool IsParallelInflateWorth(const PNGDecodeOptions& options, size_t dataSize);
+
+//Decodes a whole PNG file held in memory
+bool DecodePNG(const uint8_t* data, size_t length, const PNGDecodeOptions& options, PNGImage& image);
+bool DecodePNG(const uint8_t* data, size_t length, const PNGDecodeOptions& options, PNGImage& image, PNGDecoderContext& context);
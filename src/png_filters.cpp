@@ -0,0 +1,283 @@
+#include "png_filters.h"
+#include <cstdlib>
+#include <cstring>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+static uint8_t PaethPredictor(uint8_t a, uint8_t b, uint8_t c) {
+   int32_t p = (int32_t) a + (int32_t) b - (int32_t) c;
+   int32_t pa = abs(p - a);
+   int32_t pb = abs(p - b);
+   int32_t pc = abs(p - c);
+
+   if (pa <= pb && pa <= pc) {
+      return a;
+   } else if (pb <= pc) {
+      return b;
+   }
+
+   return c;
+}
+
+static void DefilterNone(uint8_t* dst, const uint8_t* src, const uint8_t* /*prevRow*/, size_t rowBytes) {
+   memcpy(dst, src, rowBytes);
+}
+
+template<size_t BBP>
+static void DefilterSubScalar(uint8_t* dst, const uint8_t* src, const uint8_t* /*prevRow*/, size_t rowBytes) {
+   for (size_t i = 0; i < BBP; i++) {
+      dst[i] = src[i];
+   }
+
+   for (size_t i = BBP; i < rowBytes; i++) {
+      dst[i] = src[i] + dst[i - BBP];
+   }
+}
+
+static void DefilterUpScalar(uint8_t* dst, const uint8_t* src, const uint8_t* prevRow, size_t rowBytes) {
+   for (size_t i = 0; i < rowBytes; i++) {
+      dst[i] = src[i] + prevRow[i];
+   }
+}
+
+template<size_t BBP>
+static void DefilterAverageScalar(uint8_t* dst, const uint8_t* src, const uint8_t* prevRow, size_t rowBytes) {
+   for (size_t i = 0; i < BBP; i++) {
+      dst[i] = src[i] + (prevRow[i] >> 1);
+   }
+
+   for (size_t i = BBP; i < rowBytes; i++) {
+      dst[i] = src[i] + (uint8_t) (((uint32_t) dst[i - BBP] + prevRow[i]) >> 1);
+   }
+}
+
+template<size_t BBP>
+static void DefilterPaethScalar(uint8_t* dst, const uint8_t* src, const uint8_t* prevRow, size_t rowBytes) {
+   for (size_t i = 0; i < BBP; i++) {
+      dst[i] = src[i] + prevRow[i];
+   }
+
+   for (size_t i = BBP; i < rowBytes; i++) {
+      dst[i] = src[i] + PaethPredictor(dst[i - BBP], prevRow[i], prevRow[i - BBP]);
+   }
+}
+
+#if CPU_X86
+
+//Loads and stores of a single pixel, never touching bytes outside of it.
+//3 byte pixels are assembled in registers, going through memory would stall on store forwarding
+template<size_t BBP>
+static inline __m128i LoadPixel(const uint8_t* p) {
+   int value;
+   memcpy(&value, p, 4);
+   return _mm_cvtsi32_si128(value);
+}
+
+template<>
+inline __m128i LoadPixel<3>(const uint8_t* p) {
+   uint16_t low;
+   memcpy(&low, p, 2);
+   return _mm_cvtsi32_si128((int) low | ((int) p[2] << 16));
+}
+
+template<size_t BBP>
+static inline void StorePixel(uint8_t* p, __m128i value) {
+   int result = _mm_cvtsi128_si32(value);
+   memcpy(p, &result, 4);
+}
+
+template<>
+inline void StorePixel<3>(uint8_t* p, __m128i value) {
+   int result = _mm_cvtsi128_si32(value);
+   uint16_t low = (uint16_t) result;
+   memcpy(p, &low, 2);
+   p[2] = (uint8_t) (result >> 16);
+}
+
+//Prefix sum over the 4 pixels of a vector, then the last pixel of the previous vector is added to all of them
+static void DefilterSub4Sse2(uint8_t* dst, const uint8_t* src, const uint8_t* /*prevRow*/, size_t rowBytes) {
+   __m128i carry = _mm_setzero_si128();
+
+   size_t i = 0;
+   for (; i + 16 <= rowBytes; i += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, carry);
+      _mm_storeu_si128((__m128i*) (dst + i), x);
+
+      carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+   }
+
+   for (; i < rowBytes; i += 4) {
+      carry = _mm_add_epi8(carry, LoadPixel<4>(src + i));
+      StorePixel<4>(dst + i, carry);
+   }
+}
+
+//Same as the 4 byte version over 12 bytes per step, the top 4 bytes of a vector are ignored
+static void DefilterSub3Sse2(uint8_t* dst, const uint8_t* src, const uint8_t* /*prevRow*/, size_t rowBytes) {
+   const __m128i pixelMask = _mm_cvtsi32_si128(0x00FFFFFF);
+   __m128i carry = _mm_setzero_si128();
+
+   size_t i = 0;
+   for (; i + 16 <= rowBytes; i += 12) {
+      __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+      x = _mm_add_epi8(x, carry);
+      _mm_storel_epi64((__m128i*) (dst + i), x);
+      StorePixel<4>(dst + i + 8, _mm_srli_si128(x, 8));
+
+      carry = _mm_and_si128(_mm_srli_si128(x, 9), pixelMask);
+      carry = _mm_or_si128(carry, _mm_slli_si128(carry, 3));
+      carry = _mm_or_si128(carry, _mm_slli_si128(carry, 6));
+   }
+
+   for (; i < rowBytes; i += 3) {
+      carry = _mm_add_epi8(carry, LoadPixel<3>(src + i));
+      StorePixel<3>(dst + i, carry);
+   }
+}
+
+static void DefilterUpSse2(uint8_t* dst, const uint8_t* src, const uint8_t* prevRow, size_t rowBytes) {
+   size_t i = 0;
+   for (; i + 16 <= rowBytes; i += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+      __m128i b = _mm_loadu_si128((const __m128i*) (prevRow + i));
+      _mm_storeu_si128((__m128i*) (dst + i), _mm_add_epi8(x, b));
+   }
+
+   for (; i < rowBytes; i++) {
+      dst[i] = src[i] + prevRow[i];
+   }
+}
+
+TARGET_AVX2 static void DefilterUpAvx2(uint8_t* dst, const uint8_t* src, const uint8_t* prevRow, size_t rowBytes) {
+   size_t i = 0;
+   for (; i + 32 <= rowBytes; i += 32) {
+      __m256i x = _mm256_loadu_si256((const __m256i*) (src + i));
+      __m256i b = _mm256_loadu_si256((const __m256i*) (prevRow + i));
+      _mm256_storeu_si256((__m256i*) (dst + i), _mm256_add_epi8(x, b));
+   }
+
+   for (; i < rowBytes; i++) {
+      dst[i] = src[i] + prevRow[i];
+   }
+}
+
+//Pixels depend on their left neighbour, so these go one pixel per step with all channels at once
+template<size_t BBP>
+static void DefilterAverageSse2(uint8_t* dst, const uint8_t* src, const uint8_t* prevRow, size_t rowBytes) {
+   const __m128i one = _mm_set1_epi8(1);
+   __m128i a = _mm_setzero_si128();
+
+   for (size_t i = 0; i < rowBytes; i += BBP) {
+      __m128i b = LoadPixel<BBP>(prevRow + i);
+
+      //avg_epu8 rounds up, floor((a + b) / 2) is needed
+      __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(LoadPixel<BBP>(src + i), average);
+      StorePixel<BBP>(dst + i, a);
+   }
+}
+
+static inline __m128i Abs16(__m128i x) {
+   return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static inline __m128i Select(__m128i mask, __m128i ifTrue, __m128i ifFalse) {
+   return _mm_or_si128(_mm_and_si128(mask, ifTrue), _mm_andnot_si128(mask, ifFalse));
+}
+
+template<size_t BBP>
+static void DefilterPaethSse2(uint8_t* dst, const uint8_t* src, const uint8_t* prevRow, size_t rowBytes) {
+   const __m128i zero = _mm_setzero_si128();
+   __m128i a = zero;
+   __m128i c = zero;
+
+   for (size_t i = 0; i < rowBytes; i += BBP) {
+      __m128i b = _mm_unpacklo_epi8(LoadPixel<BBP>(prevRow + i), zero);
+      __m128i x = _mm_unpacklo_epi8(LoadPixel<BBP>(src + i), zero);
+
+      //p - a = b - c, p - b = a - c, p - c = (b - c) + (a - c)
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = _mm_add_epi16(pa, pb);
+
+      pa = Abs16(pa);
+      pb = Abs16(pb);
+      pc = Abs16(pc);
+
+      __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      __m128i nearest = Select(_mm_cmpeq_epi16(pa, smallest), a, Select(_mm_cmpeq_epi16(pb, smallest), b, c));
+
+      a = _mm_and_si128(_mm_add_epi16(nearest, x), _mm_set1_epi16(0xFF));
+      StorePixel<BBP>(dst + i, _mm_packus_epi16(a, a));
+
+      c = b;
+   }
+}
+
+#endif
+
+static const DefilterKernels s_Scalar3 = {DefilterNone, DefilterSubScalar<3>, DefilterUpScalar, DefilterAverageScalar<3>, DefilterPaethScalar<3>};
+static const DefilterKernels s_Scalar4 = {DefilterNone, DefilterSubScalar<4>, DefilterUpScalar, DefilterAverageScalar<4>, DefilterPaethScalar<4>};
+
+//Gray, gray+alpha, low bit depths and 16 bit samples are rarer, only the Up filter has vector versions for them
+template<size_t BBP, DefilterRowFunc UP>
+static const DefilterKernels s_Generic = {DefilterNone, DefilterSubScalar<BBP>, UP, DefilterAverageScalar<BBP>, DefilterPaethScalar<BBP>};
+
+#if CPU_X86
+static const DefilterKernels s_Sse23 = {DefilterNone, DefilterSub3Sse2, DefilterUpSse2, DefilterAverageSse2<3>, DefilterPaethSse2<3>};
+static const DefilterKernels s_Sse24 = {DefilterNone, DefilterSub4Sse2, DefilterUpSse2, DefilterAverageSse2<4>, DefilterPaethSse2<4>};
+static const DefilterKernels s_Avx23 = {DefilterNone, DefilterSub3Sse2, DefilterUpAvx2, DefilterAverageSse2<3>, DefilterPaethSse2<3>};
+static const DefilterKernels s_Avx24 = {DefilterNone, DefilterSub4Sse2, DefilterUpAvx2, DefilterAverageSse2<4>, DefilterPaethSse2<4>};
+#endif
+
+template<size_t BBP>
+static const DefilterKernels* GetGenericKernels(SimdLevel level) {
+#if CPU_X86
+   if (level == SimdLevel::AVX2) {
+      return &s_Generic<BBP, DefilterUpAvx2>;
+   } else if (level == SimdLevel::SSE2) {
+      return &s_Generic<BBP, DefilterUpSse2>;
+   }
+#endif
+
+   return &s_Generic<BBP, DefilterUpScalar>;
+}
+
+const DefilterKernels* GetDefilterKernels(uint8_t bbp, SimdLevel level) {
+   switch (bbp) {
+      case 1:
+         return GetGenericKernels<1>(level);
+      case 2:
+         return GetGenericKernels<2>(level);
+      case 6:
+         return GetGenericKernels<6>(level);
+      case 8:
+         return GetGenericKernels<8>(level);
+   }
+
+   if (bbp != 3 && bbp != 4) {
+      return nullptr;
+   }
+
+#if CPU_X86
+   if (level == SimdLevel::AVX2) {
+      return bbp == 3 ? &s_Avx23 : &s_Avx24;
+   } else if (level == SimdLevel::SSE2) {
+      return bbp == 3 ? &s_Sse23 : &s_Sse24;
+   }
+#endif
+
+   return bbp == 3 ? &s_Scalar3 : &s_Scalar4;
+}
+
+const DefilterKernels* GetDefilterKernels(uint8_t bbp) {
+   static const SimdLevel level = GetBestSimdLevel();
+   return GetDefilterKernels(bbp, level);
+}
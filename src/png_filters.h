@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "cpu_features.h"
+
+#define FILTER_TYPE_COUNT 5//None, Sub, Up, Average, Paeth
+
+//Reconstructs one scanline from its filtered bytes, prevRow is a zeroed row for the first line
+typedef void (*DefilterRowFunc)(uint8_t* dst, const uint8_t* src, const uint8_t* prevRow, size_t rowBytes);
+
+struct DefilterKernels {
+   DefilterRowFunc rows[FILTER_TYPE_COUNT];//Indexed by filter type
+};
+
+//Kernels for the given bytes per pixel (1 for bit depths below 8) and instruction set, nullptr if there are none
+const DefilterKernels* GetDefilterKernels(uint8_t bbp, SimdLevel level);
+
+//Best kernels for this CPU, picked once
+const DefilterKernels* GetDefilterKernels(uint8_t bbp);
@@ -1,4 +1,20 @@
 #pragma once
 #include <Windows.h>
+#include "png_decoder.h"
+#include <vector>
 
-HBITMAP LoadPNG(const wchar_t* fileName, HDC hdc, const COLORREF transparencyColor);
\ No newline at end of file
+//Color key mode fills transparent pixels with transparencyColor for TransparentBlt, premultiplied mode is for AlphaBlend
+PNGDecodeOptions MakeDecodeOptions(const COLORREF transparencyColor, AlphaMode alphaMode = AlphaMode::COLOR_KEY);
+
+HBITMAP LoadPNG(const wchar_t* fileName, HDC hdc, const COLORREF transparencyColor, AlphaMode alphaMode = AlphaMode::COLOR_KEY, PNGDecodeStats* stats = nullptr);
+
+//Reads and decodes without touching GDI, so it can run on any thread
+bool TryLoadPNG(const wchar_t* fileName, const PNGDecodeOptions& options, PNGImage& image);
+
+//Copies a decoded image into a new 32 bit DIB section
+HBITMAP CreatePNGBitmap(HDC hdc, const PNGImage& image);
+
+//Same for BGRA pixels held elsewhere, rows without padding
+HBITMAP CreatePNGBitmap(HDC hdc, const uint32_t* pixels, uint32_t width, uint32_t height);
+
+bool TryReadFile(const wchar_t* fileName, std::vector<uint8_t>& out);
\ No newline at end of file
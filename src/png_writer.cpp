@@ -0,0 +1,517 @@
+#include "png_writer.h"
+#include "png_filters.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+
+//Greedy LZ77 over a single hash head per position. Symbols are coded in blocks of BLOCK_SYMBOLS like zlib does,
+//each block with its own Huffman codes or the fixed ones, whichever is smaller
+#define BLOCK_SYMBOLS 16384
+#define LIT_LEN_CODES 286
+#define DIST_CODES 30
+#define CODE_LENGTH_CODES 19
+
+struct BitWriter {
+   std::vector<uint8_t>& out;
+   uint64_t bitBuffer = 0;
+   uint32_t bitCount = 0;
+
+   void Write(uint32_t value, uint32_t count) {
+      bitBuffer |= (uint64_t) value << bitCount;
+      bitCount += count;
+      while (bitCount >= 8) {
+         out.emplace_back((uint8_t) bitBuffer);
+         bitBuffer >>= 8;
+         bitCount -= 8;
+      }
+   }
+
+   //Huffman codes go to the stream starting from their top bit
+   void WriteCode(uint32_t code, uint32_t count) {
+      uint32_t reversed = 0;
+      for (uint32_t i = 0; i < count; i++) {
+         reversed |= ((code >> i) & 1) << (count - 1 - i);
+      }
+      Write(reversed, count);
+   }
+
+   void Flush() {
+      if (bitCount) {
+         out.emplace_back((uint8_t) bitBuffer);
+      }
+      bitBuffer = 0;
+      bitCount = 0;
+   }
+};
+
+//A literal when dist is 0
+struct Token {
+   uint16_t litLen;
+   uint16_t dist;
+};
+
+//Canonical Huffman code of one alphabet
+struct HuffmanCode {
+   uint8_t lengths[LIT_LEN_CODES + 2] = {};
+   uint16_t codes[LIT_LEN_CODES + 2] = {};
+};
+
+static const uint32_t s_LengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint32_t s_LengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint32_t s_DistBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint32_t s_DistExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t s_CodeLengthOrder[CODE_LENGTH_CODES] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+static uint32_t GetLengthIndex(uint32_t length) {
+   uint32_t index = 28;
+   while (s_LengthBase[index] > length) {
+      index--;
+   }
+   return index;
+}
+
+static uint32_t GetDistIndex(uint32_t dist) {
+   uint32_t index = 29;
+   while (s_DistBase[index] > dist) {
+      index--;
+   }
+   return index;
+}
+
+static void AssignCodes(HuffmanCode& code, uint32_t symCount) {
+   uint32_t count[16] = {};
+   for (uint32_t i = 0; i < symCount; i++) {
+      count[code.lengths[i]]++;
+   }
+   count[0] = 0;
+
+   uint32_t next[16] = {};
+   for (uint32_t len = 1; len < 16; len++) {
+      next[len] = (next[len - 1] + count[len - 1]) << 1;
+   }
+
+   for (uint32_t i = 0; i < symCount; i++) {
+      if (code.lengths[i]) {
+         code.codes[i] = (uint16_t) next[code.lengths[i]]++;
+      }
+   }
+}
+
+//Huffman code lengths of the used symbols, limited to maxBits by moving the deepest codes up as miniz does.
+//At least two symbols get a code, a single code would be incomplete
+static void BuildCode(HuffmanCode& code, const uint32_t* freqs, uint32_t symCount, uint32_t maxBits) {
+   std::vector<std::pair<uint32_t, uint32_t>> symbols;//Frequency and symbol
+   for (uint32_t i = 0; i < symCount; i++) {
+      if (freqs[i]) {
+         symbols.emplace_back(freqs[i], i);
+      }
+   }
+
+   for (uint32_t i = 0; symbols.size() < 2; i++) {
+      if (!freqs[i]) {
+         symbols.emplace_back(1, i);
+      }
+   }
+
+   //Depths from a plain Huffman tree, parents of a node follow it in nodes
+   std::vector<uint32_t> parents(symbols.size() * 2 - 1);
+   std::priority_queue<std::pair<uint64_t, uint32_t>, std::vector<std::pair<uint64_t, uint32_t>>, std::greater<>> queue;
+   for (uint32_t i = 0; i < symbols.size(); i++) {
+      queue.emplace(symbols[i].first, i);
+   }
+
+   uint32_t nodeCount = (uint32_t) symbols.size();
+   while (queue.size() > 1) {
+      auto first = queue.top();
+      queue.pop();
+      auto second = queue.top();
+      queue.pop();
+
+      parents[first.second] = parents[second.second] = nodeCount;
+      queue.emplace(first.first + second.first, nodeCount++);
+   }
+
+   uint32_t depths[2 * (LIT_LEN_CODES + 2)] = {};
+   uint32_t lengthCounts[2 * (LIT_LEN_CODES + 2)] = {};
+   for (uint32_t node = nodeCount - 1; node-- > 0;) {
+      depths[node] = depths[parents[node]] + 1;
+   }
+
+   uint32_t maxDepth = 0;
+   for (uint32_t i = 0; i < symbols.size(); i++) {
+      lengthCounts[depths[i] < maxBits ? depths[i] : maxBits]++;
+      maxDepth = depths[i] > maxDepth ? depths[i] : maxDepth;
+   }
+
+   //Moving codes up to maxBits oversubscribes the code, split shorter codes until it fits again
+   uint32_t total = 0;
+   for (uint32_t len = 1; len <= maxBits; len++) {
+      total += lengthCounts[len] << (maxBits - len);
+   }
+
+   while (total > (1u << maxBits)) {
+      lengthCounts[maxBits]--;
+      for (uint32_t len = maxBits - 1; len > 0; len--) {
+         if (lengthCounts[len]) {
+            lengthCounts[len]--;
+            lengthCounts[len + 1] += 2;
+            break;
+         }
+      }
+      total--;
+   }
+
+   //Most frequent symbols get the shortest codes
+   std::sort(symbols.begin(), symbols.end(), [](const auto& first, const auto& second) {
+      return first.first != second.first ? first.first > second.first : first.second < second.second;
+   });
+
+   memset(code.lengths, 0, sizeof(code.lengths));
+   size_t index = 0;
+   for (uint32_t len = 1; len <= maxBits; len++) {
+      for (uint32_t i = 0; i < lengthCounts[len]; i++) {
+         code.lengths[symbols[index++].second] = (uint8_t) len;
+      }
+   }
+
+   AssignCodes(code, symCount);
+}
+
+static void MakeFixedCode(HuffmanCode& litLen, HuffmanCode& dist) {
+   for (uint32_t i = 0; i < LIT_LEN_CODES + 2; i++) {
+      litLen.lengths[i] = i <= 143 ? 8 : i <= 255 ? 9 : i <= 279 ? 7 : 8;
+   }
+   for (uint32_t i = 0; i < DIST_CODES + 2; i++) {
+      dist.lengths[i] = 5;
+   }
+
+   AssignCodes(litLen, LIT_LEN_CODES + 2);
+   AssignCodes(dist, DIST_CODES + 2);
+}
+
+//Run-length codes of the code lengths: 16 repeats the previous length, 17 and 18 repeat zero.
+//Each entry is a symbol and its extra bits value
+static std::vector<std::pair<uint8_t, uint8_t>> EncodeLengths(const uint8_t* lengths, uint32_t count) {
+   std::vector<std::pair<uint8_t, uint8_t>> out;
+
+   for (uint32_t i = 0; i < count;) {
+      uint8_t len = lengths[i];
+      uint32_t run = 1;
+      while (i + run < count && lengths[i + run] == len) {
+         run++;
+      }
+
+      uint32_t left = run;
+      if (!len) {
+         while (left >= 11) {
+            uint32_t part = left < 138 ? left : 138;
+            out.emplace_back(18, (uint8_t) (part - 11));
+            left -= part;
+         }
+         if (left >= 3) {
+            out.emplace_back(17, (uint8_t) (left - 3));
+            left = 0;
+         }
+      } else {
+         out.emplace_back(len, 0);
+         left--;
+         while (left >= 3) {
+            uint32_t part = left < 6 ? left : 6;
+            out.emplace_back(16, (uint8_t) (part - 3));
+            left -= part;
+         }
+      }
+
+      for (; left; left--) {
+         out.emplace_back(len, 0);
+      }
+
+      i += run;
+   }
+
+   return out;
+}
+
+static uint64_t GetDataBits(const std::vector<Token>& tokens, const HuffmanCode& litLen, const HuffmanCode& dist) {
+   uint64_t bits = litLen.lengths[256];
+   for (const Token& token : tokens) {
+      if (!token.dist) {
+         bits += litLen.lengths[token.litLen];
+         continue;
+      }
+
+      uint32_t lengthIndex = GetLengthIndex(token.litLen);
+      uint32_t distIndex = GetDistIndex(token.dist);
+      bits += litLen.lengths[257 + lengthIndex] + s_LengthExtra[lengthIndex] + dist.lengths[distIndex] + s_DistExtra[distIndex];
+   }
+
+   return bits;
+}
+
+static void WriteBlock(BitWriter& writer, const std::vector<Token>& tokens, bool isFinal) {
+   uint32_t litLenFreqs[LIT_LEN_CODES] = {};
+   uint32_t distFreqs[DIST_CODES] = {};
+   litLenFreqs[256] = 1;
+
+   for (const Token& token : tokens) {
+      if (token.dist) {
+         litLenFreqs[257 + GetLengthIndex(token.litLen)]++;
+         distFreqs[GetDistIndex(token.dist)]++;
+      } else {
+         litLenFreqs[token.litLen]++;
+      }
+   }
+
+   HuffmanCode litLen;
+   HuffmanCode dist;
+   BuildCode(litLen, litLenFreqs, LIT_LEN_CODES, 15);
+   BuildCode(dist, distFreqs, DIST_CODES, 15);
+
+   uint32_t hlit = LIT_LEN_CODES;
+   while (hlit > 257 && !litLen.lengths[hlit - 1]) {
+      hlit--;
+   }
+
+   uint32_t hdist = DIST_CODES;
+   while (hdist > 1 && !dist.lengths[hdist - 1]) {
+      hdist--;
+   }
+
+   uint8_t lengths[LIT_LEN_CODES + DIST_CODES];
+   memcpy(lengths, litLen.lengths, hlit);
+   memcpy(lengths + hlit, dist.lengths, hdist);
+   std::vector<std::pair<uint8_t, uint8_t>> lengthSyms = EncodeLengths(lengths, hlit + hdist);
+
+   uint32_t codeLengthFreqs[CODE_LENGTH_CODES] = {};
+   for (const auto& sym : lengthSyms) {
+      codeLengthFreqs[sym.first]++;
+   }
+
+   HuffmanCode codeLength;
+   BuildCode(codeLength, codeLengthFreqs, CODE_LENGTH_CODES, 7);
+
+   uint32_t hclen = CODE_LENGTH_CODES;
+   while (hclen > 4 && !codeLength.lengths[s_CodeLengthOrder[hclen - 1]]) {
+      hclen--;
+   }
+
+   uint64_t dynamicBits = 14 + 3 * hclen + GetDataBits(tokens, litLen, dist);
+   for (const auto& sym : lengthSyms) {
+      dynamicBits += codeLength.lengths[sym.first] + (sym.first == 16 ? 2 : sym.first == 17 ? 3 : sym.first == 18 ? 7 : 0);
+   }
+
+   HuffmanCode fixedLitLen;
+   HuffmanCode fixedDist;
+   MakeFixedCode(fixedLitLen, fixedDist);
+   bool isFixed = GetDataBits(tokens, fixedLitLen, fixedDist) <= dynamicBits;
+
+   writer.Write(isFinal ? 1 : 0, 1);
+   writer.Write(isFixed ? 1 : 2, 2);
+
+   const HuffmanCode& litLenCode = isFixed ? fixedLitLen : litLen;
+   const HuffmanCode& distCode = isFixed ? fixedDist : dist;
+
+   if (!isFixed) {
+      writer.Write(hlit - 257, 5);
+      writer.Write(hdist - 1, 5);
+      writer.Write(hclen - 4, 4);
+      for (uint32_t i = 0; i < hclen; i++) {
+         writer.Write(codeLength.lengths[s_CodeLengthOrder[i]], 3);
+      }
+
+      for (const auto& sym : lengthSyms) {
+         writer.WriteCode(codeLength.codes[sym.first], codeLength.lengths[sym.first]);
+         if (sym.first >= 16) {
+            writer.Write(sym.second, sym.first == 16 ? 2 : sym.first == 17 ? 3 : 7);
+         }
+      }
+   }
+
+   for (const Token& token : tokens) {
+      if (!token.dist) {
+         writer.WriteCode(litLenCode.codes[token.litLen], litLenCode.lengths[token.litLen]);
+         continue;
+      }
+
+      uint32_t lengthIndex = GetLengthIndex(token.litLen);
+      writer.WriteCode(litLenCode.codes[257 + lengthIndex], litLenCode.lengths[257 + lengthIndex]);
+      writer.Write(token.litLen - s_LengthBase[lengthIndex], s_LengthExtra[lengthIndex]);
+
+      uint32_t distIndex = GetDistIndex(token.dist);
+      writer.WriteCode(distCode.codes[distIndex], distCode.lengths[distIndex]);
+      writer.Write(token.dist - s_DistBase[distIndex], s_DistExtra[distIndex]);
+   }
+
+   writer.WriteCode(litLenCode.codes[256], litLenCode.lengths[256]);
+}
+
+//Checksums go byte by byte here rather than through the kernels, so files written here check those as well
+static uint32_t Adler32(const std::vector<uint8_t>& data) {
+   uint32_t a = 1;
+   uint32_t b = 0;
+   for (uint8_t byte : data) {
+      a = (a + byte) % 65521;
+      b = (b + a) % 65521;
+   }
+   return (b << 16) | a;
+}
+
+static std::vector<uint8_t> CompressZlib(const std::vector<uint8_t>& data) {
+   std::vector<uint8_t> out = {0x78, 0x01};
+   BitWriter writer{out};
+
+   const uint32_t hashBits = 15;
+   std::vector<int64_t> head((size_t) 1 << hashBits, -1);
+   std::vector<Token> tokens;
+   tokens.reserve(BLOCK_SYMBOLS);
+
+   size_t i = 0;
+   while (i < data.size()) {
+      uint32_t length = 0;
+      size_t matchPos = 0;
+
+      if (i + 3 <= data.size()) {
+         uint32_t hash = ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - hashBits);
+         int64_t candidate = head[hash];
+         head[hash] = (int64_t) i;
+
+         if (candidate >= 0 && i - (size_t) candidate <= 32768) {
+            size_t maxLength = data.size() - i < 258 ? data.size() - i : 258;
+            while (length < maxLength && data[(size_t) candidate + length] == data[i + length]) {
+               length++;
+            }
+            matchPos = (size_t) candidate;
+         }
+      }
+
+      if (length >= 3) {
+         tokens.push_back({(uint16_t) length, (uint16_t) (i - matchPos)});
+         i += length;
+      } else {
+         tokens.push_back({data[i], 0});
+         i++;
+      }
+
+      if (tokens.size() == BLOCK_SYMBOLS && i < data.size()) {
+         WriteBlock(writer, tokens, false);
+         tokens.clear();
+      }
+   }
+
+   WriteBlock(writer, tokens, true);
+   writer.Flush();
+
+   uint32_t adler = Adler32(data);
+   for (int shift = 24; shift >= 0; shift -= 8) {
+      out.emplace_back((uint8_t) (adler >> shift));
+   }
+
+   return out;
+}
+
+static uint32_t Crc32(const uint8_t* data, size_t length) {
+   uint32_t crc = 0xFFFFFFFF;
+   for (size_t i = 0; i < length; i++) {
+      crc ^= data[i];
+      for (int bit = 0; bit < 8; bit++) {
+         crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+      }
+   }
+   return ~crc;
+}
+
+static void AppendUInt32(std::vector<uint8_t>& out, uint32_t value) {
+   for (int shift = 24; shift >= 0; shift -= 8) {
+      out.emplace_back((uint8_t) (value >> shift));
+   }
+}
+
+static void AppendChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+   AppendUInt32(out, (uint32_t) data.size());
+   size_t start = out.size();
+   out.insert(out.end(), type, type + 4);
+   out.insert(out.end(), data.begin(), data.end());
+   AppendUInt32(out, Crc32(out.data() + start, out.size() - start));
+}
+
+static uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c) {
+   int32_t p = (int32_t) a + b - c;
+   int32_t pa = abs(p - a);
+   int32_t pb = abs(p - b);
+   int32_t pc = abs(p - c);
+   return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+}
+
+void AppendFilteredLine(std::vector<uint8_t>& out, const uint8_t* line, const uint8_t* prevLine, size_t lineLength, uint8_t bbp, uint8_t filter) {
+   out.emplace_back(filter);
+   for (size_t i = 0; i < lineLength; i++) {
+      uint8_t a = i >= bbp ? line[i - bbp] : 0;
+      uint8_t b = prevLine[i];
+      uint8_t c = i >= bbp ? prevLine[i - bbp] : 0;
+      uint8_t predictor = 0;
+
+      if (filter == 1) {
+         predictor = a;
+      } else if (filter == 2) {
+         predictor = b;
+      } else if (filter == 3) {
+         predictor = (uint8_t) (((uint32_t) a + b) >> 1);
+      } else if (filter == 4) {
+         predictor = Paeth(a, b, c);
+      }
+
+      out.emplace_back((uint8_t) (line[i] - predictor));
+   }
+}
+
+void AppendBestFilteredLine(std::vector<uint8_t>& out, const uint8_t* line, const uint8_t* prevLine, size_t lineLength, uint8_t bbp) {
+   std::vector<uint8_t> candidate;
+   uint8_t bestFilter = 0;
+   uint64_t bestSum = UINT64_MAX;
+
+   for (uint8_t filter = 0; filter < FILTER_TYPE_COUNT; filter++) {
+      candidate.clear();
+      AppendFilteredLine(candidate, line, prevLine, lineLength, bbp, filter);
+
+      uint64_t sum = 0;
+      for (size_t i = 1; i < candidate.size(); i++) {
+         sum += (uint64_t) abs((int8_t) candidate[i]);
+      }
+
+      if (sum < bestSum) {
+         bestSum = sum;
+         bestFilter = filter;
+      }
+   }
+
+   AppendFilteredLine(out, line, prevLine, lineLength, bbp, bestFilter);
+}
+
+std::vector<uint8_t> WritePNG(uint32_t width, uint32_t height, uint8_t bitDepth, uint8_t colorType, uint8_t interlace, const std::vector<uint8_t>& palette, const std::vector<uint8_t>& transparency, const std::vector<uint8_t>& filtered) {
+   std::vector<uint8_t> file = {137, 80, 78, 71, 13, 10, 26, 10};
+
+   std::vector<uint8_t> header;
+   AppendUInt32(header, width);
+   AppendUInt32(header, height);
+   header.insert(header.end(), {bitDepth, colorType, 0, 0, interlace});
+   AppendChunk(file, "IHDR", header);
+
+   if (!palette.empty()) {
+      AppendChunk(file, "PLTE", palette);
+   }
+
+   if (!transparency.empty()) {
+      AppendChunk(file, "tRNS", transparency);
+   }
+
+   std::vector<uint8_t> compressed = CompressZlib(filtered);
+   const size_t idatSize = 8192;
+   for (size_t offset = 0; offset < compressed.size(); offset += idatSize) {
+      size_t end = offset + idatSize < compressed.size() ? offset + idatSize : compressed.size();
+      AppendChunk(file, "IDAT", std::vector<uint8_t>(compressed.begin() + offset, compressed.begin() + end));
+   }
+
+   AppendChunk(file, "IEND", {});
+   return file;
+}
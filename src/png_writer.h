@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Minimal PNG encoder for tools and the benchmark. Compression is simple and fast rather than small:
+//greedy matching, and deflate blocks of 16K symbols with their own Huffman codes as zlib writes them
+
+//Filters one scanline of samples and appends it with its filter byte. prevLine is all zero for the first row
+void AppendFilteredLine(std::vector<uint8_t>& out, const uint8_t* line, const uint8_t* prevLine, size_t lineLength, uint8_t bbp, uint8_t filter);
+
+//Same with the filter that gives the smallest sum of signed bytes, as libpng picks them
+void AppendBestFilteredLine(std::vector<uint8_t>& out, const uint8_t* line, const uint8_t* prevLine, size_t lineLength, uint8_t bbp);
+
+//Signature, header, palette and transparency when given, the image data split like encoders do, so chunk boundaries are exercised
+std::vector<uint8_t> WritePNG(uint32_t width, uint32_t height, uint8_t bitDepth, uint8_t colorType, uint8_t interlace, const std::vector<uint8_t>& palette, const std::vector<uint8_t>& transparency, const std::vector<uint8_t>& filtered);
@@ -1,5 +1,69 @@
 #include "record.h"
+#include "content_hash.h"
+#include "field_hash.h"
 #include <cstring>
+#include <cwchar>
+#include <iterator>
+
+//Saved fields, in the order of s_Fields
+enum class RecordField {
+   NAME = 0,
+   ICON_TYPE,
+   FOOD_TYPE,
+   DOSE_INTEGER,
+   HAS_FRACTIONAL,
+   DOSE_NUMERATOR,
+   DOSE_DENOMINATOR,
+   HAS_END_DATE,
+   END_DATE_YEAR,
+   END_DATE_MONTH,
+   END_DATE_DAY,
+   TAKING_DAY_TYPE,
+   START_DATE_YEAR,
+   START_DATE_MONTH,
+   START_DATE_DAY,
+   TAKING_DAY_PERIOD,
+   TAKING_TIME_TYPE,
+   FIRST_HOUR,
+   SECOND_HOUR
+};
+
+static constexpr SaveColumn s_Fields[] = {
+   {"name", SaveColumnType::STRING},
+   {"iconType", SaveColumnType::UINT8},
+   {"foodType", SaveColumnType::UINT8},
+   {"doseInteger", SaveColumnType::UINT8},
+   {"hasFractional", SaveColumnType::UINT8},
+   {"doseNumerator", SaveColumnType::UINT8},
+   {"doseDenominator", SaveColumnType::UINT8},
+   {"hasEndDate", SaveColumnType::UINT8},
+   {"endDateYear", SaveColumnType::INT32},
+   {"endDateMonth", SaveColumnType::UINT8},
+   {"endDateDay", SaveColumnType::UINT8},
+   {"takingDayType", SaveColumnType::UINT8},
+   {"startDateYear", SaveColumnType::INT32},
+   {"startDateMonth", SaveColumnType::UINT8},
+   {"startDateDay", SaveColumnType::UINT8},
+   {"takingDayPeriod", SaveColumnType::INT32},
+   {"takingTimeType", SaveColumnType::UINT8},
+   {"firstHour", SaveColumnType::UINT8},
+   {"secondHour", SaveColumnType::UINT8}
+};
+
+static constexpr FieldHash s_FieldHash(s_Fields);
+
+static constexpr size_t GetSlotDataSize() {
+   size_t size = 0;
+   for (const SaveColumn& field : s_Fields) {
+      size += field.type == SaveColumnType::STRING ? NAME_SIZE * 2 : field.type == SaveColumnType::INT32 ? 4 : 1;
+   }
+   return size;
+}
+
+static_assert(GetSlotDataSize() <= RECORD_SLOT_DATA_SIZE, "Record fields don't fit in a record store slot");
+
+static void SetNumber(Record& record, RecordField field, int number);
+static int GetNumber(const Record& record, RecordField field);
 
 const wchar_t* RecordErrorTypeToString(RecordErrorType error) {
    switch (error) {
@@ -149,8 +213,7 @@ void Record::Save(Serializer& serializer, const wchar_t* prefix) {
    wchar_t buffer[256];
 
    auto CreateName = [&](const wchar_t* base) {
-      wcscpy_s(buffer, prefix);
-      wcscat_s(buffer, base);
+      swprintf(buffer, std::size(buffer), L"%ls%ls", prefix, base);
    };
 
    CreateName(VAR_NAME(name));
@@ -211,68 +274,312 @@ void Record::Save(Serializer& serializer, const wchar_t* prefix) {
    serializer.TryWriteChar(buffer, secondHour);
 }
 
-void Record::Load(Serializer& serializer, const wchar_t* prefix) {
-   wchar_t buffer[256];
+bool Record::TryLoadField(std::string_view fieldName, std::string_view value) {
+   int field = s_FieldHash.Find(fieldName);
+   if (field < 0) {
+      return false;
+   }
 
-   auto CreateName = [&](const wchar_t* base) {
-      wcscpy_s(buffer, prefix);
-      wcscat_s(buffer, base);
-   };
+   if ((RecordField) field == RecordField::NAME) {
+      Serializer::ParseString(value, name, NAME_SIZE);
+      return true;
+   }
 
-   CreateName(VAR_NAME(name));
-   serializer.TryReadString(buffer, name, NAME_SIZE);
+   int number;
+   if (!Serializer::TryParseInt(value, &number)) {
+      return false;
+   }
 
-   CreateName(VAR_NAME(iconType));
-   serializer.TryReadInt(buffer, (int*) &iconType);
+   SetNumber(*this, (RecordField) field, number);
+   return true;
+}
 
-   CreateName(VAR_NAME(foodType));
-   serializer.TryReadInt(buffer, (int*) &foodType);
+void Record::BeginSection(BinarySaveWriter& writer, uint32_t recordCount) {
+   writer.BeginSection(RECORDS_SECTION, s_Fields, (uint32_t) std::size(s_Fields), recordCount);
+}
 
-   CreateName(VAR_NAME(doseInteger));
-   serializer.TryReadChar(buffer, (char*) &doseInteger);
+void Record::SaveRow(BinarySaveWriter& writer) const {
+   writer.WriteString(name);
+   writer.WriteNumber((int) iconType);
+   writer.WriteNumber((int) foodType);
+   writer.WriteNumber(doseInteger);
+   writer.WriteNumber(hasFractional);
+   writer.WriteNumber(doseNumerator);
+   writer.WriteNumber(doseDenominator);
+   writer.WriteNumber(hasEndDate);
+   writer.WriteNumber(endDateYear);
+   writer.WriteNumber(endDateMonth);
+   writer.WriteNumber(endDateDay);
+   writer.WriteNumber((int) takingDayType);
+   writer.WriteNumber(startDateYear);
+   writer.WriteNumber(startDateMonth);
+   writer.WriteNumber(startDateDay);
+   writer.WriteNumber(takingDayPeriod);
+   writer.WriteNumber((int) takingTimeType);
+   writer.WriteNumber(firstHour);
+   writer.WriteNumber(secondHour);
+}
 
-   CreateName(VAR_NAME(hasFractional));
-   serializer.TryReadBool(buffer, &hasFractional);
+//Numbers load into any number field whatever their width, a name stored as a number or the other way round is skipped
+int Record::FindField(const SaveColumn& column) {
+   int field = s_FieldHash.Find(column.name);
+   if (field < 0 || (column.type == SaveColumnType::STRING) != (s_Fields[field].type == SaveColumnType::STRING)) {
+      return -1;
+   }
 
-   CreateName(VAR_NAME(doseNumerator));
-   serializer.TryReadChar(buffer, (char*) &doseNumerator);
+   return field;
+}
 
-   CreateName(VAR_NAME(doseDenominator));
-   serializer.TryReadChar(buffer, (char*) &doseDenominator);
+void Record::LoadField(int field, const SaveValue& value) {
+   if ((RecordField) field == RecordField::NAME) {
+      value.CopyText(name, NAME_SIZE);
+   } else {
+      SetNumber(*this, (RecordField) field, value.number);
+   }
+}
 
-   CreateName(VAR_NAME(hasEndDate));
-   serializer.TryReadBool(buffer, &hasEndDate);
+void Record::WriteSlot(uint8_t* data) const {
+   std::memset(data, 0, RECORD_SLOT_DATA_SIZE);
+
+   size_t pos = 0;
+   for (size_t i = 0; i < std::size(s_Fields); i++) {
+      switch (s_Fields[i].type) {
+         case SaveColumnType::STRING:
+            for (size_t j = 0; j < NAME_SIZE && name[j]; j++) {
+               data[pos + j * 2] = (uint8_t) name[j];
+               data[pos + j * 2 + 1] = (uint8_t) (name[j] >> 8);
+            }
+            pos += NAME_SIZE * 2;
+            break;
+         case SaveColumnType::INT32:
+            {
+               uint32_t number = (uint32_t) GetNumber(*this, (RecordField) i);
+               for (int shift = 0; shift < 32; shift += 8) {
+                  data[pos++] = (uint8_t) (number >> shift);
+               }
+            }
+            break;
+         default:
+            data[pos++] = (uint8_t) GetNumber(*this, (RecordField) i);
+      }
+   }
+}
 
-   CreateName(VAR_NAME(endDateYear));
-   serializer.TryReadInt(buffer, (int*) &endDateYear);
+uint64_t Record::GetContentHash() const {
+   uint8_t data[RECORD_SLOT_DATA_SIZE];
+   WriteSlot(data);
+   return ::GetContentHash(data, sizeof(data));
+}
 
-   CreateName(VAR_NAME(endDateMonth));
-   serializer.TryReadChar(buffer, (char*) &endDateMonth);
+//Goes through LoadField like the binary rows, so a slot holds nothing a binary save couldn't
+void Record::ReadSlot(const uint8_t* data) {
+   size_t pos = 0;
+   for (size_t i = 0; i < std::size(s_Fields); i++) {
+      SaveValue value;
+
+      switch (s_Fields[i].type) {
+         case SaveColumnType::STRING:
+            value.text = data + pos;
+            while (value.textLength < NAME_SIZE && (data[pos + value.textLength * 2] || data[pos + value.textLength * 2 + 1])) {
+               value.textLength++;
+            }
+            pos += NAME_SIZE * 2;
+            break;
+         case SaveColumnType::INT32:
+            value.number = (int) (data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16 | (uint32_t) data[pos + 3] << 24);
+            pos += 4;
+            break;
+         default:
+            value.number = data[pos++];
+      }
+
+      LoadField((int) i, value);
+   }
+}
 
-   CreateName(VAR_NAME(endDateDay));
-   serializer.TryReadChar(buffer, (char*) &endDateDay);
+bool TrySaveRecordList(Serializer& serializer, const wchar_t* file, const std::vector<Record*>& records, SaveFormat format) {
+   if (format == SaveFormat::BINARY) {
+      BinarySaveWriter writer;
+      Record::BeginSection(writer, (uint32_t) records.size());
+      for (const Record* record : records) {
+         record->SaveRow(writer);
+      }
 
-   CreateName(VAR_NAME(takingDayType));
-   serializer.TryReadInt(buffer, (int*) &takingDayType);
+      return serializer.TryWriteBinary(file, writer);
+   }
 
-   CreateName(VAR_NAME(startDateYear));
-   serializer.TryReadInt(buffer, (int*) &startDateYear);
+   serializer.TryOpenForSerialize(file);
 
-   CreateName(VAR_NAME(startDateMonth));
-   serializer.TryReadChar(buffer, (char*) &startDateMonth);
+   int recordsCount = (int) records.size();
+   serializer.WRITE_INT(recordsCount);
 
-   CreateName(VAR_NAME(startDateDay));
-   serializer.TryReadChar(buffer, (char*) &startDateDay);
+   wchar_t prefix[128];
+   for (int i = 0; i < recordsCount; i++) {
+      swprintf(prefix, std::size(prefix), L"record[%d].", i);
+      records[i]->Save(serializer, prefix);
+   }
 
-   CreateName(VAR_NAME(takingDayPeriod));
-   serializer.TryReadInt(buffer, (int*) &takingDayPeriod);
+   return serializer.TryCommit();
+}
 
-   CreateName(VAR_NAME(takingTimeType));
-   serializer.TryReadInt(buffer, (int*) &takingTimeType);
+SaveFormat LoadRecordList(Serializer& serializer, const wchar_t* file, std::vector<Record*>& records) {
+   serializer.TryOpenForDeserialize(file);
+   SaveFormat format = serializer.GetFormat();
+
+   if (format == SaveFormat::BINARY) {
+      //Columns are matched to fields once, rows then go straight into them
+      BinarySaveSection section;
+      if (serializer.GetBinaryReader().TryGetSection(RECORDS_SECTION, section)) {
+         const std::vector<SaveColumn>& columns = section.GetColumns();
+         std::vector<int> fields(columns.size());
+         for (size_t i = 0; i < columns.size(); i++) {
+            fields[i] = Record::FindField(columns[i]);
+         }
+
+         std::vector<SaveValue> values(columns.size());
+         records.reserve(records.size() + section.GetRowCount());
+         while (section.TryReadRow(values.data())) {
+            Record* record = new Record();
+            for (size_t i = 0; i < columns.size(); i++) {
+               if (fields[i] >= 0) {
+                  record->LoadField(fields[i], values[i]);
+               }
+            }
+            records.emplace_back(record);
+         }
+      }
+
+      serializer.Close();
+      return format;
+   }
 
-   CreateName(VAR_NAME(firstHour));
-   serializer.TryReadChar(buffer, (char*) &firstHour);
+   //One pass over the file, recordsCount is written before any record so they all exist by their first field
+   size_t firstIndex = records.size();
+   SerializedField field;
+   while (serializer.TryReadField(field)) {
+      size_t index;
+      std::string_view fieldName;
+      if (Serializer::TrySplitIndexed(field.name, "record[", &index, &fieldName)) {
+         if (index < records.size() - firstIndex) {
+            records[firstIndex + index]->TryLoadField(fieldName, field.value);
+         }
+         continue;
+      }
+
+      int recordsCount = 0;
+      if (field.name == "recordsCount" && records.size() == firstIndex && Serializer::TryParseInt(field.value, &recordsCount)) {
+         records.reserve(firstIndex + recordsCount);
+         for (int i = 0; i < recordsCount; i++) {
+            records.emplace_back(new Record());
+         }
+      }
+   }
 
-   CreateName(VAR_NAME(secondHour));
-   serializer.TryReadChar(buffer, (char*) &secondHour);
+   serializer.Close();
+   return format;
+}
+
+//Numbers are saved as ints whatever the type of the field, the text reads cast them the same way
+static void SetNumber(Record& record, RecordField field, int number) {
+   switch (field) {
+      case RecordField::ICON_TYPE:
+         record.iconType = (IconType) number;
+         break;
+      case RecordField::FOOD_TYPE:
+         record.foodType = (FoodType) number;
+         break;
+      case RecordField::DOSE_INTEGER:
+         record.doseInteger = (unsigned char) number;
+         break;
+      case RecordField::HAS_FRACTIONAL:
+         record.hasFractional = number;
+         break;
+      case RecordField::DOSE_NUMERATOR:
+         record.doseNumerator = (unsigned char) number;
+         break;
+      case RecordField::DOSE_DENOMINATOR:
+         record.doseDenominator = (unsigned char) number;
+         break;
+      case RecordField::HAS_END_DATE:
+         record.hasEndDate = number;
+         break;
+      case RecordField::END_DATE_YEAR:
+         record.endDateYear = (unsigned int) number;
+         break;
+      case RecordField::END_DATE_MONTH:
+         record.endDateMonth = (unsigned char) number;
+         break;
+      case RecordField::END_DATE_DAY:
+         record.endDateDay = (unsigned char) number;
+         break;
+      case RecordField::TAKING_DAY_TYPE:
+         record.takingDayType = (TakingDayType) number;
+         break;
+      case RecordField::START_DATE_YEAR:
+         record.startDateYear = (unsigned int) number;
+         break;
+      case RecordField::START_DATE_MONTH:
+         record.startDateMonth = (unsigned char) number;
+         break;
+      case RecordField::START_DATE_DAY:
+         record.startDateDay = (unsigned char) number;
+         break;
+      case RecordField::TAKING_DAY_PERIOD:
+         record.takingDayPeriod = (unsigned int) number;
+         break;
+      case RecordField::TAKING_TIME_TYPE:
+         record.takingTimeType = (TakingTimeType) number;
+         break;
+      case RecordField::FIRST_HOUR:
+         record.firstHour = (unsigned char) number;
+         break;
+      case RecordField::SECOND_HOUR:
+         record.secondHour = (unsigned char) number;
+         break;
+      default:
+         break;
+   }
+}
+
+static int GetNumber(const Record& record, RecordField field) {
+   switch (field) {
+      case RecordField::ICON_TYPE:
+         return (int) record.iconType;
+      case RecordField::FOOD_TYPE:
+         return (int) record.foodType;
+      case RecordField::DOSE_INTEGER:
+         return record.doseInteger;
+      case RecordField::HAS_FRACTIONAL:
+         return record.hasFractional;
+      case RecordField::DOSE_NUMERATOR:
+         return record.doseNumerator;
+      case RecordField::DOSE_DENOMINATOR:
+         return record.doseDenominator;
+      case RecordField::HAS_END_DATE:
+         return record.hasEndDate;
+      case RecordField::END_DATE_YEAR:
+         return (int) record.endDateYear;
+      case RecordField::END_DATE_MONTH:
+         return record.endDateMonth;
+      case RecordField::END_DATE_DAY:
+         return record.endDateDay;
+      case RecordField::TAKING_DAY_TYPE:
+         return (int) record.takingDayType;
+      case RecordField::START_DATE_YEAR:
+         return (int) record.startDateYear;
+      case RecordField::START_DATE_MONTH:
+         return record.startDateMonth;
+      case RecordField::START_DATE_DAY:
+         return record.startDateDay;
+      case RecordField::TAKING_DAY_PERIOD:
+         return (int) record.takingDayPeriod;
+      case RecordField::TAKING_TIME_TYPE:
+         return (int) record.takingTimeType;
+      case RecordField::FIRST_HOUR:
+         return record.firstHour;
+      case RecordField::SECOND_HOUR:
+         return record.secondHour;
+      default:
+         return 0;
+   }
 }
@@ -2,6 +2,8 @@
 #include <serializer.h>
 
 #define NAME_SIZE 36
+#define RECORDS_SECTION "records"
+#define RECORD_SLOT_DATA_SIZE 112//Record store slots keep room for fields added later
 
 enum class RecordErrorType {
    NONE = 0,
@@ -131,5 +133,30 @@ struct Record {
    Record(const Record& other);
 
    void Save(Serializer& serializer, const wchar_t* prefix);
-   void Load(Serializer& serializer, const wchar_t* prefix);
-};
\ No newline at end of file
+
+   //Sets the field saved under name, false for an unknown name or a value that isn't valid for it
+   bool TryLoadField(std::string_view name, std::string_view value);
+
+   //Binary saves have a section with a column per field and a row per record
+   static void BeginSection(BinarySaveWriter& writer, uint32_t recordCount);
+   void SaveRow(BinarySaveWriter& writer) const;
+
+   //Field for a saved column, -1 when this version has none for it. Files written before or after a field
+   //was added still load, the missing fields keep their defaults
+   static int FindField(const SaveColumn& column);
+   void LoadField(int field, const SaveValue& value);
+
+   //Fixed-size form for the slots of a record store, the fields in column order at their column width.
+   //Names take all NAME_SIZE characters, the rest of RECORD_SLOT_DATA_SIZE is zero
+   void WriteSlot(uint8_t* data) const;
+   void ReadSlot(const uint8_t* data);
+
+   //Hash of the slot form, equal for records that save the same
+   uint64_t GetContentHash() const;
+};
+
+//Writes every record to file in format, false when it couldn't be written and the old file was kept
+bool TrySaveRecordList(Serializer& serializer, const wchar_t* file, const std::vector<Record*>& records, SaveFormat format);
+
+//Appends the records saved in file, in either format. Returns the format the file was in
+SaveFormat LoadRecordList(Serializer& serializer, const wchar_t* file, std::vector<Record*>& records);
\ No newline at end of file
@@ -0,0 +1,519 @@
+#include "record_store.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Slot layout, the record fills the rest
+#define SLOT_STATE 0
+#define SLOT_LINK 4//Order of a live slot, next free slot of a tombstone
+#define SLOT_CHECK 8
+#define SLOT_DATA 16
+
+enum class SlotState {
+   UNUSED = 0,
+   LIVE,
+   TOMBSTONE
+};
+
+static intptr_t OpenFile(const std::filesystem::path& path);
+static void CloseFile(intptr_t file);
+static bool TryGetFileSize(intptr_t file, size_t* size);
+static bool TryResizeFile(intptr_t file, size_t size);
+static bool TryMapFile(intptr_t file, size_t size, intptr_t* mapping, uint8_t** view);
+static void UnmapFile(intptr_t mapping, uint8_t* view, size_t size);
+static bool TryWriteAt(intptr_t file, size_t offset, const uint8_t* data, size_t size);
+static bool TryFlushFile(intptr_t file);
+
+static uint32_t GetCapacity(uint32_t slotCount);
+static void WriteStoreHeader(uint8_t* data, uint32_t slotCount, uint32_t freeHead, uint32_t nextOrder);
+static bool IsStoreHeader(const uint8_t* data, size_t size);
+static uint32_t GetSlotCheck(const uint8_t* slot);
+static void SealSlot(uint8_t* slot);
+static bool IsSealed(const uint8_t* slot);
+static bool IsLiveSlot(const uint8_t* slot);
+static void WriteUInt32LE(uint8_t* out, uint32_t value);
+static uint32_t ReadUInt32LE(const uint8_t* data);
+
+RecordStore::~RecordStore() {
+   Close();
+}
+
+bool RecordStore::TryOpen(const std::filesystem::path& path, std::vector<Record*>& records, std::vector<uint32_t>& slots) {
+   if (!TryMap(path)) {
+      return false;
+   }
+
+   if (m_TombstoneCount >= RECORD_STORE_COMPACT_COUNT && m_TombstoneCount > m_SlotCount - m_TombstoneCount) {
+      Close();
+      if (!TryCompact(path, m_Durability) || !TryMap(path)) {
+         return false;
+      }
+   }
+
+   std::vector<std::pair<uint32_t, uint32_t>> liveSlots;
+   liveSlots.reserve(m_SlotCount - m_TombstoneCount);
+   for (uint32_t i = 0; i < m_SlotCount; i++) {
+      if (IsLive(i)) {
+         liveSlots.emplace_back(ReadUInt32LE(GetSlot(i) + SLOT_LINK), i);
+      }
+   }
+   std::sort(liveSlots.begin(), liveSlots.end());
+
+   records.reserve(records.size() + liveSlots.size());
+   slots.reserve(slots.size() + liveSlots.size());
+   for (const std::pair<uint32_t, uint32_t>& liveSlot : liveSlots) {
+      Record* record = new Record();
+      record->ReadSlot(GetSlot(liveSlot.second) + SLOT_DATA);
+      records.emplace_back(record);
+      slots.emplace_back(liveSlot.second);
+   }
+
+   return true;
+}
+
+bool RecordStore::TryCreate(const std::filesystem::path& path, const std::vector<Record*>& records, std::vector<uint32_t>& slots) {
+   Close();
+   slots.clear();
+
+   if (records.size() >= RECORD_STORE_NO_SLOT / 2) {
+      return false;
+   }
+
+   uint32_t slotCount = (uint32_t) records.size();
+   std::vector<uint8_t> data((size_t) (GetCapacity(slotCount) + 1) * RECORD_STORE_SLOT_SIZE);
+   WriteStoreHeader(data.data(), slotCount, RECORD_STORE_NO_SLOT, slotCount);
+
+   for (uint32_t i = 0; i < slotCount; i++) {
+      uint8_t* slot = data.data() + (size_t) (i + 1) * RECORD_STORE_SLOT_SIZE;
+      WriteUInt32LE(slot + SLOT_STATE, (uint32_t) SlotState::LIVE);
+      WriteUInt32LE(slot + SLOT_LINK, i);
+      records[i]->WriteSlot(slot + SLOT_DATA);
+      SealSlot(slot);
+   }
+
+   if (!TryWriteFileAtomic(path, data.data(), data.size(), m_Durability) || !TryMap(path)) {
+      return false;
+   }
+
+   slots.resize(slotCount);
+   for (uint32_t i = 0; i < slotCount; i++) {
+      slots[i] = i;
+   }
+
+   return true;
+}
+
+void RecordStore::Close() {
+   if (m_View) {
+      UnmapFile(m_Mapping, m_View, m_Size);
+      m_Mapping = 0;
+      m_View = nullptr;
+   }
+
+   if (m_File != -1) {
+      CloseFile(m_File);
+      m_File = -1;
+   }
+
+   m_Size = 0;
+   m_Capacity = 0;
+   m_SlotCount = 0;
+   m_TombstoneCount = 0;
+   m_FreeHead = RECORD_STORE_NO_SLOT;
+   m_NextOrder = 0;
+}
+
+bool RecordStore::TryWrite(uint32_t slot, const Record& record) {
+   if (!IsOpen() || !IsLive(slot)) {
+      return false;
+   }
+
+   uint8_t data[RECORD_STORE_SLOT_SIZE];
+   memcpy(data, GetSlot(slot), sizeof(data));
+   record.WriteSlot(data + SLOT_DATA);
+   SealSlot(data);
+   return TryWriteSlot(slot, data) && TryFlush();
+}
+
+bool RecordStore::TryAdd(const Record& record, uint32_t* slot) {
+   if (!IsOpen() || m_NextOrder == RECORD_STORE_NO_SLOT) {
+      return false;
+   }
+
+   uint32_t index;
+   if (m_FreeHead != RECORD_STORE_NO_SLOT) {
+      index = m_FreeHead;
+      m_FreeHead = ReadUInt32LE(GetSlot(index) + SLOT_LINK);
+      m_TombstoneCount--;
+   } else {
+      if (m_SlotCount == m_Capacity && !TryGrow()) {
+         return false;
+      }
+      index = m_SlotCount++;
+   }
+
+   uint8_t data[RECORD_STORE_SLOT_SIZE] = {};
+   WriteUInt32LE(data + SLOT_STATE, (uint32_t) SlotState::LIVE);
+   WriteUInt32LE(data + SLOT_LINK, m_NextOrder++);
+   record.WriteSlot(data + SLOT_DATA);
+   SealSlot(data);
+
+   *slot = index;
+   return TryWriteSlot(index, data) && TryWriteHeader() && TryFlush();
+}
+
+bool RecordStore::TryDelete(uint32_t slot) {
+   if (!IsOpen() || !IsLive(slot)) {
+      return false;
+   }
+
+   uint8_t data[RECORD_STORE_SLOT_SIZE];
+   memcpy(data, GetSlot(slot), sizeof(data));
+   WriteUInt32LE(data + SLOT_STATE, (uint32_t) SlotState::TOMBSTONE);
+   WriteUInt32LE(data + SLOT_LINK, m_FreeHead);
+   WriteUInt32LE(data + SLOT_CHECK, 0);
+
+   m_FreeHead = slot;
+   m_TombstoneCount++;
+
+   return TryWriteSlot(slot, data) && TryWriteHeader() && TryFlush();
+}
+
+bool RecordStore::TryCompact(const std::filesystem::path& path, SaveDurability durability) {
+   std::ifstream stream(path, std::ios::binary | std::ios::ate);
+   if (!stream.is_open()) {
+      return false;
+   }
+
+   std::streamoff size = stream.tellg();
+   std::vector<uint8_t> data(size > 0 ? (size_t) size : 0);
+   stream.seekg(0, std::ios_base::beg);
+   if (!stream.read((char*) data.data(), data.size()) || !IsStoreHeader(data.data(), data.size())) {
+      return false;
+   }
+   stream.close();
+
+   std::vector<std::pair<uint32_t, uint32_t>> liveSlots;
+   uint32_t capacity = (uint32_t) (data.size() / RECORD_STORE_SLOT_SIZE - 1);
+   for (uint32_t i = 0; i < capacity; i++) {
+      const uint8_t* slot = data.data() + (size_t) (i + 1) * RECORD_STORE_SLOT_SIZE;
+      if (IsLiveSlot(slot)) {
+         liveSlots.emplace_back(ReadUInt32LE(slot + SLOT_LINK), i);
+      }
+   }
+   std::sort(liveSlots.begin(), liveSlots.end());
+
+   uint32_t slotCount = (uint32_t) liveSlots.size();
+   std::vector<uint8_t> compacted((size_t) (GetCapacity(slotCount) + 1) * RECORD_STORE_SLOT_SIZE);
+   WriteStoreHeader(compacted.data(), slotCount, RECORD_STORE_NO_SLOT, slotCount);
+
+   for (uint32_t i = 0; i < slotCount; i++) {
+      uint8_t* slot = compacted.data() + (size_t) (i + 1) * RECORD_STORE_SLOT_SIZE;
+      memcpy(slot, data.data() + (size_t) (liveSlots[i].second + 1) * RECORD_STORE_SLOT_SIZE, RECORD_STORE_SLOT_SIZE);
+      WriteUInt32LE(slot + SLOT_LINK, i);
+      SealSlot(slot);
+   }
+
+   return TryWriteFileAtomic(path, compacted.data(), compacted.size(), durability);
+}
+
+bool RecordStore::TryMap(const std::filesystem::path& path) {
+   Close();
+
+   m_File = OpenFile(path);
+   if (m_File == -1) {
+      return false;
+   }
+
+   if (!TryGetFileSize(m_File, &m_Size) || m_Size % RECORD_STORE_SLOT_SIZE || m_Size / RECORD_STORE_SLOT_SIZE - 1 >= RECORD_STORE_NO_SLOT ||
+      !TryMapFile(m_File, m_Size, &m_Mapping, &m_View) || !IsStoreHeader(m_View, m_Size)) {
+      Close();
+      return false;
+   }
+
+   m_Capacity = (uint32_t) (m_Size / RECORD_STORE_SLOT_SIZE - 1);
+   if (!TryScan()) {
+      Close();
+      return false;
+   }
+
+   return true;
+}
+
+//The file doubles, so adds that run past the end grow it once in a while rather than every time
+bool RecordStore::TryGrow() {
+   if (m_Capacity >= RECORD_STORE_NO_SLOT / 4) {
+      return false;
+   }
+
+   uint32_t capacity = m_Capacity < RECORD_STORE_MIN_CAPACITY ? RECORD_STORE_MIN_CAPACITY : m_Capacity * 2;
+   size_t size = (size_t) (capacity + 1) * RECORD_STORE_SLOT_SIZE;
+
+   UnmapFile(m_Mapping, m_View, m_Size);
+   m_Mapping = 0;
+   m_View = nullptr;
+
+   bool isResized = TryResizeFile(m_File, size);
+   if (isResized) {
+      m_Size = size;
+      m_Capacity = capacity;
+   }
+
+   //A failed resize maps the file as it was
+   if (!TryMapFile(m_File, m_Size, &m_Mapping, &m_View)) {
+      Close();
+      return false;
+   }
+
+   return isResized;
+}
+
+//The header isn't trusted, counts, order and the free list come from the slots themselves.
+//A live slot that fails its check was torn by a crash and becomes a tombstone
+bool RecordStore::TryScan() {
+   m_SlotCount = 0;
+   m_TombstoneCount = 0;
+   m_FreeHead = RECORD_STORE_NO_SLOT;
+   m_NextOrder = 0;
+
+   for (uint32_t i = 0; i < m_Capacity; i++) {
+      const uint8_t* slot = GetSlot(i);
+      if (IsLiveSlot(slot)) {
+         uint32_t order = ReadUInt32LE(slot + SLOT_LINK);
+         m_NextOrder = order >= m_NextOrder ? order + 1 : m_NextOrder;
+         m_SlotCount = i + 1;
+      } else if (ReadUInt32LE(slot + SLOT_STATE) != (uint32_t) SlotState::UNUSED) {
+         m_SlotCount = i + 1;
+      }
+   }
+
+   for (uint32_t i = m_SlotCount; i-- > 0;) {
+      const uint8_t* slot = GetSlot(i);
+      if (IsLiveSlot(slot)) {
+         continue;
+      }
+
+      //Only slots that were torn or linked elsewhere are written, a clean store is left as it is
+      if (ReadUInt32LE(slot + SLOT_STATE) != (uint32_t) SlotState::TOMBSTONE || ReadUInt32LE(slot + SLOT_LINK) != m_FreeHead) {
+         uint8_t data[RECORD_STORE_SLOT_SIZE];
+         memcpy(data, slot, sizeof(data));
+         WriteUInt32LE(data + SLOT_STATE, (uint32_t) SlotState::TOMBSTONE);
+         WriteUInt32LE(data + SLOT_LINK, m_FreeHead);
+         WriteUInt32LE(data + SLOT_CHECK, 0);
+
+         if (!TryWriteSlot(i, data)) {
+            return false;
+         }
+      }
+
+      m_FreeHead = i;
+      m_TombstoneCount++;
+   }
+
+   return TryWriteHeader();
+}
+
+bool RecordStore::IsLive(uint32_t slot) {
+   return slot < m_SlotCount && IsLiveSlot(GetSlot(slot));
+}
+
+//Writes go through the file rather than the view, the view shares its pages with the file cache so it sees them right away.
+//Flushing a few written bytes of the file costs the same at any file size, flushing pages dirtied through a view doesn't
+bool RecordStore::TryWriteSlot(uint32_t slot, const uint8_t* data) {
+   return TryWriteAt(m_File, (size_t) (slot + 1) * RECORD_STORE_SLOT_SIZE, data, RECORD_STORE_SLOT_SIZE);
+}
+
+bool RecordStore::TryWriteHeader() {
+   uint8_t header[RECORD_STORE_SLOT_SIZE] = {};
+   WriteStoreHeader(header, m_SlotCount, m_FreeHead, m_NextOrder);
+   return TryWriteAt(m_File, 0, header, sizeof(header));
+}
+
+bool RecordStore::TryFlush() {
+   return m_Durability == SaveDurability::NONE || TryFlushFile(m_File);
+}
+
+//Room for a quarter more records than there are before the file has to grow
+static uint32_t GetCapacity(uint32_t slotCount) {
+   uint32_t capacity = slotCount + slotCount / 4;
+   return capacity < RECORD_STORE_MIN_CAPACITY ? RECORD_STORE_MIN_CAPACITY : capacity;
+}
+
+static void WriteStoreHeader(uint8_t* data, uint32_t slotCount, uint32_t freeHead, uint32_t nextOrder) {
+   WriteUInt32LE(data, RECORD_STORE_MAGIC);
+   WriteUInt32LE(data + 4, RECORD_STORE_VERSION);
+   WriteUInt32LE(data + 8, RECORD_STORE_SLOT_SIZE);
+   WriteUInt32LE(data + 12, slotCount);
+   WriteUInt32LE(data + 16, freeHead);
+   WriteUInt32LE(data + 20, nextOrder);
+}
+
+static bool IsStoreHeader(const uint8_t* data, size_t size) {
+   return size >= RECORD_STORE_SLOT_SIZE && size % RECORD_STORE_SLOT_SIZE == 0 && ReadUInt32LE(data) == RECORD_STORE_MAGIC &&
+      ReadUInt32LE(data + 4) == RECORD_STORE_VERSION && ReadUInt32LE(data + 8) == RECORD_STORE_SLOT_SIZE;
+}
+
+//FNV-1a of everything but the check itself
+static uint32_t GetSlotCheck(const uint8_t* slot) {
+   uint32_t hash = 2166136261u;
+   for (size_t i = 0; i < RECORD_STORE_SLOT_SIZE; i++) {
+      if (i < SLOT_CHECK || i >= SLOT_CHECK + 4) {
+         hash = (hash ^ slot[i]) * 16777619u;
+      }
+   }
+   return hash;
+}
+
+static void SealSlot(uint8_t* slot) {
+   WriteUInt32LE(slot + SLOT_CHECK, GetSlotCheck(slot));
+}
+
+static bool IsSealed(const uint8_t* slot) {
+   return ReadUInt32LE(slot + SLOT_CHECK) == GetSlotCheck(slot);
+}
+
+static bool IsLiveSlot(const uint8_t* slot) {
+   return ReadUInt32LE(slot + SLOT_STATE) == (uint32_t) SlotState::LIVE && IsSealed(slot);
+}
+
+static void WriteUInt32LE(uint8_t* out, uint32_t value) {
+   for (int i = 0; i < 4; i++) {
+      out[i] = (uint8_t) (value >> i * 8);
+   }
+}
+
+static uint32_t ReadUInt32LE(const uint8_t* data) {
+   return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+#ifdef _WIN32
+
+static intptr_t OpenFile(const std::filesystem::path& path) {
+   HANDLE file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   return file == INVALID_HANDLE_VALUE ? -1 : (intptr_t) file;
+}
+
+static void CloseFile(intptr_t file) {
+   CloseHandle((HANDLE) file);
+}
+
+static bool TryGetFileSize(intptr_t file, size_t* size) {
+   LARGE_INTEGER fileSize;
+   if (!GetFileSizeEx((HANDLE) file, &fileSize)) {
+      return false;
+   }
+
+   *size = (size_t) fileSize.QuadPart;
+   return true;
+}
+
+static bool TryResizeFile(intptr_t file, size_t size) {
+   LARGE_INTEGER pos;
+   pos.QuadPart = (LONGLONG) size;
+   return SetFilePointerEx((HANDLE) file, pos, nullptr, FILE_BEGIN) && SetEndOfFile((HANDLE) file);
+}
+
+static bool TryMapFile(intptr_t file, size_t size, intptr_t* mapping, uint8_t** view) {
+   HANDLE fileMapping = CreateFileMapping((HANDLE) file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+   if (!fileMapping) {
+      return false;
+   }
+
+   *view = (uint8_t*) MapViewOfFile(fileMapping, FILE_MAP_WRITE, 0, 0, size);
+   if (!*view) {
+      CloseHandle(fileMapping);
+      return false;
+   }
+
+   *mapping = (intptr_t) fileMapping;
+   return true;
+}
+
+static void UnmapFile(intptr_t mapping, uint8_t* view, size_t /*size*/) {
+   UnmapViewOfFile(view);
+   CloseHandle((HANDLE) mapping);
+}
+
+static bool TryWriteAt(intptr_t file, size_t offset, const uint8_t* data, size_t size) {
+   OVERLAPPED overlapped{};
+   overlapped.Offset = (DWORD) offset;
+   overlapped.OffsetHigh = (DWORD) ((uint64_t) offset >> 32);
+
+   DWORD written;
+   return WriteFile((HANDLE) file, data, (DWORD) size, &written, &overlapped) && written == size;
+}
+
+static bool TryFlushFile(intptr_t file) {
+   return FlushFileBuffers((HANDLE) file);
+}
+
+#else
+
+static intptr_t OpenFile(const std::filesystem::path& path) {
+   return open(path.c_str(), O_RDWR);
+}
+
+static void CloseFile(intptr_t file) {
+   close((int) file);
+}
+
+static bool TryGetFileSize(intptr_t file, size_t* size) {
+   struct stat info;
+   if (fstat((int) file, &info)) {
+      return false;
+   }
+
+   *size = (size_t) info.st_size;
+   return true;
+}
+
+static bool TryResizeFile(intptr_t file, size_t size) {
+   return !ftruncate((int) file, (off_t) size);
+}
+
+static bool TryMapFile(intptr_t file, size_t size, intptr_t* mapping, uint8_t** view) {
+   void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, (int) file, 0);
+   if (address == MAP_FAILED) {
+      return false;
+   }
+
+   *view = (uint8_t*) address;
+   *mapping = 0;
+   return true;
+}
+
+static void UnmapFile(intptr_t /*mapping*/, uint8_t* view, size_t size) {
+   munmap(view, size);
+}
+
+static bool TryWriteAt(intptr_t file, size_t offset, const uint8_t* data, size_t size) {
+   while (size) {
+      ssize_t written = pwrite((int) file, data, size, (off_t) offset);
+      if (written <= 0) {
+         return false;
+      }
+
+      data += written;
+      offset += (size_t) written;
+      size -= (size_t) written;
+   }
+
+   return true;
+}
+
+//Skips the times but not the size, so a slot written past the old end after a grow is flushed with it
+static bool TryFlushFile(intptr_t file) {
+   return !fdatasync((int) file);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#pragma once
+#include "atomic_file.h"
+#include "record.h"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#define RECORD_STORE_MAGIC 0x53525044//"DPRS"
+#define RECORD_STORE_VERSION 1
+#define RECORD_STORE_SLOT_SIZE 128//The header takes the first slot, so no slot straddles a 512 byte sector
+#define RECORD_STORE_NO_SLOT UINT32_MAX
+#define RECORD_STORE_MIN_CAPACITY 64
+#define RECORD_STORE_COMPACT_COUNT 64//Tombstones compacted on open once there are this many and they outnumber live records
+
+static_assert(RECORD_STORE_SLOT_SIZE - 16 >= RECORD_SLOT_DATA_SIZE, "A record doesn't fit in a record store slot");
+
+//Records file of fixed-size slots, mapped into memory for reading. Every slot is live, a tombstone on the free list or not used yet,
+//so an edit, an add or a delete writes one slot and the header whatever the number of records.
+//Live slots keep the order they were added in, records load in that order wherever their slots are
+class RecordStore {
+public:
+
+   RecordStore() = default;
+   ~RecordStore();
+
+   RecordStore(const RecordStore&) = delete;
+   RecordStore& operator=(const RecordStore&) = delete;
+
+   //Maps the store at path, appends its live records to records and the slot of each to slots.
+   //False when there's no store at path or it isn't one. A store of mostly tombstones is compacted first
+   bool TryOpen(const std::filesystem::path& path, std::vector<Record*>& records, std::vector<uint32_t>& slots);
+
+   //Replaces the store at path with records in one atomic write and maps it, record i goes to slot i
+   bool TryCreate(const std::filesystem::path& path, const std::vector<Record*>& records, std::vector<uint32_t>& slots);
+
+   void Close();
+
+   bool IsOpen() const {
+      return m_View != nullptr;
+   }
+
+   //NONE leaves slot writes to the OS cache, any other level flushes the slot and the header before returning
+   void SetDurability(SaveDurability durability) {
+      m_Durability = durability;
+   }
+
+   //Rewrites the live slot in place
+   bool TryWrite(uint32_t slot, const Record& record);
+
+   //Takes the first slot of the free list, or the next unused one after growing the file when it's full
+   bool TryAdd(const Record& record, uint32_t* slot);
+
+   //Leaves a tombstone in the slot and puts it on the free list
+   bool TryDelete(uint32_t slot);
+
+   //Rewrites the store at path with only its live slots, in order. Slot numbers change, so nothing may have it open
+   static bool TryCompact(const std::filesystem::path& path, SaveDurability durability);
+
+   uint32_t GetSlotCount() const {
+      return m_SlotCount;
+   }
+
+   uint32_t GetTombstoneCount() const {
+      return m_TombstoneCount;
+   }
+
+   //Size the file takes, unused slots included
+   size_t GetFileSize() const {
+      return m_Size;
+   }
+
+private:
+
+   intptr_t m_File = -1;//HANDLE on Windows, a descriptor elsewhere
+   intptr_t m_Mapping = 0;//File mapping HANDLE, Windows only
+   uint8_t* m_View = nullptr;
+   size_t m_Size = 0;
+
+   uint32_t m_Capacity = 0;
+   uint32_t m_SlotCount = 0;//Slots live or dead, the rest are unused
+   uint32_t m_TombstoneCount = 0;
+   uint32_t m_FreeHead = RECORD_STORE_NO_SLOT;
+   uint32_t m_NextOrder = 0;
+
+   SaveDurability m_Durability = SaveDurability::FLUSH_FILE;
+
+   bool TryMap(const std::filesystem::path& path);
+   bool TryGrow();
+   bool TryScan();
+
+   uint8_t* GetSlot(uint32_t slot) {
+      return m_View + (size_t) (slot + 1) * RECORD_STORE_SLOT_SIZE;
+   }
+
+   bool IsLive(uint32_t slot);
+   bool TryWriteSlot(uint32_t slot, const uint8_t* data);
+   bool TryWriteHeader();
+   bool TryFlush();
+
+};
@@ -0,0 +1,188 @@
+#include "save_worker.h"
+#include <utility>
+
+const wchar_t* SaveStreamToString(SaveStream stream) {
+   switch (stream) {
+      case SaveStream::SETTINGS:
+         return L"Settings";
+      case SaveStream::RECORDS:
+         return L"Records";
+      case SaveStream::STATE:
+         return L"State";
+      default:
+         return L"Can't convert SaveStream to string";
+   }
+}
+
+SaveWorker::~SaveWorker() {
+   Stop();
+}
+
+void SaveWorker::SetFailedCallback(const SaveFailedCallback& onFailed) {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   m_OnFailed = onFailed;
+}
+
+void SaveWorker::SetDurability(SaveDurability durability) {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   m_Durability = durability;
+}
+
+void SaveWorker::PostSnapshot(SaveStream stream, SaveJob job) {
+   QueuedSave save;
+   save.stream = stream;
+   save.isSnapshot = true;
+   save.job = std::move(job);
+   Post(std::move(save));
+}
+
+void SaveWorker::PostChange(SaveStream stream, SaveJob job) {
+   QueuedSave save;
+   save.stream = stream;
+   save.job = std::move(job);
+   Post(std::move(save));
+}
+
+void SaveWorker::Flush() {
+   std::unique_lock<std::mutex> lock(m_Mutex);
+   m_SavesDone.wait(lock, [this]() { return m_Saves.empty() && !m_IsWriting; });
+}
+
+void SaveWorker::Stop() {
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_IsStopping = true;
+   }
+
+   m_SaveAdded.notify_all();
+
+   if (m_Thread.joinable()) {
+      m_Thread.join();
+   }
+
+   m_IsStopping = false;
+}
+
+SaveWorkerStats SaveWorker::GetStats() {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   return m_Stats;
+}
+
+void SaveWorker::AddPostTime(double milliseconds) {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   m_Stats.postMilliseconds += milliseconds;
+}
+
+void SaveWorker::AddSkipped(size_t bytes) {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   m_Stats.skipCount++;
+   m_Stats.skippedBytes += bytes;
+}
+
+void SaveWorker::AddSkippedFile(const std::filesystem::path& file) {
+   std::error_code error;
+   uintmax_t size = std::filesystem::file_size(file, error);
+   AddSkipped(error ? 0 : (size_t) size);
+}
+
+//A snapshot goes where the first waiting job of its stream was, so it's written no later than that job would have been
+void SaveWorker::Post(QueuedSave save) {
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Stats.postCount++;
+
+      std::deque<QueuedSave>::iterator place = m_Saves.end();
+      if (save.isSnapshot) {
+         for (std::deque<QueuedSave>::iterator it = m_Saves.begin(); it != m_Saves.end();) {
+            if (it->stream != save.stream) {
+               it++;
+            } else if (place == m_Saves.end()) {
+               place = it++;
+               m_Stats.coalescedCount++;
+            } else {
+               it = m_Saves.erase(it);
+               m_Stats.coalescedCount++;
+            }
+         }
+      }
+
+      if (place != m_Saves.end()) {
+         *place = std::move(save);
+      } else {
+         m_Saves.emplace_back(std::move(save));
+      }
+
+      if (!m_Thread.joinable()) {
+         m_Thread = std::thread(&SaveWorker::Run, this);
+      }
+   }
+
+   m_SaveAdded.notify_all();
+}
+
+//Drains the queue even when stopping, every posted save is written
+void SaveWorker::Run() {
+   Serializer serializer;
+
+   while (true) {
+      QueuedSave save;
+      bool isSkipped;
+
+      {
+         std::unique_lock<std::mutex> lock(m_Mutex);
+         m_SaveAdded.wait(lock, [this]() { return m_IsStopping || !m_Saves.empty(); });
+
+         if (m_Saves.empty()) {
+            return;
+         }
+
+         save = std::move(m_Saves.front());
+         m_Saves.pop_front();
+         m_IsWriting = true;
+
+         isSkipped = !save.isSnapshot && m_IsFailing[(int) save.stream];
+         serializer.SetDurability(m_Durability);
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      bool isWritten = !isSkipped && save.job(serializer);
+      double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+      //The job is destroyed outside the lock, it may own a lot of data
+      save.job = nullptr;
+
+      SaveFailedCallback onFailed;
+      bool isReported = false;
+
+      {
+         std::lock_guard<std::mutex> lock(m_Mutex);
+         m_IsWriting = false;
+
+         int stream = (int) save.stream;
+         if (isWritten) {
+            if (save.isSnapshot) {
+               m_IsFailing[stream] = false;
+               m_IsSnapshotFailing[stream] = false;
+            }
+         } else {
+            isReported = !save.isSnapshot || !m_IsSnapshotFailing[stream];
+            m_IsFailing[stream] = true;
+            m_IsSnapshotFailing[stream] = m_IsSnapshotFailing[stream] || save.isSnapshot;
+            m_Stats.failCount++;
+         }
+
+         if (!isSkipped) {
+            m_Stats.writeCount++;
+            m_Stats.writeMilliseconds += milliseconds;
+         }
+
+         onFailed = m_OnFailed;
+      }
+
+      m_SavesDone.notify_all();
+
+      if (isReported && onFailed) {
+         onFailed(save.stream, save.isSnapshot);
+      }
+   }
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "serializer.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+enum class SaveStream {
+   SETTINGS = 0,
+   RECORDS,
+   STATE,
+
+   //Iteration helpers
+   count,
+   begin = 0,
+   end = count - 1
+};
+
+const wchar_t* SaveStreamToString(SaveStream stream);
+
+//Writes files of one stream from data it holds, false when it couldn't. Runs on the worker thread with the serializer of the worker
+typedef std::function<bool(Serializer& serializer)> SaveJob;
+
+//Runs on the worker thread once a job failed. A failed snapshot is reported once until one of its stream is written again
+typedef std::function<void(SaveStream stream, bool isSnapshot)> SaveFailedCallback;
+
+//Instrumentation
+struct SaveWorkerStats {
+   uint32_t postCount = 0;
+   uint32_t writeCount = 0;//Jobs that ran
+   uint32_t coalescedCount = 0;//Jobs a later snapshot of their stream made unneeded before they ran
+   uint32_t failCount = 0;
+   uint32_t skipCount = 0;//Saves not posted because nothing they would write had changed
+   uint64_t skippedBytes = 0;//What those saves would have written
+   double postMilliseconds = 0;//UI thread, building the data of saves and posting them
+   double writeMilliseconds = 0;//Worker thread
+};
+
+//Thread that writes saves in the order they were posted, so a slow disk never holds up the message loop.
+//Jobs carry their own copy of what they write. A snapshot holds a whole stream, so it takes the place of every job of
+//its stream still waiting. A change only makes sense on top of what was written before it, so once a job of a stream
+//fails its later changes are dropped and reported until a snapshot of the stream is written
+class SaveWorker {
+public:
+
+   SaveWorker() = default;
+   ~SaveWorker();
+
+   SaveWorker(const SaveWorker&) = delete;
+   SaveWorker& operator=(const SaveWorker&) = delete;
+
+   void SetFailedCallback(const SaveFailedCallback& onFailed);
+
+   //Durability of the serializer jobs get
+   void SetDurability(SaveDurability durability);
+
+   void PostSnapshot(SaveStream stream, SaveJob job);
+   void PostChange(SaveStream stream, SaveJob job);
+
+   //Returns once every job posted so far has run
+   void Flush();
+
+   //Flushes and ends the thread, a later post starts it again
+   void Stop();
+
+   SaveWorkerStats GetStats();
+
+   void AddPostTime(double milliseconds);
+
+   //A save that wasn't posted because it would write what's already there
+   void AddSkipped(size_t bytes);
+   //Same for a save that would have replaced file, counted at the size file has
+   void AddSkippedFile(const std::filesystem::path& file);
+
+private:
+
+   struct QueuedSave {
+      SaveStream stream = SaveStream::STATE;
+      bool isSnapshot = false;
+      SaveJob job;
+   };
+
+   std::thread m_Thread;
+   std::deque<QueuedSave> m_Saves;
+   std::mutex m_Mutex;
+   std::condition_variable m_SaveAdded;
+   std::condition_variable m_SavesDone;
+   bool m_IsWriting = false;
+   bool m_IsStopping = false;
+
+   SaveFailedCallback m_OnFailed;
+   SaveDurability m_Durability = SaveDurability::FLUSH_FILE;
+
+   bool m_IsFailing[(int) SaveStream::count] = {};
+   bool m_IsSnapshotFailing[(int) SaveStream::count] = {};
+
+   SaveWorkerStats m_Stats;
+
+private:
+
+   void Post(QueuedSave save);
+   void Run();
+};
+
+//Adds the time from its creation to its destruction to the post time of worker
+class SavePostTimer {
+public:
+
+   explicit SavePostTimer(SaveWorker* worker) : m_Worker(worker), m_Start(std::chrono::steady_clock::now()) {
+   }
+
+   ~SavePostTimer() {
+      m_Worker->AddPostTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_Start).count());
+   }
+
+   SavePostTimer(const SavePostTimer&) = delete;
+   SavePostTimer& operator=(const SavePostTimer&) = delete;
+
+private:
+
+   SaveWorker* m_Worker;
+   std::chrono::steady_clock::time_point m_Start;
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define CACHE_LINE_SIZE 64
+
+//Lock-free ring of fixed size slots between exactly one producer thread and one consumer thread.
+//Each side owns one counter and only reads the other, the counters sit on separate cache lines
+struct ScanlineRing {
+   //Not thread safe, call before both sides start. slotCount should be a power of two,
+   //slots holds slotSize * slotCount bytes and is owned by the caller
+   void Reset(uint8_t* slots, size_t slotSize, uint32_t slotCount) {
+      this->slots = slots;
+      this->slotSize = slotSize;
+      mask = slotCount - 1;
+      writeCount.store(0, std::memory_order_relaxed);
+      readCount.store(0, std::memory_order_relaxed);
+      cachedReadCount = 0;
+      cachedWriteCount = 0;
+      isClosed.store(false, std::memory_order_relaxed);
+      isCancelled.store(false, std::memory_order_relaxed);
+   }
+
+   //Producer side. Returns nullptr while the ring is full
+   uint8_t* TryBeginWrite() {
+      uint32_t count = writeCount.load(std::memory_order_relaxed);
+      if (count - cachedReadCount > mask) {
+         cachedReadCount = readCount.load(std::memory_order_acquire);
+         if (count - cachedReadCount > mask) {
+            return nullptr;
+         }
+      }
+
+      return slots + (count & mask) * slotSize;
+   }
+
+   void EndWrite() {
+      writeCount.store(writeCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+   }
+
+   //Consumer side. Returns nullptr while the ring is empty
+   const uint8_t* TryBeginRead() {
+      uint32_t count = readCount.load(std::memory_order_relaxed);
+      if (count == cachedWriteCount) {
+         cachedWriteCount = writeCount.load(std::memory_order_acquire);
+         if (count == cachedWriteCount) {
+            return nullptr;
+         }
+      }
+
+      return slots + (count & mask) * slotSize;
+   }
+
+   void EndRead() {
+      readCount.store(readCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+   }
+
+   //The producer will write nothing more
+   void Close() {
+      isClosed.store(true, std::memory_order_release);
+   }
+
+   bool IsClosed() const {
+      return isClosed.load(std::memory_order_acquire);
+   }
+
+   //The consumer will read nothing more
+   void Cancel() {
+      isCancelled.store(true, std::memory_order_release);
+   }
+
+   bool IsCancelled() const {
+      return isCancelled.load(std::memory_order_acquire);
+   }
+
+private:
+
+   uint8_t* slots = nullptr;
+   size_t slotSize = 0;
+   uint32_t mask = 0;
+
+   alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> writeCount{0};
+   uint32_t cachedReadCount = 0;//Producer's last look at readCount
+
+   alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> readCount{0};
+   uint32_t cachedWriteCount = 0;//Consumer's last look at writeCount
+
+   alignas(CACHE_LINE_SIZE) std::atomic<bool> isClosed{false};
+   std::atomic<bool> isCancelled{false};
+};
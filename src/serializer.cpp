@@ -1,244 +1,315 @@
 #include "serializer.h"
+#include <charconv>
+#include <climits>
+#include <cstring>
 #include <cwchar>
 
-static const int BUFFER_SIZE = 256;
-
 Serializer::~Serializer() {
    Close();
 }
 
+//Nothing touches the file until TryCommit, the old one stays whole while fields are written
 bool Serializer::TryOpenForSerialize(const wchar_t* file) {
-   std::filesystem::path fullPath = file;
-   CheckExisting(&fullPath);
-
    Close();
 
-   m_SerializeStream = new std::wofstream(fullPath);
+   m_SerializePath = file;
+   m_IsSerializing = true;
+   return true;
+}
+
+bool Serializer::TryCommit() {
+   if (!m_IsSerializing) {
+      return false;
+   }
+
+   m_IsSerializing = false;
+   bool isWritten = TryWriteFileAtomic(m_SerializePath, m_SerializeData.data(), m_SerializeData.size(), m_Durability);
+   m_SerializeData.clear();
+   return isWritten;
+}
 
-   if (m_SerializeStream->is_open()) {
-      return true;
-   } else {
-      Close();
+bool Serializer::TryTakeSerialized(std::vector<uint8_t>& data) {
+   if (!m_IsSerializing) {
       return false;
    }
+
+   m_IsSerializing = false;
+   data.assign(m_SerializeData.begin(), m_SerializeData.end());
+   m_SerializeData.clear();
+   return true;
 }
 
+//Reads the whole file at once, fields are only views into it
 bool Serializer::TryOpenForDeserialize(const wchar_t* file) {
    std::filesystem::path fullPath = file;
    CheckExisting(&fullPath);
 
    Close();
 
-   m_DeserializeStream = new std::wifstream(fullPath);
-
-   if (m_DeserializeStream->is_open()) {
-      CollectDeserializeMap();
-      return true;
-   } else {
-      Close();
+   std::ifstream stream(fullPath, std::ios::binary | std::ios::ate);
+   if (!stream.is_open()) {
       return false;
    }
+
+   std::streamoff size = stream.tellg();
+   if (size > 0) {
+      m_DeserializeData.resize((size_t) size);
+      stream.seekg(0, std::ios_base::beg);
+      if (!stream.read(m_DeserializeData.data(), size)) {
+         m_DeserializeData.clear();
+         return false;
+      }
+
+      const uint8_t* data = (const uint8_t*) m_DeserializeData.data();
+      if (IsBinarySave(data, m_DeserializeData.size())) {
+         m_Format = SaveFormat::BINARY;
+         m_BinaryReader.TryOpen(data, m_DeserializeData.size());
+      } else {
+         m_Format = SaveFormat::TEXT;
+      }
+   }
+
+   return true;
 }
 
 void Serializer::Close() {
-   if (m_SerializeStream) {
-      m_SerializeStream->close();
-      delete m_SerializeStream;
-      m_SerializeStream = nullptr;
+   if (m_IsSerializing) {
+      TryCommit();
    }
-   
-   if (m_DeserializeStream) {
-      m_DeserializeStream->close();
-      delete m_DeserializeStream;
-      m_DeserializeStream = nullptr;
 
-      m_DeserializeMap.clear();
-   }
+   m_DeserializeData.clear();
+   m_ReadPos = 0;
+   m_Format = SAVE_FORMAT;
+   m_BinaryReader.Close();
+   m_Fields.clear();
+   m_AreFieldsCollected = false;
+   m_FindPos = 0;
 }
 
 void Serializer::TryWriteInt(const wchar_t* name, int value) {
-   if (!m_SerializeStream || !m_SerializeStream->is_open()) {
+   if (!m_IsSerializing) {
       return;
    }
 
-   WriteNameValue(name, std::to_wstring(value).c_str());
+   WriteNameNumber(name, value);
 }
 
 void Serializer::TryWriteChar(const wchar_t* name, char value) {
-   if (!m_SerializeStream || !m_SerializeStream->is_open()) {
+   if (!m_IsSerializing) {
       return;
    }
 
-   WriteNameValue(name, std::to_wstring(value).c_str());
+   WriteNameNumber(name, value);
 }
 
 void Serializer::TryWriteBool(const wchar_t* name, bool value) {
-   if (!m_SerializeStream || !m_SerializeStream->is_open()) {
+   if (!m_IsSerializing) {
       return;
    }
 
-   WriteNameValue(name, std::to_wstring(value).c_str());
+   WriteNameNumber(name, value);
 }
 
 void Serializer::TryWriteString(const wchar_t* name, const wchar_t* value) {
-   if (!m_SerializeStream || !m_SerializeStream->is_open()) {
+   if (!m_IsSerializing) {
       return;
    }
 
-   WriteNameValue(name, value);
+   AppendText(name);
+   m_SerializeData += " = ";
+   AppendText(value);
+   m_SerializeData += '\n';
 }
 
 void Serializer::TryReadInt(const wchar_t* name, int* value) {
-   if (m_DeserializeMap.empty() || !m_DeserializeMap.count(name)) {
-      return;
-   }
-
-   if (IsNumber(m_DeserializeMap[name])) {
-      *value = std::stoi(m_DeserializeMap[name]);
+   if (const SerializedField* field = TryFindField(name)) {
+      TryParseInt(field->value, value);
    }
 }
 
 void Serializer::TryReadChar(const wchar_t* name, char* value) {
-   if (m_DeserializeMap.empty() || !m_DeserializeMap.count(name)) {
-      return;
-   }
-
-   if (IsNumber(m_DeserializeMap[name])) {
-      *value = (char)std::stoi(m_DeserializeMap[name]);
+   int number;
+   if (const SerializedField* field = TryFindField(name); field && TryParseInt(field->value, &number)) {
+      *value = (char) number;
    }
 }
 
 void Serializer::TryReadBool(const wchar_t* name, bool* value) {
-   if (m_DeserializeMap.empty() || !m_DeserializeMap.count(name)) {
-      return;
-   }
-
-   if (IsNumber(m_DeserializeMap[name])) {
-      *value = std::stoi(m_DeserializeMap[name]);
+   int number;
+   if (const SerializedField* field = TryFindField(name); field && TryParseInt(field->value, &number)) {
+      *value = number;
    }
 }
 
 void Serializer::TryReadString(const wchar_t* name, wchar_t* value, size_t maxCount) {
-   if (m_DeserializeMap.empty() || !m_DeserializeMap.count(name)) {
-      return;
+   if (const SerializedField* field = TryFindField(name)) {
+      ParseString(field->value, value, maxCount);
    }
-
-   wcscpy_s(value, maxCount, m_DeserializeMap[name].c_str());
 }
 
-void Serializer::CheckExisting(const std::filesystem::path* path) {
-   if (!std::filesystem::is_directory(path->parent_path()) && !path->parent_path().empty()) {
-      std::filesystem::create_directory(path->parent_path());
-   }
+bool Serializer::TryWriteBinary(const wchar_t* file, BinarySaveWriter& writer) {
+   std::filesystem::path fullPath = file;
 
-   if (!std::filesystem::exists(*path)) {
-      std::wofstream tempStream(*path);
+   Close();
+
+   std::vector<uint8_t> data;
+   if (!writer.TryFinish(data)) {
+      return false;
    }
+
+   return TryWriteFileAtomic(fullPath, data.data(), data.size(), m_Durability);
 }
 
-void Serializer::CollectDeserializeMap() {
-   if (!m_DeserializeStream || !m_DeserializeStream->is_open()) {
-      return;
+bool Serializer::TryReadField(SerializedField& field) {
+   if (m_Format == SaveFormat::BINARY) {
+      return false;
    }
 
-   m_DeserializeMap.clear();
+   const char* data = m_DeserializeData.data();
+   size_t size = m_DeserializeData.size();
 
-   wchar_t str[BUFFER_SIZE];
-   while (!m_DeserializeStream->eof()) {
-      m_DeserializeStream->getline(str, BUFFER_SIZE - 1);
-      size_t strLength = m_DeserializeStream->gcount();
-      if (!strLength) {
-         continue;
+   while (m_ReadPos < size) {
+      const char* lineStart = data + m_ReadPos;
+      const char* lineEnd = (const char*) memchr(lineStart, '\n', size - m_ReadPos);
+      if (!lineEnd) {
+         lineEnd = data + size;
       }
+      m_ReadPos = lineEnd - data + 1;
 
-      if (m_DeserializeStream->eof()) {
-         strLength++;
-      }
-
-      wchar_t* equalPos = wcschr(str, L'=');
+      const char* equalPos = (const char*) memchr(lineStart, '=', lineEnd - lineStart);
       if (!equalPos) {
          continue;
       }
 
-      size_t equalIndex = std::distance(str, equalPos);
+      //Spaces around both, and the carriage return of files edited on Windows
+      auto Trim = [](const char* begin, const char* end) {
+         while (begin < end && *begin == ' ') {
+            begin++;
+         }
+         while (end > begin && (end[-1] == ' ' || end[-1] == '\r')) {
+            end--;
+         }
+         return std::string_view(begin, end - begin);
+      };
+
+      field.name = Trim(lineStart, equalPos);
+      field.value = Trim(equalPos + 1, lineEnd);
+      if (!field.name.empty() && !field.value.empty()) {
+         return true;
+      }
+   }
 
-      wchar_t nameBuffer[BUFFER_SIZE];
-      wcsncpy_s(nameBuffer, str, equalIndex);
+   return false;
+}
 
-      wchar_t* newEnd = std::remove(nameBuffer, std::end(nameBuffer), L' ');
-      size_t removedCount = BUFFER_SIZE - std::distance(nameBuffer, newEnd);
-      nameBuffer[equalIndex - removedCount] = L'\0';
+bool Serializer::TryParseInt(std::string_view text, int* value) {
+   if (text.empty()) {
+      return false;
+   }
 
-      if (!wcsnlen_s(nameBuffer, BUFFER_SIZE)) {
-         continue;
+   unsigned int number = 0;
+   for (char c : text) {
+      unsigned int digit = (unsigned int) (c - '0');
+      if (digit > 9 || number > (INT_MAX - digit) / 10) {
+         return false;
       }
+      number = number * 10 + digit;
+   }
 
-      for (int i = 0; i < strLength - equalIndex - 1; i++) {
-         str[i] = str[i + equalIndex + 1];
-      }
+   *value = (int) number;
+   return true;
+}
 
-      strLength = strLength - equalIndex - 1;
+//Files are written through the C locale, so every byte is the character code it stands for
+void Serializer::ParseString(std::string_view text, wchar_t* value, size_t maxCount) {
+   if (!maxCount) {
+      return;
+   }
 
-      if (!strLength) {
-         continue;
-      }
+   size_t count = text.size() < maxCount - 1 ? text.size() : maxCount - 1;
+   for (size_t i = 0; i < count; i++) {
+      value[i] = (wchar_t) (unsigned char) text[i];
+   }
+   value[count] = L'\0';
+}
 
-      wchar_t valueBuffer[BUFFER_SIZE];
-      wcsncpy_s(valueBuffer, str, strLength);
-      valueBuffer[strLength - 1] = L'\0';
+bool Serializer::TrySplitIndexed(std::string_view name, std::string_view prefix, size_t* index, std::string_view* rest) {
+   if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix)) {
+      return false;
+   }
 
-      size_t spaceCount = 0;
-      for (int i = 0; i < strLength; i++) {
-         if (valueBuffer[i] == L' ') {
-            spaceCount++;
-         } else {
-            break;
-         }
-      }
-      for (int i = 0; i < strLength - spaceCount - 1; i++) {
-         valueBuffer[i] = valueBuffer[i + spaceCount];
-      }
+   size_t pos = prefix.size();
+   size_t number = 0;
+   size_t digitsStart = pos;
+   while (pos < name.size() && name[pos] >= '0' && name[pos] <= '9' && pos - digitsStart < 9) {
+      number = number * 10 + (name[pos] - '0');
+      pos++;
+   }
 
-      strLength -= spaceCount;
+   if (pos == digitsStart || name.compare(pos, 2, "].")) {
+      return false;
+   }
 
-      spaceCount = 0;
-      for (int i = strLength - 2; i >= 0; i--) {
-         if (valueBuffer[i] == L' ') {
-            spaceCount++;
-         } else {
-            break;
-         }
-      }
+   *index = number;
+   *rest = name.substr(pos + 2);
+   return true;
+}
 
-      strLength -= spaceCount;
+void Serializer::CheckExisting(const std::filesystem::path* path) {
+   if (!std::filesystem::is_directory(path->parent_path()) && !path->parent_path().empty()) {
+      std::filesystem::create_directory(path->parent_path());
+   }
 
-      if (!strLength) {
-         continue;
-      }
+   if (!std::filesystem::exists(*path)) {
+      std::wofstream tempStream(*path);
+   }
+}
 
-      valueBuffer[strLength - 1] = L'\0';
+//Fields are usually read in the order they were written, so the search starts after the last field found
+const SerializedField* Serializer::TryFindField(const wchar_t* name) {
+   if (!m_AreFieldsCollected) {
+      SerializedField field;
+      while (TryReadField(field)) {
+         m_Fields.emplace_back(field);
+      }
+      m_AreFieldsCollected = true;
+   }
 
-      if (!wcsnlen_s(valueBuffer, BUFFER_SIZE)) {
+   size_t nameLength = wcslen(name);
+   for (size_t i = 0; i < m_Fields.size(); i++) {
+      size_t index = m_FindPos + i < m_Fields.size() ? m_FindPos + i : m_FindPos + i - m_Fields.size();
+      std::string_view fieldName = m_Fields[index].name;
+      if (fieldName.size() != nameLength) {
          continue;
       }
 
-      m_DeserializeMap.insert({nameBuffer, valueBuffer});
-   }
-}
+      size_t j = 0;
+      while (j < nameLength && (wchar_t) (unsigned char) fieldName[j] == name[j]) {
+         j++;
+      }
 
-void Serializer::WriteNameValue(const wchar_t* name, const wchar_t* value) {
-   wchar_t result[BUFFER_SIZE];
+      if (j == nameLength) {
+         m_FindPos = index + 1;
+         return &m_Fields[index];
+      }
+   }
 
-   wcscpy_s(result, BUFFER_SIZE - 1, name);
-   wcscat_s(result, BUFFER_SIZE - 1, L" = ");
-   wcscat_s(result, BUFFER_SIZE - 1, value);
+   return nullptr;
+}
 
-   size_t len = wcslen(result);
-   result[len] = L'\n';
+void Serializer::WriteNameNumber(const wchar_t* name, int value) {
+   char digits[16];
+   std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
 
-   m_SerializeStream->write(result, len + 1);
+   AppendText(name);
+   m_SerializeData += " = ";
+   m_SerializeData.append(digits, result.ptr - digits);
+   m_SerializeData += '\n';
 }
 
-bool Serializer::IsNumber(const std::wstring& s) {
-   return std::find_if(s.begin(), s.end(), [](wchar_t c) { return !std::isdigit(c); }) == s.end();
+//One byte per character like the C locale writes them, ParseString reads them back the same way
+void Serializer::AppendText(const wchar_t* text) {
+   for (; *text; text++) {
+      m_SerializeData += *text < 256 ? (char) *text : '?';
+   }
 }
@@ -1,11 +1,15 @@
 #pragma once
-#include <map>
+#include "atomic_file.h"
+#include "binary_save.h"
 #include <iostream>
 #include <fstream>
 #include "filesystem"
 #include <string>
+#include <string_view>
+#include <vector>
 
-#define VAR_NAME(v) L#v
+#define WIDE_STRING(s) L ## s
+#define VAR_NAME(v) WIDE_STRING(#v)
 
 #define WRITE_INT(var)    TryWriteInt(VAR_NAME(var), var)
 #define WRITE_CHAR(var)   TryWriteChar(VAR_NAME(var), var)
@@ -19,16 +23,50 @@
 #define READ_STRING(var, count) TryReadString(VAR_NAME(var), &var, count)
 #define READ_ENUM(var)          TryReadInt(VAR_NAME(var), (int*)&var)
 
+enum class SaveFormat {
+   TEXT = 0,
+   BINARY
+};
+
+//Format saves are written in. Loading takes either, a file loaded from the other one is rewritten right away
+#ifdef BINARY_SAVES
+const SaveFormat SAVE_FORMAT = SaveFormat::BINARY;
+#else
+const SaveFormat SAVE_FORMAT = SaveFormat::TEXT;
+#endif
+
+//One 'name = value' line of a save file, both point into the file held by the serializer
+struct SerializedField {
+   std::string_view name;
+   std::string_view value;
+};
+
 class Serializer {
 public:
 
    Serializer() = default;
    ~Serializer();
 
+   //Fields are collected in memory, TryCommit or Close replace the file with them at once
    bool TryOpenForSerialize(const wchar_t* file);
    bool TryOpenForDeserialize(const wchar_t* file);
+
+   //Writes the file opened for serializing, false when it couldn't be written and the old one was kept
+   bool TryCommit();
+
+   //Ends serializing without writing anything and hands over what TryCommit would have written
+   bool TryTakeSerialized(std::vector<uint8_t>& data);
    void Close();
 
+   //How far every later save is flushed before it returns
+   void SetDurability(SaveDurability durability) {
+      m_Durability = durability;
+   }
+
+   SaveDurability GetDurability() const {
+      return m_Durability;
+   }
+
    void TryWriteInt(const wchar_t* name, int value);
    void TryWriteChar(const wchar_t* name, char value);
    void TryWriteBool(const wchar_t* name, bool value);
@@ -39,20 +77,53 @@ public:
    void TryReadBool(const wchar_t* name, bool* value);
    void TryReadString(const wchar_t* name, wchar_t* value, size_t maxCount);
 
+   //Writes a finished binary save in place of file, in one write
+   bool TryWriteBinary(const wchar_t* file, BinarySaveWriter& writer);
+
+   //Format of the file opened for deserializing, an empty or missing file counts as SAVE_FORMAT.
+   //Text reads find nothing in a binary file, its sections are read from GetBinaryReader
+   SaveFormat GetFormat() const {
+      return m_Format;
+   }
+
+   const BinarySaveReader& GetBinaryReader() const {
+      return m_BinaryReader;
+   }
+
+   //Next field of the file opened for deserializing, in file order. Lines without a name or a value are skipped
+   bool TryReadField(SerializedField& field);
+
+   //Only digits, as they are written
+   static bool TryParseInt(std::string_view text, int* value);
+   static void ParseString(std::string_view text, wchar_t* value, size_t maxCount);
+
+   //Splits 'record[12].name' into 12 and 'name' for the prefix 'record['
+   static bool TrySplitIndexed(std::string_view name, std::string_view prefix, size_t* index, std::string_view* rest);
+
 private:
 
-   std::wofstream* m_SerializeStream = nullptr;
-   std::wifstream* m_DeserializeStream = nullptr;
+   std::string m_SerializeData{};
+   std::filesystem::path m_SerializePath{};
+   bool m_IsSerializing = false;
+   SaveDurability m_Durability = SaveDurability::FLUSH_FILE;
 
-   std::map<std::wstring, std::wstring> m_DeserializeMap{};
+   //The whole file opened for deserializing, read at once
+   std::vector<char> m_DeserializeData{};
+   size_t m_ReadPos = 0;
+   SaveFormat m_Format = SAVE_FORMAT;
+   BinarySaveReader m_BinaryReader{};
+
+   //Fields for reading by name, tokenized on the first such read
+   std::vector<SerializedField> m_Fields{};
+   bool m_AreFieldsCollected = false;
+   size_t m_FindPos = 0;
 
 private:
 
    void CheckExisting(const std::filesystem::path* path);
 
-   void CollectDeserializeMap();
-
-   void WriteNameValue(const wchar_t* name, const wchar_t* value);
+   const SerializedField* TryFindField(const wchar_t* name);
 
-   bool IsNumber(const std::wstring& s);
+   void WriteNameNumber(const wchar_t* name, int value);
+   void AppendText(const wchar_t* text);
 };
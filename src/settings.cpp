@@ -1,4 +1,38 @@
 #include "settings.h"
+#include "content_hash.h"
+#include "field_hash.h"
+#include <iterator>
+
+//Saved fields, in the order of s_Fields
+enum class SettingsField {
+   MAIN_WINDOW_CORNER = 0,
+   CREATE_RECORD_COLLAPSED,
+   UPDATE_TIME,
+   BED_TIME,
+   SHOULD_SAVE_TO_LATE,
+   SHOULD_CLEAR_DONE,
+   USE_NOTIFICATION,
+   NOTIFICATION_CORNER,
+   TEMPORARY_NOTIFICATION,
+   NOTIFICATION_TIME
+};
+
+static constexpr SaveColumn s_Fields[] = {
+   {"mainWindowCorner", SaveColumnType::UINT8},
+   {"createRecordCollapsed", SaveColumnType::UINT8},
+   {"updateTime", SaveColumnType::INT32},
+   {"bedTime", SaveColumnType::INT32},
+   {"shouldSaveToLate", SaveColumnType::UINT8},
+   {"shouldClearDone", SaveColumnType::UINT8},
+   {"useNotification", SaveColumnType::UINT8},
+   {"notificationCorner", SaveColumnType::UINT8},
+   {"temporaryNotification", SaveColumnType::UINT8},
+   {"notificationTime", SaveColumnType::INT32}
+};
+
+static constexpr FieldHash s_FieldHash(s_Fields);
+
+static void SetNumber(Settings& settings, SettingsField field, int number);
 
 const wchar_t* WindowCornerToString(WindowCorner corner) {
    switch (corner) {
@@ -29,14 +63,100 @@ void Settings::Save(Serializer& serializer) {
 }
 
 void Settings::Load(Serializer& serializer) {
-   serializer.READ_ENUM(mainWindowCorner);
-   serializer.READ_BOOL(createRecordCollapsed);
-   serializer.READ_INT(updateTime);
-   serializer.READ_INT(bedTime);
-   serializer.READ_BOOL(shouldSaveToLate);
-   serializer.READ_BOOL(shouldClearDone);
-   serializer.READ_BOOL(useNotification);
-   serializer.READ_ENUM(notificationCorner);
-   serializer.READ_BOOL(temporaryNotification);
-   serializer.READ_INT(notificationTime);
+   if (serializer.GetFormat() == SaveFormat::TEXT) {
+      SerializedField field;
+      while (serializer.TryReadField(field)) {
+         TryLoadField(field.name, field.value);
+      }
+      return;
+   }
+
+   BinarySaveSection section;
+   if (!serializer.GetBinaryReader().TryGetSection(SETTINGS_SECTION, section)) {
+      return;
+   }
+
+   std::vector<SaveValue> values(section.GetColumns().size());
+   if (!section.TryReadRow(values.data())) {
+      return;
+   }
+
+   for (size_t i = 0; i < values.size(); i++) {
+      const SaveColumn& column = section.GetColumns()[i];
+      int field = s_FieldHash.Find(column.name);
+      if (field >= 0 && column.type != SaveColumnType::STRING) {
+         SetNumber(*this, (SettingsField) field, values[i].number);
+      }
+   }
+}
+
+void Settings::SaveBinary(BinarySaveWriter& writer) const {
+   writer.BeginSection(SETTINGS_SECTION, s_Fields, (uint32_t) std::size(s_Fields), 1);
+   writer.WriteNumber((int) mainWindowCorner);
+   writer.WriteNumber(createRecordCollapsed);
+   writer.WriteNumber(updateTime);
+   writer.WriteNumber(bedTime);
+   writer.WriteNumber(shouldSaveToLate);
+   writer.WriteNumber(shouldClearDone);
+   writer.WriteNumber(useNotification);
+   writer.WriteNumber((int) notificationCorner);
+   writer.WriteNumber(temporaryNotification);
+   writer.WriteNumber(notificationTime);
+}
+
+uint64_t Settings::GetContentHash() const {
+   BinarySaveWriter writer;
+   SaveBinary(writer);
+
+   std::vector<uint8_t> data;
+   writer.TryFinish(data);
+   return ::GetContentHash(data.data(), data.size());
+}
+
+bool Settings::TryLoadField(std::string_view name, std::string_view value) {
+   int field = s_FieldHash.Find(name);
+   int number;
+   if (field < 0 || !Serializer::TryParseInt(value, &number)) {
+      return false;
+   }
+
+   SetNumber(*this, (SettingsField) field, number);
+   return true;
+}
+
+static void SetNumber(Settings& settings, SettingsField field, int number) {
+   switch (field) {
+      case SettingsField::MAIN_WINDOW_CORNER:
+         settings.mainWindowCorner = (WindowCorner) number;
+         break;
+      case SettingsField::CREATE_RECORD_COLLAPSED:
+         settings.createRecordCollapsed = number;
+         break;
+      case SettingsField::UPDATE_TIME:
+         settings.updateTime = (unsigned int) number;
+         break;
+      case SettingsField::BED_TIME:
+         settings.bedTime = (unsigned int) number;
+         break;
+      case SettingsField::SHOULD_SAVE_TO_LATE:
+         settings.shouldSaveToLate = number;
+         break;
+      case SettingsField::SHOULD_CLEAR_DONE:
+         settings.shouldClearDone = number;
+         break;
+      case SettingsField::USE_NOTIFICATION:
+         settings.useNotification = number;
+         break;
+      case SettingsField::NOTIFICATION_CORNER:
+         settings.notificationCorner = (WindowCorner) number;
+         break;
+      case SettingsField::TEMPORARY_NOTIFICATION:
+         settings.temporaryNotification = number;
+         break;
+      case SettingsField::NOTIFICATION_TIME:
+         settings.notificationTime = (unsigned int) number;
+         break;
+      default:
+         break;
+   }
 }
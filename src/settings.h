@@ -1,6 +1,8 @@
 #pragma once
 #include "serializer.h"
 
+#define SETTINGS_SECTION "settings"
+
 enum class WindowCorner {
    RIGHT_DOWN = 0,
    LEFT_DOWN,
@@ -28,6 +30,17 @@ struct Settings {
    unsigned int notificationTime = 5;
 
    void Save(Serializer& serializer);
+
+   //A one row section of a binary save
+   void SaveBinary(BinarySaveWriter& writer) const;
+
+   //Hash of the binary section, equal for settings that save the same
+   uint64_t GetContentHash() const;
+
+   //Reads every field of the file opened in serializer in one pass, in either format
    void Load(Serializer& serializer);
+
+   //Sets the field saved under name, false for an unknown name or a value that isn't a number
+   bool TryLoadField(std::string_view name, std::string_view value);
 };
 
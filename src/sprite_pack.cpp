@@ -0,0 +1,143 @@
+#include "sprite_pack.h"
+#include "png_writer.h"
+#include <cstring>
+
+static std::vector<uint8_t> EncodeSprite(const uint32_t* pixels, size_t stride, const SpriteRect& rect, uint32_t keyPixel);
+static void AppendUInt32LE(std::vector<uint8_t>& out, uint32_t value);
+
+bool SpritePackView::TryOpen(const uint8_t* data, size_t size) {
+   Close();
+
+   SpritePackHeader header;
+   if (size < sizeof(header)) {
+      return false;
+   }
+
+   memcpy(&header, data, sizeof(header));
+   if (header.magic != SPRITE_PACK_MAGIC || header.version != SPRITE_PACK_VERSION || header.fileSize != size) {
+      return false;
+   }
+
+   size_t tableEnd = sizeof(header) + (size_t) header.spriteCount * sizeof(SpritePackEntry);
+   if (header.spriteCount > (size - sizeof(header)) / sizeof(SpritePackEntry)) {
+      return false;
+   }
+
+   m_Data = data;
+   m_Size = size;
+   m_SpriteCount = header.spriteCount;
+
+   for (uint32_t i = 0; i < m_SpriteCount; i++) {
+      SpritePackEntry entry = GetEntry(i);
+      if (entry.offset < tableEnd || entry.offset > size || entry.size > size - entry.offset || !entry.width || !entry.height) {
+         Close();
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void SpritePackView::Close() {
+   m_Data = nullptr;
+   m_Size = 0;
+   m_SpriteCount = 0;
+}
+
+//Entries are copied out, the mapped table has no alignment guarantees
+SpritePackEntry SpritePackView::GetEntry(uint32_t index) const {
+   SpritePackEntry entry;
+   memcpy(&entry, m_Data + sizeof(SpritePackHeader) + (size_t) index * sizeof(entry), sizeof(entry));
+   return entry;
+}
+
+bool SpritePackView::TryDecodeSprite(uint32_t index, const PNGDecodeOptions& options, PNGImage& image, PNGDecoderContext& context) const {
+   if (index >= m_SpriteCount) {
+      return false;
+   }
+
+   SpritePackEntry entry = GetEntry(index);
+   if (!DecodePNG(m_Data + entry.offset, entry.size, options, image, context)) {
+      return false;
+   }
+
+   return image.width == entry.width && image.height == entry.height;
+}
+
+bool TryBuildSpritePack(const uint32_t* pixels, size_t stride, uint32_t width, uint32_t height, uint32_t keyPixel, const std::vector<SpriteRect>& rects, std::vector<uint8_t>& out) {
+   std::vector<std::vector<uint8_t>> sprites;
+   sprites.reserve(rects.size());
+
+   for (const SpriteRect& rect : rects) {
+      bool isInside = rect.width && rect.height && rect.x < width && rect.y < height && rect.width <= width - rect.x && rect.height <= height - rect.y;
+      if (!isInside) {
+         return false;
+      }
+
+      sprites.emplace_back(EncodeSprite(pixels, stride, rect, keyPixel));
+   }
+
+   size_t fileSize = sizeof(SpritePackHeader) + rects.size() * sizeof(SpritePackEntry);
+   for (const std::vector<uint8_t>& sprite : sprites) {
+      fileSize += sprite.size();
+   }
+
+   if (fileSize > UINT32_MAX) {
+      return false;
+   }
+
+   out.clear();
+   out.reserve(fileSize);
+   AppendUInt32LE(out, SPRITE_PACK_MAGIC);
+   AppendUInt32LE(out, SPRITE_PACK_VERSION);
+   AppendUInt32LE(out, (uint32_t) rects.size());
+   AppendUInt32LE(out, (uint32_t) fileSize);
+
+   size_t offset = sizeof(SpritePackHeader) + rects.size() * sizeof(SpritePackEntry);
+   for (size_t i = 0; i < rects.size(); i++) {
+      AppendUInt32LE(out, (uint32_t) offset);
+      AppendUInt32LE(out, (uint32_t) sprites[i].size());
+      AppendUInt32LE(out, rects[i].width);
+      AppendUInt32LE(out, rects[i].height);
+      offset += sprites[i].size();
+   }
+
+   for (const std::vector<uint8_t>& sprite : sprites) {
+      out.insert(out.end(), sprite.begin(), sprite.end());
+   }
+
+   return true;
+}
+
+//8 bit RGBA, transparent pixels are all zero so they compress to almost nothing
+static std::vector<uint8_t> EncodeSprite(const uint32_t* pixels, size_t stride, const SpriteRect& rect, uint32_t keyPixel) {
+   size_t lineLength = (size_t) rect.width * 4;
+   std::vector<uint8_t> line(lineLength);
+   std::vector<uint8_t> prevLine(lineLength, 0);
+   std::vector<uint8_t> filtered;
+
+   for (uint32_t y = 0; y < rect.height; y++) {
+      const uint32_t* row = pixels + (rect.y + y) * stride + rect.x;
+
+      for (uint32_t x = 0; x < rect.width; x++) {
+         uint32_t pixel = row[x];
+         bool isKey = pixel == keyPixel;
+
+         line[x * 4] = isKey ? 0 : (uint8_t) (pixel >> 16);
+         line[x * 4 + 1] = isKey ? 0 : (uint8_t) (pixel >> 8);
+         line[x * 4 + 2] = isKey ? 0 : (uint8_t) pixel;
+         line[x * 4 + 3] = isKey ? 0 : 0xFF;
+      }
+
+      AppendBestFilteredLine(filtered, line.data(), prevLine.data(), lineLength, 4);
+      line.swap(prevLine);
+   }
+
+   return WritePNG(rect.width, rect.height, 8, PNG_COLOR_RGBA, 0, {}, {}, filtered);
+}
+
+static void AppendUInt32LE(std::vector<uint8_t>& out, uint32_t value) {
+   for (int shift = 0; shift < 32; shift += 8) {
+      out.emplace_back((uint8_t) (value >> shift));
+   }
+}
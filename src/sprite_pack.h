@@ -0,0 +1,60 @@
+#pragma once
+#include "png_decoder.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define SPRITE_PACK_MAGIC 0x4B505344//"DSPK" in file order
+#define SPRITE_PACK_VERSION 1
+
+//Header, one entry per sprite, then every sprite as a PNG file of its own, all little-endian.
+//Any sprite can be decoded straight from a mapped pack without touching the others
+struct SpritePackHeader {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t spriteCount;
+   uint32_t fileSize;//A cut off pack fails to open instead of failing on some later sprite
+};
+
+struct SpritePackEntry {
+   uint32_t offset;//From the start of the file
+   uint32_t size;
+   uint32_t width;
+   uint32_t height;
+};
+
+//Part of an atlas that becomes one sprite, in pixels
+struct SpriteRect {
+   uint32_t x;
+   uint32_t y;
+   uint32_t width;
+   uint32_t height;
+};
+
+//Reads sprites of a pack held in memory, usually a mapped file. Nothing is copied, the memory must outlive the view
+class SpritePackView {
+public:
+
+   //Checks the header and that every sprite lies inside the pack
+   bool TryOpen(const uint8_t* data, size_t size);
+   void Close();
+
+   uint32_t GetSpriteCount() const {
+      return m_SpriteCount;
+   }
+
+   SpritePackEntry GetEntry(uint32_t index) const;
+
+   bool TryDecodeSprite(uint32_t index, const PNGDecodeOptions& options, PNGImage& image, PNGDecoderContext& context) const;
+
+private:
+
+   const uint8_t* m_Data = nullptr;
+   size_t m_Size = 0;
+   uint32_t m_SpriteCount = 0;
+};
+
+//Cuts every rect out of BGRA pixels decoded in color key mode and compresses each one on its own.
+//Key pixels are stored as transparent and the rest as opaque, so a sprite decoded with the same key
+//gives exactly the pixels of its rect
+bool TryBuildSpritePack(const uint32_t* pixels, size_t stride, uint32_t width, uint32_t height, uint32_t keyPixel, const std::vector<SpriteRect>& rects, std::vector<uint8_t>& out);
@@ -0,0 +1,270 @@
+#include "state_journal.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static intptr_t OpenFile(const std::filesystem::path& path);
+static void CloseFile(intptr_t file);
+static bool TryReadFile(intptr_t file, std::vector<uint8_t>& out);
+static bool TryWriteAt(intptr_t file, size_t offset, const uint8_t* data, size_t size);
+static bool TryTruncate(intptr_t file, size_t size);
+static bool TryFlushFile(intptr_t file);
+
+static void WriteUInt32LE(uint8_t* out, uint32_t value);
+static uint32_t ReadUInt32LE(const uint8_t* data);
+static uint32_t GetEntryCheck(const uint8_t* entry, uint32_t checkpointId);
+
+StateJournal::~StateJournal() {
+   Close();
+}
+
+bool StateJournal::TryOpen(const std::filesystem::path& path, uint32_t checkpointId, std::vector<StateChange>& changes) {
+   Close();
+   changes.clear();
+
+   std::error_code error;
+   if (path.has_parent_path()) {
+      std::filesystem::create_directories(path.parent_path(), error);
+   }
+
+   m_File = OpenFile(path);
+   if (m_File == -1) {
+      return false;
+   }
+
+   std::vector<uint8_t> data;
+   if (!TryReadFile(m_File, data)) {
+      Close();
+      return false;
+   }
+
+   bool isMatching = data.size() >= STATE_JOURNAL_HEADER_SIZE && ReadUInt32LE(data.data()) == STATE_JOURNAL_MAGIC &&
+      ReadUInt32LE(data.data() + 4) == STATE_JOURNAL_VERSION && ReadUInt32LE(data.data() + 8) == checkpointId &&
+      ReadUInt32LE(data.data() + 12) == STATE_JOURNAL_ENTRY_SIZE;
+   if (!isMatching) {
+      return TryReset(checkpointId);
+   }
+
+   m_CheckpointId = checkpointId;
+   m_Size = STATE_JOURNAL_HEADER_SIZE;
+
+   //Stops at the first entry that was only partly written
+   while (data.size() - m_Size >= STATE_JOURNAL_ENTRY_SIZE) {
+      const uint8_t* entry = data.data() + m_Size;
+      if (entry[0] >= (uint8_t) StateChangeType::count || entry[1] >= (uint8_t) StateListType::count ||
+         ReadUInt32LE(entry + 12) != GetEntryCheck(entry, checkpointId)) {
+         break;
+      }
+
+      StateChange change;
+      change.type = (StateChangeType) entry[0];
+      change.list = (StateListType) entry[1];
+      change.recordIndex = (int) ReadUInt32LE(entry + 4);
+      change.value = (int) ReadUInt32LE(entry + 8);
+      changes.emplace_back(change);
+
+      m_Size += STATE_JOURNAL_ENTRY_SIZE;
+   }
+
+   if (data.size() != m_Size && !TryTruncate(m_File, m_Size)) {
+      Close();
+      return false;
+   }
+
+   return true;
+}
+
+void StateJournal::Close() {
+   if (m_File != -1) {
+      CloseFile(m_File);
+      m_File = -1;
+   }
+
+   m_Size = 0;
+}
+
+bool StateJournal::TryAppend(const StateChange& change) {
+   return TryAppend(&change, 1);
+}
+
+bool StateJournal::TryAppend(const std::vector<StateChange>& changes) {
+   return TryAppend(changes.data(), changes.size());
+}
+
+bool StateJournal::TryAppend(const StateChange* changes, size_t count) {
+   if (m_File == -1) {
+      return false;
+   }
+
+   if (!count) {
+      return true;
+   }
+
+   std::vector<uint8_t> entries(count * STATE_JOURNAL_ENTRY_SIZE);
+   for (size_t i = 0; i < count; i++) {
+      uint8_t* entry = entries.data() + i * STATE_JOURNAL_ENTRY_SIZE;
+      entry[0] = (uint8_t) changes[i].type;
+      entry[1] = (uint8_t) changes[i].list;
+      WriteUInt32LE(entry + 4, (uint32_t) changes[i].recordIndex);
+      WriteUInt32LE(entry + 8, (uint32_t) changes[i].value);
+      WriteUInt32LE(entry + 12, GetEntryCheck(entry, m_CheckpointId));
+   }
+
+   //A failed write may have left part of the entries, the next append writes over them
+   if (!TryWriteAt(m_File, m_Size, entries.data(), entries.size()) || !TryFlush()) {
+      return false;
+   }
+
+   m_Size += entries.size();
+   return true;
+}
+
+//The new header goes first, entries left after it until the truncate don't pass the check of the new id
+bool StateJournal::TryReset(uint32_t checkpointId) {
+   if (m_File == -1) {
+      return false;
+   }
+
+   uint8_t header[STATE_JOURNAL_HEADER_SIZE];
+   WriteUInt32LE(header, STATE_JOURNAL_MAGIC);
+   WriteUInt32LE(header + 4, STATE_JOURNAL_VERSION);
+   WriteUInt32LE(header + 8, checkpointId);
+   WriteUInt32LE(header + 12, STATE_JOURNAL_ENTRY_SIZE);
+
+   if (!TryWriteAt(m_File, 0, header, sizeof(header)) || !TryTruncate(m_File, sizeof(header)) || !TryFlush()) {
+      Close();
+      return false;
+   }
+
+   m_CheckpointId = checkpointId;
+   m_Size = sizeof(header);
+   return true;
+}
+
+bool StateJournal::TryFlush() {
+   return m_Durability == SaveDurability::NONE || TryFlushFile(m_File);
+}
+
+static void WriteUInt32LE(uint8_t* out, uint32_t value) {
+   for (int i = 0; i < 4; i++) {
+      out[i] = (uint8_t) (value >> i * 8);
+   }
+}
+
+static uint32_t ReadUInt32LE(const uint8_t* data) {
+   return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+//FNV-1a of the first 12 bytes started from the checkpoint id
+static uint32_t GetEntryCheck(const uint8_t* entry, uint32_t checkpointId) {
+   uint32_t hash = 2166136261u ^ (checkpointId * 0x9E3779B9u);
+   for (int i = 0; i < 12; i++) {
+      hash = (hash ^ entry[i]) * 16777619u;
+   }
+   return hash;
+}
+
+#ifdef _WIN32
+
+static intptr_t OpenFile(const std::filesystem::path& path) {
+   HANDLE file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+   return file == INVALID_HANDLE_VALUE ? -1 : (intptr_t) file;
+}
+
+static void CloseFile(intptr_t file) {
+   CloseHandle((HANDLE) file);
+}
+
+static bool TryReadFile(intptr_t file, std::vector<uint8_t>& out) {
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx((HANDLE) file, &size) || size.QuadPart > UINT32_MAX) {
+      return false;
+   }
+
+   out.resize((size_t) size.QuadPart);
+   if (out.empty()) {
+      return true;
+   }
+
+   OVERLAPPED overlapped{};
+   DWORD read;
+   return ReadFile((HANDLE) file, out.data(), (DWORD) out.size(), &read, &overlapped) && read == out.size();
+}
+
+static bool TryWriteAt(intptr_t file, size_t offset, const uint8_t* data, size_t size) {
+   OVERLAPPED overlapped{};
+   overlapped.Offset = (DWORD) offset;
+   overlapped.OffsetHigh = (DWORD) ((uint64_t) offset >> 32);
+
+   DWORD written;
+   return WriteFile((HANDLE) file, data, (DWORD) size, &written, &overlapped) && written == size;
+}
+
+static bool TryTruncate(intptr_t file, size_t size) {
+   LARGE_INTEGER pos;
+   pos.QuadPart = (LONGLONG) size;
+   return SetFilePointerEx((HANDLE) file, pos, nullptr, FILE_BEGIN) && SetEndOfFile((HANDLE) file);
+}
+
+static bool TryFlushFile(intptr_t file) {
+   return FlushFileBuffers((HANDLE) file);
+}
+
+#else
+
+static intptr_t OpenFile(const std::filesystem::path& path) {
+   return open(path.c_str(), O_RDWR | O_CREAT, 0644);
+}
+
+static void CloseFile(intptr_t file) {
+   close((int) file);
+}
+
+static bool TryReadFile(intptr_t file, std::vector<uint8_t>& out) {
+   struct stat info;
+   if (fstat((int) file, &info) || info.st_size > UINT32_MAX) {
+      return false;
+   }
+
+   out.resize((size_t) info.st_size);
+   size_t pos = 0;
+   while (pos < out.size()) {
+      ssize_t count = pread((int) file, out.data() + pos, out.size() - pos, (off_t) pos);
+      if (count <= 0) {
+         return false;
+      }
+      pos += (size_t) count;
+   }
+
+   return true;
+}
+
+static bool TryWriteAt(intptr_t file, size_t offset, const uint8_t* data, size_t size) {
+   while (size) {
+      ssize_t written = pwrite((int) file, data, size, (off_t) offset);
+      if (written <= 0) {
+         return false;
+      }
+
+      data += written;
+      offset += (size_t) written;
+      size -= (size_t) written;
+   }
+
+   return true;
+}
+
+static bool TryTruncate(intptr_t file, size_t size) {
+   return !ftruncate((int) file, (off_t) size);
+}
+
+static bool TryFlushFile(intptr_t file) {
+   return !fsync((int) file);
+}
+
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+#include "atomic_file.h"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#define STATE_JOURNAL_MAGIC 0x4C4A5044//"DPJL"
+#define STATE_JOURNAL_VERSION 1
+#define STATE_JOURNAL_HEADER_SIZE 16
+#define STATE_JOURNAL_ENTRY_SIZE 16
+#define STATE_JOURNAL_COMPACT_SIZE (64 * 1024)//About 4000 changes, then the next one writes a checkpoint
+
+enum class StateChangeType : uint8_t {
+   RECORD_STATUS = 0,//value is the new StatusType of the record
+   RECORD_COLLAPSE,//value is whether the record is collapsed now, a record index of -1 is every record of the list
+   LIST_EXPAND,//value is whether the list is expanded now
+   TODAY_STATUS,//value is the new status of the whole day
+
+   //Iteration helpers
+   count,
+   begin = 0,
+   end = count - 1
+};
+
+enum class StateListType : uint8_t {
+   LAST_DAY = 0,
+   TODAY,
+   ALL,
+
+   //Iteration helpers
+   count,
+   begin = 0,
+   end = count - 1
+};
+
+struct StateChange {
+   StateChangeType type = StateChangeType::RECORD_STATUS;
+   StateListType list = StateListType::TODAY;
+   int recordIndex = -1;//Index in the records save
+   int value = 0;
+};
+
+//Append-only log of the state changes made since the last checkpoint of the whole state.
+//The log starts with the id of its checkpoint, a log left behind by an older checkpoint is never replayed.
+//Every entry carries a checksum seeded with that id, so a torn last entry is dropped on open
+class StateJournal {
+public:
+
+   StateJournal() = default;
+   ~StateJournal();
+
+   StateJournal(const StateJournal&) = delete;
+   StateJournal& operator=(const StateJournal&) = delete;
+
+   //Opens path for appending and reads the changes logged on top of checkpointId into changes.
+   //A missing log or one of another checkpoint is started anew with nothing to replay
+   bool TryOpen(const std::filesystem::path& path, uint32_t checkpointId, std::vector<StateChange>& changes);
+   void Close();
+
+   bool IsOpen() const {
+      return m_File != -1;
+   }
+
+   //NONE leaves appends to the OS cache, any other level flushes the log after every write
+   void SetDurability(SaveDurability durability) {
+      m_Durability = durability;
+   }
+
+   //One write of one entry, the cost doesn't depend on how much state there is
+   bool TryAppend(const StateChange& change);
+
+   //Every change in one write and one flush
+   bool TryAppend(const std::vector<StateChange>& changes);
+
+   //Drops every entry once a checkpoint with checkpointId holds them
+   bool TryReset(uint32_t checkpointId);
+
+   size_t GetSize() const {
+      return m_Size;
+   }
+
+   bool IsCompactDue() const {
+      return m_Size >= STATE_JOURNAL_COMPACT_SIZE;
+   }
+
+private:
+
+   intptr_t m_File = -1;//HANDLE on Windows, a descriptor elsewhere
+   size_t m_Size = 0;
+   uint32_t m_CheckpointId = 0;
+   SaveDurability m_Durability = SaveDurability::FLUSH_FILE;
+
+   bool TryAppend(const StateChange* changes, size_t count);
+   bool TryFlush();
+
+};
@@ -15,9 +15,24 @@
 
 #define SHELL_ICON_ID 128
 
+#define ASSET_ICON 0
+#define ASSET_ICON_WARNING 1
+#define ASSET_ICON_FAIL 2
+
 MainWnd::~MainWnd() {
    Destroy(false);
 
+#ifndef NDEBUG
+
+   SaveWorkerStats stats = m_SaveWorker.GetStats();
+   wchar_t str[256];
+   swprintf_s(str, L"Saves: %u posted, %u written, %u coalesced, %u failed, %u skipped (%llu bytes), %.2f ms on the UI thread, %.2f ms on the save thread\n",
+      stats.postCount, stats.writeCount, stats.coalescedCount, stats.failCount, stats.skipCount, (unsigned long long) stats.skippedBytes,
+      stats.postMilliseconds, stats.writeMilliseconds);
+   OutputDebugString(str);
+
+#endif
+
    delete m_NotificationWnd;
    delete m_PanelWnd;
    delete m_SettingsWnd;
@@ -27,11 +42,15 @@ MainWnd::~MainWnd() {
 void MainWnd::Destroy(bool fromProc) {
    KillTimer(m_Wnd, TIMER_UPDATE);
 
+   m_ImageLoader.Stop();
+
    m_NotificationWnd->Destroy(false);
    m_PanelWnd->Destroy(false);
    m_SettingsWnd->Destroy(false);
    m_SetupRecordWnd->Destroy(false);
 
+   m_SaveWorker.Stop();
+
    DeleteObject(m_CaptionFont);
    DeleteObject(m_SettingsBm);
 
@@ -108,10 +127,6 @@ POINT MainWnd::GetDefaultPos() {
 }
 
 void MainWnd::BeforeWndCreate(const WndCreateData& data) {
-   m_Icon = (HICON)LoadImage(m_Instance, ICON, IMAGE_ICON, 0, 0, LR_DEFAULTSIZE | LR_LOADFROMFILE);
-   m_IconWarning = (HICON)LoadImage(m_Instance, ICON_WARNING, IMAGE_ICON, 0, 0, LR_DEFAULTSIZE | LR_LOADFROMFILE);
-   m_IconFail = (HICON)LoadImage(m_Instance, ICON_FAIL, IMAGE_ICON, 0, 0, LR_DEFAULTSIZE | LR_LOADFROMFILE);
-
    m_SubMenu = CreateMenu();
    AppendMenu(m_SubMenu, MF_ENABLED | MF_STRING, WM_POPUP_CANCEL, L"Cancel");
    AppendMenu(m_SubMenu, MF_ENABLED | MF_STRING, WM_POPUP_CLOSE, L"Close");
@@ -189,6 +204,7 @@ LRESULT MainWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
                break;
             case WM_POPUP_CLOSE:
                m_PanelWnd->SaveState();
+               m_SaveWorker.Flush();
                Destroy(false);
                break;
          }
@@ -221,6 +237,23 @@ LRESULT MainWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
       case WM_STATUS_UPDATE:
          UpdateStatus(m_PanelWnd->GetTodayStatus());
          break;
+      case WM_ASSET_LOADED:
+         TakeAsset((size_t) wParam);
+         break;
+      case WM_SAVE_FAILED:
+         //A whole save that failed kept the old file, failed changes are written again as a whole by the panel.
+         //The file no longer has what the last save had, so the next save of it isn't skipped
+         if ((bool) lParam) {
+            if ((SaveStream) wParam == SaveStream::SETTINGS) {
+               m_IsSettingsHashed = false;
+            }
+
+            wchar_t str[256];
+            swprintf_s(str, L"Failed to save %s, the last save is kept", SaveStreamToString((SaveStream) wParam));
+            MessageBox(m_Wnd, str, L"Saving error", MB_OK);
+         }
+         SendMessage(m_PanelWnd->GetWnd(), WM_SAVE_FAILED, wParam, lParam);
+         break;
       case WM_PAINT:
          {
             PAINTSTRUCT ps;
@@ -254,28 +287,17 @@ void MainWnd::CreateView() {
    m_IconData.uID = SHELL_ICON_ID;
    m_IconData.uFlags = NIF_ICON | NIF_MESSAGE;
    m_IconData.uCallbackMessage = CM_OPEN_WND;
-   m_IconData.hIcon = m_Icon;
-
-   Shell_NotifyIcon(NIM_ADD, &m_IconData);
 
+   //Only maps the pack, each image is decoded on its first draw
    InitImageLibrary(m_Wnd);
-   LoadAtlas(m_Wnd);
+   LoadSpritePack(m_Wnd);
+   LoadAssets();
 
    HDC hdc = GetDC(m_Wnd);
    m_SettingsBm = CreateCompatibleBitmap(hdc, IMAGE_SIZE, IMAGE_SIZE);
-   HDC virtHdc = CreateCompatibleDC(hdc);
    ReleaseDC(m_Wnd, hdc);
 
-   SelectObject(virtHdc, m_SettingsBm);
-
-   HBRUSH tempBrush = CreateSolidBrush(GetBkColor(virtHdc));
-   RECT rect = {0, 0, IMAGE_SIZE, IMAGE_SIZE};
-   FillRect(virtHdc, &rect, tempBrush);
-   DeleteObject(tempBrush);
-
-   DrawImage(virtHdc, {3, 3}, {IMAGE_SIZE - 6, IMAGE_SIZE - 6}, SETTINGS_IMAGE);
-
-   DeleteDC(virtHdc);
+   DrawSettingsImage();
 
    m_SettingsButton = CreateWindow(L"BUTTON", L"", WS_BORDER | WS_VISIBLE | WS_CHILD | BS_BITMAP, LINE_X_OFFSET, LINE_Y_OFFSET + Y_OFFSET, IMAGE_SIZE, IMAGE_SIZE, m_Wnd, (HMENU) WM_OPEN_SETTINGS, m_Instance, nullptr);
    SendMessage(m_SettingsButton, BM_SETIMAGE, IMAGE_BITMAP, (LPARAM) m_SettingsBm);
@@ -287,6 +309,13 @@ void MainWnd::CreateView() {
    notificationData.pos = {0, 0};
    m_NotificationWnd->Create(notificationData);
 
+   //Saves are written on a thread of their own, failures come back as messages
+   HWND hWnd = m_Wnd;
+   m_SaveWorker.SetDurability(m_Serializer.GetDurability());
+   m_SaveWorker.SetFailedCallback([hWnd](SaveStream stream, bool isSnapshot) {
+      PostMessage(hWnd, WM_SAVE_FAILED, (WPARAM) stream, (LPARAM) isSnapshot);
+   });
+
    Settings settings = LoadSettings();
 
    PanelWndCreateData panelData{};
@@ -296,6 +325,7 @@ void MainWnd::CreateView() {
    panelData.clientHeight = WND_CLIENT_HEIGHT;
    panelData.timeUtils = &m_TimeUtils;
    panelData.serializer = &m_Serializer;
+   panelData.saveWorker = &m_SaveWorker;
    panelData.settings = settings;
    m_PanelWnd->Create(panelData);
 
@@ -318,26 +348,64 @@ void MainWnd::CreateView() {
    SetTimer(m_Wnd, TIMER_UPDATE, settings.updateTime * 1000, nullptr);
 }
 
-void MainWnd::UpdateStatus(StatusType status) {
-   HICON icon;
-   if (status == StatusType::UPCOMING) {
-      icon = m_Icon;
-   } else if (status == StatusType::CURRENT) {
-      icon = m_IconWarning;
-   } else if (status == StatusType::TO_LATE) {
-      icon = m_IconFail;
-   } else {
+void MainWnd::LoadAssets() {
+   std::vector<AssetRequest> requests(3);
+   requests[ASSET_ICON] = {ICON};
+   requests[ASSET_ICON_WARNING] = {ICON_WARNING};
+   requests[ASSET_ICON_FAIL] = {ICON_FAIL};
+
+   HWND hWnd = m_Wnd;
+   m_Assets = m_ImageLoader.LoadBatch(m_Instance, requests, [hWnd](size_t index) {
+      PostMessage(hWnd, WM_ASSET_LOADED, (WPARAM) index, 0);
+   });
+}
+
+void MainWnd::TakeAsset(size_t index) {
+   if (index >= m_Assets.size() || !m_Assets[index].valid()) {
       return;
    }
 
-   NOTIFYICONDATA iconData = {};
-   iconData.cbSize = sizeof(iconData);
-   iconData.hWnd = m_Wnd;
-   iconData.uID = SHELL_ICON_ID;
-   iconData.uFlags = NIF_ICON;
-   iconData.hIcon = icon;
+   LoadedAsset asset = m_Assets[index].get();
+
+   switch (index) {
+      case ASSET_ICON:
+         m_Icon = asset.icon;
+         break;
+      case ASSET_ICON_WARNING:
+         m_IconWarning = asset.icon;
+         break;
+      case ASSET_ICON_FAIL:
+         m_IconFail = asset.icon;
+         break;
+   }
+
+   UpdateTrayIcon();
+}
+
+void MainWnd::DrawSettingsImage() {
+   HDC hdc = GetDC(m_Wnd);
+   HDC virtHdc = CreateCompatibleDC(hdc);
+   ReleaseDC(m_Wnd, hdc);
+
+   SelectObject(virtHdc, m_SettingsBm);
 
-   Shell_NotifyIcon(NIM_MODIFY, &iconData);
+   HBRUSH tempBrush = CreateSolidBrush(GetBkColor(virtHdc));
+   RECT rect = {0, 0, IMAGE_SIZE, IMAGE_SIZE};
+   FillRect(virtHdc, &rect, tempBrush);
+   DeleteObject(tempBrush);
+
+   DrawImage(virtHdc, {3, 3}, {IMAGE_SIZE - 6, IMAGE_SIZE - 6}, SETTINGS_IMAGE);
+
+   DeleteDC(virtHdc);
+}
+
+void MainWnd::UpdateStatus(StatusType status) {
+   if (status != StatusType::UPCOMING && status != StatusType::CURRENT && status != StatusType::TO_LATE) {
+      return;
+   }
+
+   m_Status = status;
+   UpdateTrayIcon();
 
    if (IsVisible()) {
       return;
@@ -365,12 +433,53 @@ void MainWnd::UpdateStatus(StatusType status) {
    }
 }
 
+//Icons arrive from the loader in any order, the tray icon shows up with the first one the status needs
+void MainWnd::UpdateTrayIcon() {
+   HICON icon;
+   if (m_Status == StatusType::CURRENT) {
+      icon = m_IconWarning;
+   } else if (m_Status == StatusType::TO_LATE) {
+      icon = m_IconFail;
+   } else {
+      icon = m_Icon;
+   }
+
+   if (!icon) {
+      return;
+   }
+
+   m_IconData.hIcon = icon;
+
+   Shell_NotifyIcon(m_IsTrayIconAdded ? NIM_MODIFY : NIM_ADD, &m_IconData);
+   m_IsTrayIconAdded = true;
+}
+
+//Skipped when the file already has these settings
 void MainWnd::SaveSettings(Settings settings) {
-   m_Serializer.TryOpenForSerialize(SETTINGS_SAVE);
+   SavePostTimer timer(&m_SaveWorker);
 
-   settings.Save(m_Serializer);
+   uint64_t hash = settings.GetContentHash();
+   if (m_IsSettingsHashed && hash == m_SettingsHash) {
+      m_SaveWorker.AddSkippedFile(SETTINGS_SAVE);
+      return;
+   }
 
-   m_Serializer.Close();
+   m_SettingsHash = hash;
+   m_IsSettingsHashed = true;
+
+   m_SaveWorker.PostSnapshot(SaveStream::SETTINGS, [settings](Serializer& serializer) mutable {
+      if (SAVE_FORMAT == SaveFormat::BINARY) {
+         BinarySaveWriter writer;
+         settings.SaveBinary(writer);
+         return serializer.TryWriteBinary(SETTINGS_SAVE, writer);
+      }
+
+      serializer.TryOpenForSerialize(SETTINGS_SAVE);
+
+      settings.Save(serializer);
+
+      return serializer.TryCommit();
+   });
 }
 
 Settings MainWnd::LoadSettings() {
@@ -380,7 +489,18 @@ Settings MainWnd::LoadSettings() {
 
    result.Load(m_Serializer);
 
+   SaveFormat format = m_Serializer.GetFormat();
+
    m_Serializer.Close();
 
+   //Rewritten once in the format saves use now, otherwise saving the same settings again is skipped
+   std::error_code error;
+   if (format != SAVE_FORMAT) {
+      SaveSettings(result);
+   } else if (std::filesystem::exists(SETTINGS_SAVE, error)) {
+      m_SettingsHash = result.GetContentHash();
+      m_IsSettingsHashed = true;
+   }
+
    return result;
 }
@@ -7,6 +7,8 @@
 #include <time_utils.h>
 #include <notification_wnd.h>
 #include "serializer.h"
+#include "image_loader.h"
+#include "save_worker.h"
 
 struct MainWndCreateData : public WndCreateData {
 
@@ -34,9 +36,9 @@ private:
 
    HMENU m_Menu;
    HMENU m_SubMenu;
-   HICON m_Icon;
-   HICON m_IconWarning;
-   HICON m_IconFail;
+   HICON m_Icon = nullptr;
+   HICON m_IconWarning = nullptr;
+   HICON m_IconFail = nullptr;
 
    NotificationWnd* m_NotificationWnd = nullptr;
 
@@ -52,10 +54,20 @@ private:
    HFONT m_CaptionFont = nullptr;
 
    NOTIFYICONDATA m_IconData;
+   bool m_IsTrayIconAdded = false;
+   StatusType m_Status = StatusType::UPCOMING;
+
+   ImageLoader m_ImageLoader;
+   std::vector<std::future<LoadedAsset>> m_Assets;
 
    TimeUtils m_TimeUtils;
 
    Serializer m_Serializer;
+   SaveWorker m_SaveWorker;
+
+   //Hash of the settings in the settings save, saving them unchanged is skipped
+   uint64_t m_SettingsHash = 0;
+   bool m_IsSettingsHashed = false;
 
 private:
 
@@ -67,7 +79,12 @@ private:
 
    void CreateView() override;
 
+   void LoadAssets();
+   void TakeAsset(size_t index);
+   void DrawSettingsImage();
+
    void UpdateStatus(StatusType status);
+   void UpdateTrayIcon();
 
    void SaveSettings(Settings settings);
    Settings LoadSettings();
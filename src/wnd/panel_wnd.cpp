@@ -3,6 +3,42 @@
 #include "messages.h"
 #include "record_checker.h"
 #include "files.h"
+#include "content_hash.h"
+#include <algorithm>
+#include <iterator>
+
+#define STATE_SECTION "state"
+#define LAST_DAY_SECTION "lastDayRecords"
+#define TODAY_SECTION "todayRecords"
+#define ENDED_SECTION "endedRecords"
+#define COLLAPSED_SECTION "collapsedRecords"
+
+//Columns of the binary state, a row per list entry and one row of everything else
+static constexpr SaveColumn s_StateColumns[] = {
+   {"lastYear", SaveColumnType::INT32},
+   {"lastMonth", SaveColumnType::UINT8},
+   {"lastDay", SaveColumnType::UINT8},
+   {"journalId", SaveColumnType::INT32},
+   {"todayStatus", SaveColumnType::INT32},
+   {"lastDayExpanded", SaveColumnType::UINT8},
+   {"todayExpanded", SaveColumnType::UINT8},
+   {"allExpanded", SaveColumnType::UINT8}
+};
+
+static constexpr SaveColumn s_LastDayColumns[] = {
+   {"recordIndex", SaveColumnType::INT32},
+   {"isCollapsed", SaveColumnType::UINT8}
+};
+
+static constexpr SaveColumn s_TodayColumns[] = {
+   {"recordIndex", SaveColumnType::INT32},
+   {"recordStatus", SaveColumnType::INT32},
+   {"isCollapsed", SaveColumnType::UINT8}
+};
+
+static constexpr SaveColumn s_IndexColumns[] = {
+   {"recordIndex", SaveColumnType::INT32}
+};
 
 PanelWnd::~PanelWnd() {
    Destroy(false);
@@ -21,10 +57,23 @@ void PanelWnd::Destroy(bool fromProc) {
 
    DestroyWindow(m_ScrollBar);
 
+   //Saves still waiting write through the journal and the store
+   if (m_SaveWorker) {
+      m_SaveWorker->Flush();
+   }
+
+   m_IsJournaling = false;
+   m_StateChanges.clear();
+   m_Journal.Close();
+
    for (std::vector<Record*>::iterator it = m_Records.begin(); it != m_Records.end(); it++) {
       delete *it;
    }
    m_Records.clear();
+   m_RecordIndices.clear();
+
+   m_RecordStore.Close();
+   m_RecordSlots.clear();
 
    WndBase::Destroy(fromProc);
 }
@@ -63,10 +112,12 @@ void PanelWnd::BeforeWndCreate(const WndCreateData& data) {
    m_MainHeight = castData.mainHeight;
    m_TimeUtils = castData.timeUtils;
    m_Serializer = castData.serializer;
+   m_SaveWorker = castData.saveWorker;
    m_Settings = castData.settings;
 
    LoadRecords();
    LoadState();
+   ReplayStateJournal();
 }
 
 DWORD PanelWnd::GetFlags() {
@@ -189,8 +240,41 @@ LRESULT PanelWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPa
          Update();
          break;
       case WM_RECORD_DONE:
+         AppendStateChange(StateChangeType::RECORD_STATUS, (RecordListWnd*) lParam, (Record*) wParam, (int) StatusType::DONE);
          Update();
          break;
+      case WM_EXPAND_RECORD:
+         {
+            //No record means every record of the list was collapsed or expanded at once
+            RecordListWnd* list = (RecordListWnd*) wParam;
+            Record* record = (Record*) lParam;
+            if (list->GetRecordsCount() > 0) {
+               int index = record ? list->TryGetRecordIndex(record) : 0;
+               AppendStateChange(StateChangeType::RECORD_COLLAPSE, list, record, list->GetRecordCollapse(index));
+            }
+         }
+         break;
+      case WM_EXPAND_LIST:
+         {
+            RecordListWnd* list = (RecordListWnd*) wParam;
+            AppendStateChange(StateChangeType::LIST_EXPAND, list, nullptr, list->IsExpanded());
+         }
+         break;
+      case WM_SAVE_FAILED:
+         //A whole save that failed left the old file, the next save can't be skipped for matching what was posted.
+         //Changes that couldn't be written are written again as a whole
+         if ((bool) lParam) {
+            if ((SaveStream) wParam == SaveStream::RECORDS) {
+               m_RecordHashes.clear();
+            } else if ((SaveStream) wParam == SaveStream::STATE) {
+               m_IsStateHashed = false;
+            }
+         } else if ((SaveStream) wParam == SaveStream::RECORDS) {
+            SaveRecords();
+         } else if ((SaveStream) wParam == SaveStream::STATE) {
+            SaveState();
+         }
+         break;
       case WM_SIZE_CHANGE_LIST:
          {
             bool isShorted = GetClientHeight() > m_StartHeight;
@@ -228,6 +312,9 @@ LRESULT PanelWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPa
          return DefWindowProc(hWnd, message, wParam, lParam);
    }
 
+   //Every change one message made goes to the journal in one write
+   PostStateChanges();
+
    return 0;
 }
 
@@ -350,6 +437,13 @@ void PanelWnd::CreateView() {
    m_EndedRecordsLoaded.clear();
    m_CollapsedRecordsLoaded.clear();
 
+   if (m_IsStateMigrating) {
+      m_IsStateMigrating = false;
+      SaveState();
+   }
+
+   m_IsJournaling = !m_IsSavingBlocked;
+
    m_ScrollBar = CreateWindow(L"SCROLLBAR", L"", WS_CHILD | SBS_VERT, WND_WIDTH - IMAGE_SIZE - LINE_X_OFFSET, m_MainHeight - m_StartHeight, IMAGE_SIZE, m_StartHeight - LINE_Y_OFFSET, m_ParentWnd, nullptr, m_Instance, nullptr);
    SCROLLINFO scrollInfo{0};
    scrollInfo.cbSize = sizeof(SCROLLINFO);
@@ -406,6 +500,8 @@ int PanelWnd::GetClientHeight() {
 }
 
 void PanelWnd::EndEditRecord(Record* record) {
+   int todayRecordsCount = m_TodayList->GetRecordsCount();
+
    if (IsActiveRecord(record, m_TimeUtils)) {
       m_TodayList->TryAddRecord(record);
    } else {
@@ -413,6 +509,7 @@ void PanelWnd::EndEditRecord(Record* record) {
    }
 
    int recordIndex = m_AllRecordsList->TryGetRecordIndex(record);
+   StatusType oldStatus = m_AllRecordsList->TryGetStatus(recordIndex);
    if (IsEndedRecord(record, m_TimeUtils)) {
       m_AllRecordsList->TrySetStatus(recordIndex, StatusType::END);
    } else {
@@ -421,11 +518,16 @@ void PanelWnd::EndEditRecord(Record* record) {
 
    Update();
 
-   SaveRecords();
+   //The state only needs a checkpoint when the record moved in or out of today or ended, status changes are in the journal
+   SaveEditedRecord(record);
+   if (m_TodayList->GetRecordsCount() != todayRecordsCount || m_AllRecordsList->TryGetStatus(recordIndex) != oldStatus) {
+      SaveState();
+   }
 }
 
 void PanelWnd::AddRecord(Record* record) {
    m_Records.push_back(record);
+   m_RecordIndices[record] = (int) m_Records.size() - 1;
    m_AllRecordsList->TryAddRecord(record);
 
    if (IsActiveRecord(record, m_TimeUtils)) {
@@ -442,23 +544,30 @@ void PanelWnd::AddRecord(Record* record) {
 
    Update();
 
-   SaveRecords();
+   SaveAddedRecord(record);
+   SaveState();
 }
 
 void PanelWnd::DeleteRecord(Record* record) {
+   int recordIndex = GetRecordIndex(record);
+
    m_LastDayList->TryRemoveRecord(record);
    m_TodayList->TryRemoveRecord(record);
    for (std::vector<Record*>::iterator it = m_Records.begin(); it != m_Records.end(); it++) {
       if ((*it) == record) {
+         m_RecordHashes.erase(record);
          delete record;
          m_Records.erase(it);
          break;
       }
    }
+   UpdateRecordIndices();
 
    Update();
 
-   SaveRecords();
+   //Records after the deleted one moved, the journal can't refer to them by their old indices
+   SaveDeletedRecord(recordIndex);
+   SaveState();
 }
 
 void PanelWnd::Update() {
@@ -471,6 +580,7 @@ void PanelWnd::Update() {
    }
 
    TimeUpdate();
+   PostStateChanges();
 }
 
 void PanelWnd::DateUpdate() {
@@ -520,7 +630,6 @@ void PanelWnd::TimeUpdate() {
       }
    }
 
-   bool shouldSaveState = false;
    StatusType newTodayStatus = StatusType::UPCOMING;
    for (int i = 0; i < m_TodayList->GetRecordsCount(); i++) {
       StatusType status = m_TodayList->TryGetStatus(i);
@@ -530,12 +639,12 @@ void PanelWnd::TimeUpdate() {
 
       StatusType newStatus = GetActiveRecordStatus(m_TodayList->TryGetRecord(i), m_TimeUtils, status, m_Settings);
 
-      if (!shouldSaveState && newStatus != status) {
-         shouldSaveState = true;
-      }
-
       m_TodayList->TrySetStatus(i, newStatus);
 
+      if (newStatus != status) {
+         AppendStateChange(StateChangeType::RECORD_STATUS, m_TodayList, m_TodayList->TryGetRecord(i), (int) newStatus);
+      }
+
       if (newStatus == StatusType::CURRENT && newTodayStatus != StatusType::TO_LATE) {
          newTodayStatus = StatusType::CURRENT;
       } else if (newStatus == StatusType::TO_LATE) {
@@ -560,30 +669,56 @@ void PanelWnd::TimeUpdate() {
    if (m_TodayStatus != newTodayStatus) {
       m_TodayStatus = newTodayStatus;
       SendMessage(m_ParentWnd, WM_STATUS_UPDATE, 0, 0);
-      shouldSaveState = true;
-   }
-
-   if (shouldSaveState) {
-      SaveState();
+      AppendStateChange(StateChangeType::TODAY_STATUS, m_TodayList, nullptr, (int) m_TodayStatus);
    }
 }
 
+//Writes every record, binary saves replace the store with one of a slot per record in order.
+//The worker writes a copy of the records, the store and its slots are only used by jobs from here on
 void PanelWnd::SaveRecords() {
-   m_Serializer->TryOpenForSerialize(RECORDS_SAVE);
+   if (m_IsSavingBlocked) {
+      return;
+   }
 
-   int recordsCount = m_Records.size();
-   m_Serializer->WRITE_INT(recordsCount);
+   SavePostTimer timer(m_SaveWorker);
 
-   wchar_t prefix[128];
-   for (int i = 0; i < recordsCount; i++) {
-      Record* record = m_Records[i];
-      wcscpy_s(prefix, L"record[");
-      wcscat_s(prefix, std::to_wstring(i).c_str());
-      wcscat_s(prefix, L"].");
-      record->Save(*m_Serializer, prefix);
+   UpdateRecordHashes();
+
+   std::vector<Record> records;
+   records.reserve(m_Records.size());
+   for (const Record* record : m_Records) {
+      records.emplace_back(*record);
    }
 
-   m_Serializer->Close();
+   RecordStore* store = &m_RecordStore;
+   std::vector<uint32_t>* slots = &m_RecordSlots;
+   m_SaveWorker->PostSnapshot(SaveStream::RECORDS, [records = std::move(records), store, slots](Serializer& serializer) mutable {
+      std::vector<Record*> recordList;
+      recordList.reserve(records.size());
+      for (Record& record : records) {
+         recordList.emplace_back(&record);
+      }
+
+      //The records save the store was filled from is only dropped once the store has them, and the other way around
+      //for text saves, so a stale copy is never loaded as the records again
+      std::error_code error;
+      if (SAVE_FORMAT == SaveFormat::BINARY) {
+         store->SetDurability(serializer.GetDurability());
+         if (!store->TryCreate(RECORD_STORE_SAVE, recordList, *slots)) {
+            return false;
+         }
+
+         std::filesystem::remove(RECORDS_SAVE, error);
+         return true;
+      }
+
+      if (!TrySaveRecordList(serializer, RECORDS_SAVE, recordList, SAVE_FORMAT)) {
+         return false;
+      }
+
+      std::filesystem::remove(RECORD_STORE_SAVE, error);
+      return true;
+   });
 }
 
 void PanelWnd::LoadRecords() {
@@ -596,26 +731,194 @@ void PanelWnd::LoadRecords() {
       m_Records.clear();
    }
 
-   m_Serializer->TryOpenForDeserialize(RECORDS_SAVE);
+   //The store is opened here, no job may still be using it
+   m_SaveWorker->Flush();
+   m_RecordSlots.clear();
+   m_RecordStore.SetDurability(m_Serializer->GetDurability());
+
+   //Binary saves fill the store from a records save once, text saves take the records of a store back once.
+   //A store that's there but can't be opened, locked by another instance or damaged, is left as it is and nothing is saved,
+   //a save would replace it with records that aren't the ones in it
+   std::error_code error;
+   bool isStoreSaved = std::filesystem::exists(RECORD_STORE_SAVE, error) || error;
+   if (m_RecordStore.TryOpen(RECORD_STORE_SAVE, m_Records, m_RecordSlots)) {
+      if (SAVE_FORMAT == SaveFormat::TEXT) {
+         m_RecordStore.Close();
+         m_RecordSlots.clear();
+         SaveRecords();
+      }
+   } else if (isStoreSaved) {
+      m_IsSavingBlocked = true;
+      MessageBox(m_ParentWnd, L"Failed to open saves\\record_store, records and their state won't be saved this time", L"Loading error", MB_OK);
+   } else if (LoadRecordList(*m_Serializer, RECORDS_SAVE, m_Records) != SAVE_FORMAT || SAVE_FORMAT == SaveFormat::BINARY) {
+      SaveRecords();
+   }
 
-   int recordsCount = 0;
-   m_Serializer->READ_INT(recordsCount);
+   UpdateRecordIndices();
+   UpdateRecordHashes();
+}
 
-   wchar_t prefix[128];
-   m_Records.reserve(recordsCount);
-   for (int i = 0; i < recordsCount; i++) {
-      Record* record = new Record();
-      wcscpy_s(prefix, L"record[");
-      wcscat_s(prefix, std::to_wstring(i).c_str());
-      wcscat_s(prefix, L"].");
-      record->Load(*m_Serializer, prefix);
-      m_Records.emplace_back(record);
+//Only the slot of the record is written, and nothing when the edit left the record as it was.
+//Text saves, and a store that can't take it, write every record
+void PanelWnd::SaveEditedRecord(Record* record) {
+   if (m_IsSavingBlocked) {
+      return;
    }
 
-   m_Serializer->Close();
+   uint64_t hash = record->GetContentHash();
+   auto it = m_RecordHashes.find(record);
+   if (it != m_RecordHashes.end() && it->second == hash) {
+      if (SAVE_FORMAT == SaveFormat::TEXT) {
+         m_SaveWorker->AddSkippedFile(RECORDS_SAVE);
+      } else {
+         m_SaveWorker->AddSkipped(RECORD_STORE_SLOT_SIZE);
+      }
+      return;
+   }
+
+   if (SAVE_FORMAT == SaveFormat::TEXT) {
+      SaveRecords();
+      return;
+   }
+
+   SavePostTimer timer(m_SaveWorker);
+
+   m_RecordHashes[record] = hash;
+
+   int recordIndex = GetRecordIndex(record);
+   RecordStore* store = &m_RecordStore;
+   std::vector<uint32_t>* slots = &m_RecordSlots;
+   m_SaveWorker->PostChange(SaveStream::RECORDS, [copy = *record, recordIndex, store, slots](Serializer& /*serializer*/) {
+      return recordIndex < (int) slots->size() && store->TryWrite((*slots)[recordIndex], copy);
+   });
+}
+
+//The record was just added to the end of m_Records
+void PanelWnd::SaveAddedRecord(Record* record) {
+   if (m_IsSavingBlocked) {
+      return;
+   }
+
+   if (SAVE_FORMAT == SaveFormat::TEXT) {
+      SaveRecords();
+      return;
+   }
+
+   SavePostTimer timer(m_SaveWorker);
+
+   m_RecordHashes[record] = record->GetContentHash();
+
+   size_t recordsCount = m_Records.size();
+   RecordStore* store = &m_RecordStore;
+   std::vector<uint32_t>* slots = &m_RecordSlots;
+   m_SaveWorker->PostChange(SaveStream::RECORDS, [copy = *record, recordsCount, store, slots](Serializer& /*serializer*/) {
+      uint32_t slot;
+      if (slots->size() + 1 != recordsCount || !store->TryAdd(copy, &slot)) {
+         return false;
+      }
+
+      slots->emplace_back(slot);
+      return true;
+   });
 }
 
+//recordIndex is where the record was in m_Records before it was erased
+void PanelWnd::SaveDeletedRecord(int recordIndex) {
+   if (m_IsSavingBlocked) {
+      return;
+   }
+
+   if (SAVE_FORMAT == SaveFormat::TEXT) {
+      SaveRecords();
+      return;
+   }
+
+   SavePostTimer timer(m_SaveWorker);
+
+   RecordStore* store = &m_RecordStore;
+   std::vector<uint32_t>* slots = &m_RecordSlots;
+   m_SaveWorker->PostChange(SaveStream::RECORDS, [recordIndex, store, slots](Serializer& /*serializer*/) {
+      if (recordIndex >= (int) slots->size() || !store->TryDelete((*slots)[recordIndex])) {
+         return false;
+      }
+
+      slots->erase(slots->begin() + recordIndex);
+      return true;
+   });
+}
+
+//Same as searching m_Records, m_Records.size() for a record that isn't there
+int PanelWnd::GetRecordIndex(Record* record) {
+   auto it = m_RecordIndices.find(record);
+   return it != m_RecordIndices.end() ? it->second : (int) m_Records.size();
+}
+
+void PanelWnd::UpdateRecordIndices() {
+   m_RecordIndices.clear();
+   m_RecordIndices.reserve(m_Records.size());
+   for (int i = 0; i < (int) m_Records.size(); i++) {
+      m_RecordIndices[m_Records[i]] = i;
+   }
+}
+
+void PanelWnd::UpdateRecordHashes() {
+   m_RecordHashes.clear();
+   m_RecordHashes.reserve(m_Records.size());
+   for (Record* record : m_Records) {
+      m_RecordHashes[record] = record->GetContentHash();
+   }
+}
+
+//Writes a checkpoint of the whole state, the journal starts over on top of it. Changes not logged yet are in the checkpoint.
+//A checkpoint that fails keeps the old one on disk, the worker reports it and drops later changes until one is written.
+//While nothing was logged on top of the last checkpoint the new one keeps its id, so one with the same state is the same file and is skipped
 void PanelWnd::SaveState() {
+   if (m_IsSavingBlocked) {
+      return;
+   }
+
+   SavePostTimer timer(m_SaveWorker);
+
+   bool isJournalEmpty = m_JournalSize == STATE_JOURNAL_HEADER_SIZE;
+   if (!isJournalEmpty) {
+      m_JournalId++;
+   }
+   m_JournalSize = STATE_JOURNAL_HEADER_SIZE;
+   m_StateChanges.clear();
+
+   std::vector<uint8_t> data;
+   bool isSerialized = SAVE_FORMAT == SaveFormat::BINARY ? TrySerializeStateBinary(data) : TrySerializeStateText(data);
+   if (!isSerialized) {
+      return;
+   }
+
+   uint64_t hash = GetContentHash(data.data(), data.size());
+   if (isJournalEmpty && m_IsStateHashed && hash == m_StateHash) {
+      m_SaveWorker->AddSkipped(data.size());
+      return;
+   }
+
+   m_StateHash = hash;
+   m_IsStateHashed = true;
+
+   uint32_t journalId = m_JournalId;
+   StateJournal* journal = &m_Journal;
+   m_SaveWorker->PostSnapshot(SaveStream::STATE, [data = std::move(data), journalId, journal](Serializer& serializer) {
+      if (!TryWriteFileAtomic(STATE_SAVE, data.data(), data.size(), serializer.GetDurability())) {
+         return false;
+      }
+
+      //A log that couldn't be reset, or was closed by an earlier failure, is opened again for the new checkpoint.
+      //Without it every later change would fail and fall back to a checkpoint of its own
+      if (!journal->TryReset(journalId)) {
+         std::vector<StateChange> changes;
+         journal->TryOpen(STATE_LOG, journalId, changes);
+      }
+      return true;
+   });
+}
+
+bool PanelWnd::TrySerializeStateText(std::vector<uint8_t>& data) {
    m_Serializer->TryOpenForSerialize(STATE_SAVE);
 
    int lastYear = m_LastDate.wYear;
@@ -625,6 +928,9 @@ void PanelWnd::SaveState() {
    m_Serializer->WRITE_INT(lastMonth);
    m_Serializer->WRITE_INT(lastDay);
 
+   int journalId = (int) m_JournalId;
+   m_Serializer->WRITE_INT(journalId);
+
    m_Serializer->WRITE_ENUM(m_TodayStatus);
 
    wchar_t prefix[128];
@@ -643,9 +949,7 @@ void PanelWnd::SaveState() {
          wcscat_s(prefix, std::to_wstring(i).c_str());
          wcscat_s(prefix, L"].");
 
-         Record* record = m_LastDayList->TryGetRecord(i);
-         auto it = std::find(m_Records.begin(), m_Records.end(), record);
-         int recordIndex = it - m_Records.begin();
+         int recordIndex = GetRecordIndex(m_LastDayList->TryGetRecord(i));
 
          CreateName(VAR_NAME(recordIndex));
          m_Serializer->TryWriteInt(varName, recordIndex);
@@ -667,9 +971,7 @@ void PanelWnd::SaveState() {
       wcscat_s(prefix, std::to_wstring(i).c_str());
       wcscat_s(prefix, L"].");
 
-      Record* record = m_TodayList->TryGetRecord(i);
-      auto it = std::find(m_Records.begin(), m_Records.end(), record);
-      int recordIndex = it - m_Records.begin();
+      int recordIndex = GetRecordIndex(m_TodayList->TryGetRecord(i));
 
       CreateName(VAR_NAME(recordIndex));
       m_Serializer->TryWriteInt(varName, recordIndex);
@@ -713,12 +1015,21 @@ void PanelWnd::SaveState() {
    bool allExpanded = m_AllRecordsList->IsExpanded();
    m_Serializer->WRITE_BOOL(allExpanded);
 
-   m_Serializer->Close();
+   return m_Serializer->TryTakeSerialized(data);
 }
 
 void PanelWnd::LoadState() {
    m_Serializer->TryOpenForDeserialize(STATE_SAVE);
 
+   //Rewritten in the format saves use now once CreateView has restored the lists
+   m_IsStateMigrating = m_Serializer->GetFormat() != SAVE_FORMAT;
+
+   if (m_Serializer->GetFormat() == SaveFormat::BINARY) {
+      LoadStateBinary();
+      m_Serializer->Close();
+      return;
+   }
+
    int lastYear, lastMonth, lastDay;
    m_Serializer->READ_INT(lastYear);
    m_Serializer->READ_INT(lastMonth);
@@ -726,6 +1037,10 @@ void PanelWnd::LoadState() {
 
    m_LastDate = m_TimeUtils->CreateSysTime(lastYear, lastMonth, lastDay);
 
+   int journalId = 0;
+   m_Serializer->READ_INT(journalId);
+   m_JournalId = (uint32_t) journalId;
+
    m_Serializer->READ_ENUM(m_TodayStatus);
 
    m_TodayList->RemoveAllRecords();
@@ -835,3 +1150,270 @@ void PanelWnd::LoadState() {
 
    m_Serializer->Close();
 }
+
+bool PanelWnd::TrySerializeStateBinary(std::vector<uint8_t>& data) {
+   BinarySaveWriter writer;
+
+   writer.BeginSection(STATE_SECTION, s_StateColumns, (uint32_t) std::size(s_StateColumns), 1);
+   writer.WriteNumber(m_LastDate.wYear);
+   writer.WriteNumber(m_LastDate.wMonth);
+   writer.WriteNumber(m_LastDate.wDay);
+   writer.WriteNumber((int) m_JournalId);
+   writer.WriteNumber((int) m_TodayStatus);
+   writer.WriteNumber(m_LastDayList->IsExpanded());
+   writer.WriteNumber(m_TodayList->IsExpanded());
+   writer.WriteNumber(m_AllRecordsList->IsExpanded());
+
+   if (m_Settings.shouldSaveToLate) {
+      int lastDayRecordsCount = m_LastDayList->GetRecordsCount();
+      writer.BeginSection(LAST_DAY_SECTION, s_LastDayColumns, (uint32_t) std::size(s_LastDayColumns), lastDayRecordsCount);
+      for (int i = 0; i < lastDayRecordsCount; i++) {
+         writer.WriteNumber(GetRecordIndex(m_LastDayList->TryGetRecord(i)));
+         writer.WriteNumber(m_LastDayList->GetRecordCollapse(i));
+      }
+   }
+
+   int todayRecordsCount = m_TodayList->GetRecordsCount();
+   writer.BeginSection(TODAY_SECTION, s_TodayColumns, (uint32_t) std::size(s_TodayColumns), todayRecordsCount);
+   for (int i = 0; i < todayRecordsCount; i++) {
+      writer.WriteNumber(GetRecordIndex(m_TodayList->TryGetRecord(i)));
+      writer.WriteNumber((int) m_TodayList->TryGetStatus(i));
+      writer.WriteNumber(m_TodayList->GetRecordCollapse(i));
+   }
+
+   std::vector<int> endedRecords;
+   std::vector<int> collapsedRecords;
+   for (int i = 0; i < m_AllRecordsList->GetRecordsCount(); i++) {
+      if (m_AllRecordsList->TryGetStatus(i) == StatusType::END) {
+         endedRecords.emplace_back(i);
+      }
+
+      if (m_AllRecordsList->GetRecordCollapse(i)) {
+         collapsedRecords.emplace_back(i);
+      }
+   }
+
+   writer.BeginSection(ENDED_SECTION, s_IndexColumns, (uint32_t) std::size(s_IndexColumns), (uint32_t) endedRecords.size());
+   for (int recordIndex : endedRecords) {
+      writer.WriteNumber(recordIndex);
+   }
+
+   writer.BeginSection(COLLAPSED_SECTION, s_IndexColumns, (uint32_t) std::size(s_IndexColumns), (uint32_t) collapsedRecords.size());
+   for (int recordIndex : collapsedRecords) {
+      writer.WriteNumber(recordIndex);
+   }
+
+   return writer.TryFinish(data);
+}
+
+//Same checks as the text state, missing sections and columns leave the defaults of a first start
+void PanelWnd::LoadStateBinary() {
+   const BinarySaveReader& reader = m_Serializer->GetBinaryReader();
+   BinarySaveSection section;
+   std::vector<SaveValue> values;
+
+   auto TryOpenSection = [&](const char* name) {
+      if (!reader.TryGetSection(name, section)) {
+         return false;
+      }
+
+      values.assign(section.GetColumns().size(), SaveValue());
+      return true;
+   };
+
+   auto GetNumber = [&](int column, int defaultValue) {
+      return column >= 0 ? values[column].number : defaultValue;
+   };
+
+   m_TodayList->RemoveAllRecords();
+
+   m_LastDayRecordsLoaded.clear();
+   m_TodayRecordsLoaded.clear();
+   m_EndedRecordsLoaded.clear();
+   m_CollapsedRecordsLoaded.clear();
+
+   if (TryOpenSection(STATE_SECTION) && section.TryReadRow(values.data())) {
+      m_LastDate = m_TimeUtils->CreateSysTime(GetNumber(section.FindColumn("lastYear"), 0), GetNumber(section.FindColumn("lastMonth"), 0), GetNumber(section.FindColumn("lastDay"), 0));
+      m_JournalId = (uint32_t) GetNumber(section.FindColumn("journalId"), 0);
+      m_TodayStatus = (StatusType) GetNumber(section.FindColumn("todayStatus"), (int) m_TodayStatus);
+      if (m_Settings.shouldSaveToLate) {
+         m_LastDayExpandedLoaded = GetNumber(section.FindColumn("lastDayExpanded"), true);
+      }
+      m_TodayExpandedLoaded = GetNumber(section.FindColumn("todayExpanded"), true);
+      m_AllExpandedLoaded = GetNumber(section.FindColumn("allExpanded"), true);
+   }
+
+   if (m_Settings.shouldSaveToLate && TryOpenSection(LAST_DAY_SECTION)) {
+      int indexColumn = section.FindColumn("recordIndex");
+      int collapsedColumn = section.FindColumn("isCollapsed");
+
+      m_LastDayRecordsLoaded.reserve(section.GetRowCount());
+      while (section.TryReadRow(values.data())) {
+         int recordIndex = GetNumber(indexColumn, -1);
+         if (recordIndex >= 0) {
+            m_LastDayRecordsLoaded.emplace_back(recordIndex, GetNumber(collapsedColumn, false));
+         }
+      }
+   }
+
+   if (TryOpenSection(TODAY_SECTION)) {
+      int indexColumn = section.FindColumn("recordIndex");
+      int statusColumn = section.FindColumn("recordStatus");
+      int collapsedColumn = section.FindColumn("isCollapsed");
+
+      m_TodayRecordsLoaded.reserve(section.GetRowCount());
+      while (section.TryReadRow(values.data())) {
+         int recordIndex = GetNumber(indexColumn, -1);
+         StatusType recordStatus = (StatusType) GetNumber(statusColumn, (int) StatusType::INVALID);
+         if (recordIndex >= 0 && recordStatus != StatusType::INVALID) {
+            m_TodayRecordsLoaded.emplace_back(recordIndex, std::pair(recordStatus, (bool) GetNumber(collapsedColumn, false)));
+         }
+      }
+   }
+
+   if (TryOpenSection(ENDED_SECTION)) {
+      int indexColumn = section.FindColumn("recordIndex");
+      while (section.TryReadRow(values.data())) {
+         int recordIndex = GetNumber(indexColumn, -1);
+         if (recordIndex >= 0) {
+            m_EndedRecordsLoaded.emplace_back(recordIndex);
+         }
+      }
+   }
+
+   if (TryOpenSection(COLLAPSED_SECTION)) {
+      int indexColumn = section.FindColumn("recordIndex");
+      while (section.TryReadRow(values.data())) {
+         int recordIndex = GetNumber(indexColumn, -1);
+         if (recordIndex >= 0) {
+            m_CollapsedRecordsLoaded.emplace_back(recordIndex);
+         }
+      }
+   }
+}
+
+//Keeps one change for the next PostStateChanges
+void PanelWnd::AppendStateChange(StateChangeType type, RecordListWnd* list, Record* record, int value) {
+   if (!m_IsJournaling) {
+      return;
+   }
+
+   StateChange change;
+   change.type = type;
+   change.list = list == m_LastDayList ? StateListType::LAST_DAY : list == m_TodayList ? StateListType::TODAY : StateListType::ALL;
+   change.recordIndex = record ? GetRecordIndex(record) : -1;
+   change.value = value;
+   m_StateChanges.emplace_back(change);
+}
+
+//Logs the kept changes in one append. The whole state is written instead once the journal would grow past its size,
+//and when the append fails the worker reports it and the state is written then
+void PanelWnd::PostStateChanges() {
+   if (m_StateChanges.empty()) {
+      return;
+   }
+
+   m_JournalSize += m_StateChanges.size() * STATE_JOURNAL_ENTRY_SIZE;
+   if (m_JournalSize >= STATE_JOURNAL_COMPACT_SIZE) {
+      SaveState();
+      return;
+   }
+
+   SavePostTimer timer(m_SaveWorker);
+
+   StateJournal* journal = &m_Journal;
+   m_SaveWorker->PostChange(SaveStream::STATE, [changes = std::move(m_StateChanges), journal](Serializer& /*serializer*/) {
+      return journal->TryAppend(changes);
+   });
+   m_StateChanges.clear();
+}
+
+//Opens the journal of the loaded checkpoint and applies the changes logged on top of it.
+//Records are found by their index in the records save, changes to records the checkpoint doesn't list are dropped
+void PanelWnd::ReplayStateJournal() {
+   m_Journal.SetDurability(m_Serializer->GetDurability());
+
+   //A log that can't be opened is counted as full, so the first change writes a checkpoint and its job opens the log again
+   std::vector<StateChange> changes;
+   if (m_Journal.TryOpen(STATE_LOG, m_JournalId, changes)) {
+      m_JournalSize = m_Journal.GetSize();
+   } else {
+      m_JournalSize = STATE_JOURNAL_COMPACT_SIZE;
+   }
+
+   auto FindLoaded = [](auto& loaded, int recordIndex) {
+      return std::find_if(loaded.begin(), loaded.end(), [&](const auto& pair) { return pair.first == recordIndex; });
+   };
+
+   for (const StateChange& change : changes) {
+      switch (change.type) {
+         case StateChangeType::RECORD_STATUS:
+            {
+               StatusType status = (StatusType) change.value;
+               bool isCleared = status == StatusType::DONE && m_Settings.shouldClearDone;
+
+               if (change.list == StateListType::TODAY) {
+                  auto it = FindLoaded(m_TodayRecordsLoaded, change.recordIndex);
+                  if (it != m_TodayRecordsLoaded.end()) {
+                     if (isCleared) {
+                        m_TodayRecordsLoaded.erase(it);
+                     } else {
+                        it->second.first = status;
+                     }
+                  }
+               } else if (change.list == StateListType::LAST_DAY && isCleared) {
+                  auto it = FindLoaded(m_LastDayRecordsLoaded, change.recordIndex);
+                  if (it != m_LastDayRecordsLoaded.end()) {
+                     m_LastDayRecordsLoaded.erase(it);
+                  }
+               }
+            }
+            break;
+         case StateChangeType::RECORD_COLLAPSE:
+            {
+               bool isCollapsed = change.value;
+
+               if (change.list == StateListType::LAST_DAY) {
+                  for (std::pair<int, bool>& record : m_LastDayRecordsLoaded) {
+                     if (change.recordIndex < 0 || record.first == change.recordIndex) {
+                        record.second = isCollapsed;
+                     }
+                  }
+               } else if (change.list == StateListType::TODAY) {
+                  for (std::pair<int, std::pair<StatusType, bool>>& record : m_TodayRecordsLoaded) {
+                     if (change.recordIndex < 0 || record.first == change.recordIndex) {
+                        record.second.second = isCollapsed;
+                     }
+                  }
+               } else if (change.recordIndex < 0) {
+                  m_CollapsedRecordsLoaded.clear();
+                  if (isCollapsed) {
+                     for (int i = 0; i < (int) m_Records.size(); i++) {
+                        m_CollapsedRecordsLoaded.emplace_back(i);
+                     }
+                  }
+               } else {
+                  auto it = std::find(m_CollapsedRecordsLoaded.begin(), m_CollapsedRecordsLoaded.end(), change.recordIndex);
+                  if (isCollapsed && it == m_CollapsedRecordsLoaded.end()) {
+                     m_CollapsedRecordsLoaded.emplace_back(change.recordIndex);
+                  } else if (!isCollapsed && it != m_CollapsedRecordsLoaded.end()) {
+                     m_CollapsedRecordsLoaded.erase(it);
+                  }
+               }
+            }
+            break;
+         case StateChangeType::LIST_EXPAND:
+            if (change.list == StateListType::LAST_DAY) {
+               m_LastDayExpandedLoaded = change.value;
+            } else if (change.list == StateListType::TODAY) {
+               m_TodayExpandedLoaded = change.value;
+            } else {
+               m_AllExpandedLoaded = change.value;
+            }
+            break;
+         case StateChangeType::TODAY_STATUS:
+            m_TodayStatus = (StatusType) change.value;
+            break;
+      }
+   }
+}
@@ -4,15 +4,20 @@
 #include "record_wnd.h"
 #include "setup_record_wnd.h"
 #include "record.h"
+#include "record_store.h"
+#include "save_worker.h"
 #include "ui_consts.h"
 #include "settings.h"
 #include "serializer.h"
+#include "state_journal.h"
+#include <unordered_map>
 
 struct PanelWndCreateData : public WndCreateData {
    int mainHeight = 0;
    int clientHeight = 0;
    TimeUtils* timeUtils;
    Serializer* serializer;
+   SaveWorker* saveWorker;
    Settings settings;
 };
 
@@ -42,6 +47,7 @@ private:
    TimeUtils* m_TimeUtils;
    SYSTEMTIME m_LastDate;
    Serializer* m_Serializer;
+   SaveWorker* m_SaveWorker = nullptr;
 
    POINT m_StartOffset{LINE_X_OFFSET, 0};
 
@@ -54,8 +60,30 @@ private:
    bool m_LastDayExpandedLoaded = true;
    bool m_TodayExpandedLoaded = true;
    bool m_AllExpandedLoaded = true;
+   bool m_IsStateMigrating = false;
+
+   //Changes since the last state checkpoint, logged once the lists are created.
+   //Only jobs of the save worker use the journal after it's opened, m_JournalSize is what it will have once they ran
+   StateJournal m_Journal;
+   uint32_t m_JournalId = 0;
+   size_t m_JournalSize = 0;
+   bool m_IsJournaling = false;
+   std::vector<StateChange> m_StateChanges;
+
+   //Hash of the last checkpoint posted, forgotten when one fails
+   uint64_t m_StateHash = 0;
+   bool m_IsStateHashed = false;
 
    std::vector<Record*> m_Records;
+   std::unordered_map<Record*, int> m_RecordIndices;
+
+   //Hash of every record as it was last posted, an edit that leaves it the same isn't saved
+   std::unordered_map<Record*, uint64_t> m_RecordHashes;
+
+   //Binary saves keep records in the store, m_RecordSlots has the slot of every record in m_Records once the save worker caught up
+   RecordStore m_RecordStore;
+   std::vector<uint32_t> m_RecordSlots;
+   bool m_IsSavingBlocked = false;//The store is there but couldn't be opened, nothing may replace it
    RecordListWnd* m_LastDayList = nullptr;
    RecordListWnd* m_TodayList = nullptr;
    RecordListWnd* m_AllRecordsList = nullptr;
@@ -90,10 +118,26 @@ private:
    void SaveRecords();
    void LoadRecords();
 
+   void SaveEditedRecord(Record* record);
+   void SaveAddedRecord(Record* record);
+   void SaveDeletedRecord(int recordIndex);
+
+   int GetRecordIndex(Record* record);
+   void UpdateRecordIndices();
+   void UpdateRecordHashes();
+
 public:
    void SaveState();
 private:
    void LoadState();
 
+   bool TrySerializeStateText(std::vector<uint8_t>& data);
+   bool TrySerializeStateBinary(std::vector<uint8_t>& data);
+   void LoadStateBinary();
+
+   void AppendStateChange(StateChangeType type, RecordListWnd* list, Record* record, int value);
+   void PostStateChanges();
+   void ReplayStateJournal();
+
 };
 
@@ -279,6 +279,8 @@ LRESULT RecordListWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARA
 
                UpdateSize();
 
+               SendMessage(m_ParentWnd, WM_EXPAND_LIST, (WPARAM) this, 0);
+
                break;
             case BTN_ADD:
                SendMessage(m_ParentWnd, WM_ADD_RECORD, (WPARAM) this, (LPARAM) 0);
@@ -292,6 +294,7 @@ LRESULT RecordListWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARA
                   record.second->Collapse();
                }
                UpdateSize();
+               SendMessage(m_ParentWnd, WM_EXPAND_RECORD, (WPARAM) this, 0);
                break;
             case BTN_ALL_EXPAND:
                if (!m_IsExpanded) {
@@ -302,6 +305,7 @@ LRESULT RecordListWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARA
                   record.second->Expand();
                }
                UpdateSize();
+               SendMessage(m_ParentWnd, WM_EXPAND_RECORD, (WPARAM) this, 0);
                break;
             default:
                return DefWindowProc(m_Wnd, message, wParam, lParam);
@@ -316,6 +320,7 @@ LRESULT RecordListWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARA
          break;
       case WM_EXPAND_RECORD:
          UpdateSize();
+         SendMessage(m_ParentWnd, WM_EXPAND_RECORD, (WPARAM) this, lParam);
          break;
       case WM_RECORD_DONE:
          if (m_IsWorkable) {
@@ -323,7 +328,7 @@ LRESULT RecordListWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARA
                TryRemoveRecord((Record*) wParam);
             }
 
-            SendMessage(m_ParentWnd, WM_RECORD_DONE, 0, 0);
+            SendMessage(m_ParentWnd, WM_RECORD_DONE, wParam, (LPARAM) this);
          }
          break;
       case WM_PAINT:
@@ -169,7 +169,7 @@ LRESULT RecordWnd::MessageProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lP
 
                UpdateCollapse();
 
-               SendMessage(m_ParentWnd, WM_EXPAND_RECORD, (WPARAM) m_IsExpanded, (LPARAM) 0);
+               SendMessage(m_ParentWnd, WM_EXPAND_RECORD, (WPARAM) m_IsExpanded, (LPARAM) m_Record);
 
                break;
             case BTN_DONE:
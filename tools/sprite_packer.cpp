@@ -0,0 +1,105 @@
+#include "png_decoder.h"
+#include "sprite_pack.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Turns an atlas and its manifest into a sprite pack.
+//Usage: SpritePacker atlas.png manifest.txt pack.spk [--key RRGGBB]
+//The manifest has one sprite per line as 'x y width height' in atlas pixels, in image index order. '#' starts a comment
+
+#define DEFAULT_KEY_PIXEL 0x00FF0000//TRANSPARENCY_COLOR of the application
+
+static bool TryReadFile(const char* fileName, std::vector<uint8_t>& out);
+static bool TryReadManifest(const char* fileName, std::vector<SpriteRect>& rects);
+
+int main(int argc, char** argv) {
+   if (argc != 4 && !(argc == 6 && !strcmp(argv[4], "--key"))) {
+      fprintf(stderr, "Usage: SpritePacker atlas.png manifest.txt pack.spk [--key RRGGBB]\n");
+      return 1;
+   }
+
+   PNGDecodeOptions options;
+   options.alphaMode = AlphaMode::COLOR_KEY;
+   options.transparentPixel = argc == 6 ? (uint32_t) strtoul(argv[5], nullptr, 16) & 0x00FFFFFF : DEFAULT_KEY_PIXEL;
+
+   std::vector<uint8_t> file;
+   PNGImage atlas;
+   if (!TryReadFile(argv[1], file) || !DecodePNG(file.data(), file.size(), options, atlas)) {
+      fprintf(stderr, "%s: can't read the atlas\n", argv[1]);
+      return 1;
+   }
+
+   std::vector<SpriteRect> rects;
+   if (!TryReadManifest(argv[2], rects)) {
+      return 1;
+   }
+
+   std::vector<uint8_t> pack;
+   if (!TryBuildSpritePack(atlas.pixels.data(), atlas.width, atlas.width, atlas.height, options.transparentPixel, rects, pack)) {
+      fprintf(stderr, "%s: a sprite is outside the %ux%u atlas\n", argv[2], atlas.width, atlas.height);
+      return 1;
+   }
+
+   std::ofstream out(argv[3], std::ios::binary | std::ios::trunc);
+   if (!out.write((const char*) pack.data(), pack.size())) {
+      fprintf(stderr, "%s: can't write the pack\n", argv[3]);
+      return 1;
+   }
+
+   printf("%s: %zu sprites, %.1f KB\n", argv[3], rects.size(), pack.size() / 1024.0);
+   return 0;
+}
+
+static bool TryReadFile(const char* fileName, std::vector<uint8_t>& out) {
+   std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+   if (!file.is_open()) {
+      return false;
+   }
+
+   std::streamoff size = file.tellg();
+   if (size <= 0) {
+      return false;
+   }
+
+   out.resize((size_t) size);
+   file.seekg(0, std::ios_base::beg);
+   return (bool) file.read((char*) out.data(), size);
+}
+
+static bool TryReadManifest(const char* fileName, std::vector<SpriteRect>& rects) {
+   std::ifstream file(fileName);
+   if (!file.is_open()) {
+      fprintf(stderr, "%s: can't read the manifest\n", fileName);
+      return false;
+   }
+
+   std::string line;
+   for (int lineNumber = 1; std::getline(file, line); lineNumber++) {
+      line = line.substr(0, line.find('#'));
+      if (line.find_first_not_of(" \t\r") == std::string::npos) {
+         continue;
+      }
+
+      std::istringstream stream(line);
+      SpriteRect rect;
+      std::string rest;
+      if (!(stream >> rect.x >> rect.y >> rect.width >> rect.height) || (stream >> rest)) {
+         fprintf(stderr, "%s:%d: expected 'x y width height'\n", fileName, lineNumber);
+         return false;
+      }
+
+      rects.emplace_back(rect);
+   }
+
+   if (rects.empty()) {
+      fprintf(stderr, "%s: no sprites\n", fileName);
+      return false;
+   }
+
+   return true;
+}